@@ -21,6 +21,43 @@ int DEBUG_DRAW_FRAMERATE = 0;
 int DEBUG_SKIP_INITIAL_TITLE_SCREEN = 0;
 int DEBUG_USE_DEBUG_NEWGAME_FILE = 0;
 
+int STACK_USE_ROTATION_CACHE = 0;
+int STACK_ROTATION_CACHE_BUDGET_KB = 0;
+float STACK_ROTATION_CACHE_ANGLE_STEP = 1;
+int STACK_EXTRUDE_SLICES = 0;
+int STACK_CULL_OFFSCREEN = 0;
+int STACK_FIT_BUFFER_TO_PITCH = 0;
+int STACK_TRIM_HIDDEN_SLICES = 0;
+int STACK_MESH_SLICES = 0;
+int STACK_ENCODE_BAKED_SPANS = 0;
+int STACK_BAKED_ROTATION_ANGLES = 0;
+int STACK_BAKED_ROTATION_BUDGET_KB = 0;
+int STACK_USE_SOFTWARE_RENDERER = 0;
+int STACK_SOFTWARE_RENDERER_THREADS = 0;
+int STACK_SOFTWARE_FRONT_TO_BACK = 0;
+int STACK_USE_RAYCASTER = 0;
+int STACK_RAYCASTER_BUDGET_KB = 0;
+int STACK_USE_IMPOSTORS = 0;
+int STACK_IMPOSTOR_BUDGET_KB = 0;
+float STACK_IMPOSTOR_ANGLE_STEP = 2;
+float STACK_IMPOSTOR_PITCH_STEP = 0.1;
+int STACK_IMPOSTOR_BUILDS_PER_FRAME = 0;
+int STACK_USE_QUALITY_GOVERNOR = 0;
+float STACK_GOVERNOR_TARGET_MS = 16;
+int STACK_GOVERNOR_MIN_BUFFER_SCALE = 1;
+int STACK_GOVERNOR_MAX_BUFFER_SCALE = 1;
+int STACK_GOVERNOR_MAX_LOD_BIAS = 0;
+int STACK_GOVERNOR_MAX_GAP_FILL_DROP = 0;
+int DEBUG_COMPARE_STACK_RENDERERS = 0;
+int STACK_USE_LOD = 0;
+float STACK_LOD_LAYER_SPACING = 1;
+int DEBUG_SHOW_STACK_LOD = 0;
+int DEBUG_STACK_STRESS_SCENE = 0;
+int DEBUG_BENCHMARK_STACK_TRANSFORMS = 0;
+int DEBUG_BENCHMARK_STACK_EDITS = 0;
+int DEBUG_BENCHMARK_STACK_SPANS = 0;
+int DEBUG_CHECK_VOX_CACHE = 0;
+
 
 /////////////////////////////////////////////////
 // Loading
@@ -28,6 +65,7 @@ int DEBUG_USE_DEBUG_NEWGAME_FILE = 0;
 void loadConfiguration(){
     cJSON *root = NULL;
     cJSON *debugDraw = NULL;
+    cJSON *stackRendering = NULL;
     char *fileContents = NULL;
     int errorCount = 0;
     const char *filename = "data/configuration.data";
@@ -71,6 +109,56 @@ void loadConfiguration(){
         DEBUG_DRAW_FRAMERATE = cjson_readBoolean(debugDraw, "draw framerate", &errorCount);
     }
     
+    stackRendering = cjson_readObject(root, "stack rendering settings", &errorCount);
+    STACK_USE_ROTATION_CACHE = cjson_readBoolean(stackRendering, "use rotation cache", &errorCount);
+    STACK_ROTATION_CACHE_BUDGET_KB = cjson_readInt(stackRendering, "rotation cache budget kb", &errorCount);
+    STACK_ROTATION_CACHE_ANGLE_STEP = cjson_readFloat(stackRendering, "rotation cache angle step", &errorCount);
+    if (STACK_ROTATION_CACHE_ANGLE_STEP <= 0){
+        LOG_WAR("Rotation cache angle step must be positive, using 1 degree");
+        STACK_ROTATION_CACHE_ANGLE_STEP = 1;
+    }
+    STACK_EXTRUDE_SLICES = cjson_readBoolean(stackRendering, "extrude slices", &errorCount);
+    STACK_CULL_OFFSCREEN = cjson_readBoolean(stackRendering, "cull offscreen", &errorCount);
+    STACK_FIT_BUFFER_TO_PITCH = cjson_readBoolean(stackRendering, "fit buffer to pitch", &errorCount);
+    STACK_TRIM_HIDDEN_SLICES = cjson_readBoolean(stackRendering, "trim hidden slices", &errorCount);
+    STACK_MESH_SLICES = cjson_readBoolean(stackRendering, "mesh slices", &errorCount);
+    STACK_ENCODE_BAKED_SPANS = cjson_readBoolean(stackRendering, "encode baked spans", &errorCount);
+    STACK_BAKED_ROTATION_ANGLES = cjson_readInt(stackRendering, "baked rotation angles", &errorCount);
+    STACK_BAKED_ROTATION_BUDGET_KB = cjson_readInt(stackRendering, "baked rotation budget kb", &errorCount);
+    STACK_USE_SOFTWARE_RENDERER = cjson_readBoolean(stackRendering, "use software renderer", &errorCount);
+    STACK_SOFTWARE_RENDERER_THREADS = cjson_readInt(stackRendering, "software renderer threads", &errorCount);
+    STACK_SOFTWARE_FRONT_TO_BACK = cjson_readBoolean(stackRendering, "software front to back", &errorCount);
+    STACK_USE_RAYCASTER = cjson_readBoolean(stackRendering, "use raycaster", &errorCount);
+    STACK_RAYCASTER_BUDGET_KB = cjson_readInt(stackRendering, "raycaster budget kb", &errorCount);
+    STACK_USE_IMPOSTORS = cjson_readBoolean(stackRendering, "use impostors", &errorCount);
+    STACK_IMPOSTOR_BUDGET_KB = cjson_readInt(stackRendering, "impostor budget kb", &errorCount);
+    STACK_IMPOSTOR_ANGLE_STEP = cjson_readFloat(stackRendering, "impostor angle step", &errorCount);
+    if (STACK_IMPOSTOR_ANGLE_STEP <= 0){
+        LOG_WAR("Impostor angle step must be positive, using 2 degrees");
+        STACK_IMPOSTOR_ANGLE_STEP = 2;
+    }
+    STACK_IMPOSTOR_PITCH_STEP = cjson_readFloat(stackRendering, "impostor pitch step", &errorCount);
+    if (STACK_IMPOSTOR_PITCH_STEP <= 0){
+        LOG_WAR("Impostor pitch step must be positive, using 0.1");
+        STACK_IMPOSTOR_PITCH_STEP = 0.1;
+    }
+    STACK_IMPOSTOR_BUILDS_PER_FRAME = cjson_readInt(stackRendering, "impostor builds per frame", &errorCount);
+    STACK_USE_QUALITY_GOVERNOR = cjson_readBoolean(stackRendering, "use quality governor", &errorCount);
+    STACK_GOVERNOR_TARGET_MS = cjson_readFloat(stackRendering, "governor target ms", &errorCount);
+    STACK_GOVERNOR_MIN_BUFFER_SCALE = cjson_readInt(stackRendering, "governor min buffer scale", &errorCount);
+    STACK_GOVERNOR_MAX_BUFFER_SCALE = cjson_readInt(stackRendering, "governor max buffer scale", &errorCount);
+    STACK_GOVERNOR_MAX_LOD_BIAS = cjson_readInt(stackRendering, "governor max lod bias", &errorCount);
+    STACK_GOVERNOR_MAX_GAP_FILL_DROP = cjson_readInt(stackRendering, "governor max gap fill drop", &errorCount);
+    DEBUG_COMPARE_STACK_RENDERERS = cjson_readBoolean(stackRendering, "debug compare renderers", &errorCount);
+    STACK_USE_LOD = cjson_readBoolean(stackRendering, "use level of detail", &errorCount);
+    STACK_LOD_LAYER_SPACING = cjson_readFloat(stackRendering, "lod layer spacing", &errorCount);
+    DEBUG_SHOW_STACK_LOD = cjson_readBoolean(stackRendering, "debug show lod", &errorCount);
+    DEBUG_STACK_STRESS_SCENE = cjson_readBoolean(stackRendering, "debug stress scene", &errorCount);
+    DEBUG_BENCHMARK_STACK_TRANSFORMS = cjson_readBoolean(stackRendering, "debug benchmark transforms", &errorCount);
+    DEBUG_BENCHMARK_STACK_EDITS = cjson_readBoolean(stackRendering, "debug benchmark edits", &errorCount);
+    DEBUG_BENCHMARK_STACK_SPANS = cjson_readBoolean(stackRendering, "debug benchmark spans", &errorCount);
+    DEBUG_CHECK_VOX_CACHE = cjson_readBoolean(stackRendering, "debug check vox cache", &errorCount);
+    
     if (errorCount > 0){
         LOG_ERR("Encountered a problem reading configuration file %s", filename);
         displayErrorAndExit("Encountered a problem reading configuration file");
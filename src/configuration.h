@@ -29,6 +29,44 @@ extern int DEBUG_DRAW_FRAMERATE;
 extern int DEBUG_SKIP_INITIAL_TITLE_SCREEN;
 extern int DEBUG_USE_DEBUG_NEWGAME_FILE;
 
+//settings for the sprite stack renderer
+extern int STACK_USE_ROTATION_CACHE; //boolean, blit cached pre-rotated layers instead of rotating every frame
+extern int STACK_ROTATION_CACHE_BUDGET_KB; //texture memory the rotation cache may use before evicting
+extern float STACK_ROTATION_CACHE_ANGLE_STEP; //degrees, camera angles are snapped to multiples of this when using the cache
+extern int STACK_EXTRUDE_SLICES; //boolean, fill the gaps between pitched layers by extruding each slice instead of drawing it again per pixel of pitch
+extern int STACK_CULL_OFFSCREEN; //boolean, skip objects and layers that land outside the part of the stack buffer shown on screen
+extern int STACK_FIT_BUFFER_TO_PITCH; //boolean, only allocate, clear and fill as much of the stack buffer as the current pitch shows
+extern int STACK_TRIM_HIDDEN_SLICES; //boolean, when loading stack models work out which pixels of each slice can ever be seen and only draw those
+extern int STACK_MESH_SLICES; //boolean, when loading stack models trace each slice's solid pixels into a few quads and draw only inside them
+extern int STACK_ENCODE_BAKED_SPANS; //boolean, keep the pixels of stack models' baked rotations as runs of solid pixels, for the software renderer
+extern int STACK_BAKED_ROTATION_ANGLES; //angles stack models that ask for it have their slices pre-rotated to, 0 to never bake
+extern int STACK_BAKED_ROTATION_BUDGET_KB; //memory every model's baked rotations may use together, models past it rotate as they draw
+extern int STACK_USE_SOFTWARE_RENDERER; //boolean, rasterize the stack pass on the CPU instead of with the SDL renderer
+extern int STACK_SOFTWARE_RENDERER_THREADS; //threads the software renderer splits the buffer between, 0 for one per CPU core
+extern int STACK_SOFTWARE_FRONT_TO_BACK; //boolean, the software renderer draws top layers first and skips pixels they already cover
+extern int STACK_USE_RAYCASTER; //boolean, raycast a voxel grid of the scene on the CPU instead of drawing stacks, if the grid fits the budget
+extern int STACK_RAYCASTER_BUDGET_KB; //memory the raycaster's voxel grid may use, scenes that need more are drawn as stacks
+extern int STACK_USE_IMPOSTORS; //boolean, draw dynamic objects that don't overlap anything as one cached image each instead of a layer at a time
+extern int STACK_IMPOSTOR_BUDGET_KB; //texture memory the impostor cache may use before evicting
+extern float STACK_IMPOSTOR_ANGLE_STEP; //degrees, impostors are made at camera angles snapped to multiples of this
+extern float STACK_IMPOSTOR_PITCH_STEP; //and at pitches snapped to multiples of this
+extern int STACK_IMPOSTOR_BUILDS_PER_FRAME; //impostors made in one frame at most, the rest are drawn a layer at a time until there's room
+extern int STACK_USE_QUALITY_GOVERNOR; //boolean, lower the buffer scale, level of detail and gap filling when frames take too long
+extern float STACK_GOVERNOR_TARGET_MS; //the frame time the governor aims for, not counting waiting for vsync
+extern int STACK_GOVERNOR_MIN_BUFFER_SCALE; //the governor keeps the buffer scale between these, and starts at the max
+extern int STACK_GOVERNOR_MAX_BUFFER_SCALE; //also the scale used when the governor is off
+extern int STACK_GOVERNOR_MAX_LOD_BIAS; //levels of detail the governor may go coarser than the pitch calls for
+extern int STACK_GOVERNOR_MAX_GAP_FILL_DROP; //gap filling copies the governor may leave out of each layer
+extern int DEBUG_COMPARE_STACK_RENDERERS; //boolean, on the first frame draw with both renderers and log how different they are
+extern int STACK_USE_LOD; //boolean, draw merged slices instead of every layer when layers are packed close together
+extern float STACK_LOD_LAYER_SPACING; //buffer pixels, merged layers are only used while they'd land no further apart than this
+extern int DEBUG_SHOW_STACK_LOD; //boolean, tint merged slices by their level of detail (yellow for 2 layers, red for 4)
+extern int DEBUG_STACK_STRESS_SCENE; //boolean, fill a huge world with crates instead of the usual room, to check the world scales
+extern int DEBUG_BENCHMARK_STACK_TRANSFORMS; //boolean, on startup time rotating 10k objects a draw at a time against all at once, and log it
+extern int DEBUG_BENCHMARK_STACK_EDITS; //boolean, on startup time sending only the edited parts of a model's slices against sending them whole, and log it
+extern int DEBUG_BENCHMARK_STACK_SPANS; //boolean, on startup time the software renderer drawing a model's baked rotations from their pixels against their spans, and log it with the memory each takes
+extern int DEBUG_CHECK_VOX_CACHE; //boolean, on startup load the barrel's .vox without its cache and then from it, and log whether they match
+
 
 /////////////////////////////////////////////////
 // Loading
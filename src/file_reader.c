@@ -6,6 +6,7 @@
 #include "SDL2/SDL_rwops.h"
 
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #ifdef __WINDOWS__
     #include <io.h>
@@ -95,3 +96,33 @@ int fileExists(const char *filename){
     
     return result;
 }
+
+int getFileStats(const char *filename, long long *modifiedTime, long long *size){
+    struct stat info;
+    if (filename == NULL || stat(filename, &info) != 0){
+        return 0;
+    }
+    
+    *modifiedTime = info.st_mtime;
+    *size = info.st_size;
+    return 1;
+}
+
+int writeBinaryFile(const char *filename, const unsigned char *data, unsigned long length){
+    SDL_RWops *f;
+    
+    f = SDL_RWFromFile(filename, "wb");
+    if (f == NULL){
+        LOG_WAR("Unable to open file %s for writing: %s", filename, SDL_GetError());
+        return 0;
+    }
+    
+    size_t written = SDL_RWwrite(f, data, 1, length);
+    SDL_RWclose(f);
+    if (written != length){
+        LOG_WAR("Only wrote %lu of %lu bytes to %s: %s", (unsigned long)written, length, filename, SDL_GetError());
+        return 0;
+    }
+    
+    return 1;
+}
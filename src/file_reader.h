@@ -2,12 +2,15 @@
 #define FILE_READER_H
 
 /*
- * Code for reading text files.  Nothing about processing that data, which happens in data_reader or elsewhere.
+ * Code for reading (and occasionally writing) files.  Nothing about processing that data, which happens in data_reader or elsewhere.
  */
 
 
 char *readFileToString(const char *filename);
 unsigned char *readBinaryFileToCharStar(const char *filename, unsigned long *length);
 int fileExists(const char *filename);
+//for checking whether a cache built from a file is stale, returns 0 if the file can't be looked at
+int getFileStats(const char *filename, long long *modifiedTime, long long *size);
+int writeBinaryFile(const char *filename, const unsigned char *data, unsigned long length); //returns 1 on success, 0 on failure
 
 #endif
@@ -6,6 +6,7 @@
 #include "omni_exit.h"
 #include "graphics.h"
 #include "stack_frame.h"
+#include "quality_governor.h"
 
 #include "SDL2/SDL.h"
 
@@ -140,6 +141,8 @@ void gameLoop(){
     int runGameLoop = 1;
     int i;
     
+    Uint64 workStart = 0; //for the quality governor, which only wants the time spent working, not waiting on vsync
+    
     int currFrame = 0;
     int numFrames = 1;
     Frame *frames[FRAME_STACK_SIZE]; //this is hardcoded, just increase to match number of possible frames, as this will be small
@@ -150,6 +153,8 @@ void gameLoop(){
     //https://gafferongames.com/post/fix_your_timestep/
     currMilliseconds = SDL_GetTicks() - FRAME_TIMESTEP_MILLISECONDS; //has to be here otherwise we track time from game initialization, which is ~500 milliseconds on this computer, way too long
     while (runGameLoop){
+        workStart = SDL_GetPerformanceCounter();
+        
         //calculate the time delta - EVENTUALLY (after a month) the time will wrap, so I GUESS we should handle that
         prevMilliseconds = currMilliseconds;
         currMilliseconds = SDL_GetTicks();
@@ -257,6 +262,7 @@ void gameLoop(){
         }
         setDrawScaling(1); //UI scale for the framerate
         debugComputeAndDisplayFramerate(delta);//here we actually use delta because we want refresh rate
+        reportFrameTime(((SDL_GetPerformanceCounter() - workStart) * 1000.0) / SDL_GetPerformanceFrequency());
         bufferToScreen();
     }
 }
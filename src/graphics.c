@@ -10,10 +10,23 @@
 #include <string.h>
 #include <math.h>
 
+//SDL_RenderGeometry only exists from 2.0.18 onward, before that rotated draws can't be batched and just go through SDL_RenderCopyEx
+#define CAN_BATCH_GEOMETRY SDL_VERSION_ATLEAST(2, 0, 18)
+
 static ImageAtlas *init_ImageAtlas(ImageAtlas *self);
 static SDL_Surface *loadSurfaceFromFile(char *filename); //crashes on read failure 
 static SDL_Texture *loadTextureFromFile(char *filename); //crashes on read failure 
 static void addImageToBatchIfBatching(Image *toBeBatched);
+static void queueRotatedQuad(Image *image, ImageRect *srcRect, float pivotX, float pivotY, float left, float top, float angle);
+static void queueImageQuad(Image *image, const ImageQuad *quad, float x, float y, float angle);
+#if CAN_BATCH_GEOMETRY
+static SDL_Vertex *nextGeometryQuad(SDL_Texture *texture);
+#endif
+static void angleTrig(float angle, float *c, float *s);
+static void flushGeometryBatch();
+static Uint32 halfSizePixel(SDL_Surface *surface, int x, int y, int padX, int padY);
+static int isInsideRects(int x, int y, const ImageRect *rects, int numRects);
+static void freeImageSpans(ImageSpans *spans);
 
 
 /////////////////////////////////////////////////
@@ -31,6 +44,23 @@ static int isBatching = 0;
 static Image **imagesToBatch = NULL; //array of pointers
 static int numberOfImagesToBatch = 0;
 
+//rotated draws queued up to be submitted to SDL_RenderGeometry in one go, see startBatchingGeometry
+static int isBatchingGeometry = 0;
+#if CAN_BATCH_GEOMETRY
+static SDL_Texture *geometryTexture = NULL; //all queued quads sample from this texture
+static int geometryTextureWidth = 0;
+static int geometryTextureHeight = 0;
+static SDL_Vertex *geometryVertices = NULL; //4 per quad
+static int *geometryIndices = NULL; //6 per quad, two triangles; the pattern never changes so it is only written when growing
+static int numGeometryQuads = 0;
+static int geometryQuadCapacity = 0;
+
+//the last angle's sine and cosine, since a frame's rotated draws are nearly all at the same angle
+static float trigAngle = 0;
+static float trigCos = 1;
+static float trigSin = 0;
+#endif
+
 
 /////////////////////////////////////////////////
 // SDL
@@ -95,6 +125,14 @@ void initSDL(){
 }
 
 void stopSDL(){
+    #if CAN_BATCH_GEOMETRY
+    free(geometryVertices);
+    free(geometryIndices);
+    geometryVertices = NULL;
+    geometryIndices = NULL;
+    geometryQuadCapacity = 0;
+    #endif
+    
     SDL_Quit();
 }
 
@@ -112,6 +150,7 @@ int showErrorMessageBoxSDL(const char *message){
 Image *init_Image(Image *self){
     self->_texture = NULL;
     self->_surface = NULL;
+    self->_spans = NULL;
     self->_isShared = 0;
     self->_x = 0;
     self->_y = 0;
@@ -161,13 +200,15 @@ void free_Image(Image *self){
         return;
     }
     
-    //free SDL stuff only if it is not shared with another image
+    //free SDL stuff only if it is not shared with another image - surfaces are never shared though
     if (!self->_isShared){
         SDL_DestroyTexture(self->_texture); //not safe to pass NULL
-        SDL_FreeSurface(self->_surface); //safe to pass NULL
     }
+    SDL_FreeSurface(self->_surface); //safe to pass NULL
+    freeImageSpans(self->_spans);
     
     self->_surface = NULL;
+    self->_spans = NULL;
     self->_texture = NULL;
     self->_isShared = 0;
     self->_x = 0;
@@ -343,6 +384,532 @@ Image *loadImageFromFile(char *filename){
     return result;
 }
 
+Image *loadImageFromFileKeepPixels(char *filename){
+    /*
+     * Same as loadImageFromFile, but the pixels stay around in _surface for anything that draws on the CPU.
+     * Converting to a format with alpha turns the color key into transparent pixels.
+     */
+    SDL_Surface *loaded = loadSurfaceFromFile(filename);
+    SDL_Surface *converted = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA8888, 0);
+    SDL_FreeSurface(loaded);
+    if (converted == NULL){
+        LOG_ERR("Failed to convert %s to RGBA8888: %s", filename, SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    Image *result = init_Image(malloc(sizeof(Image)));
+    result->_texture = SDL_CreateTextureFromSurface(renderer, converted);
+    if (result->_texture == NULL){
+        LOG_ERR("Problem converting an SDL_Surface to an SDL_Texture!");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    result->_surface = converted;
+    result->width = converted->w;
+    result->height = converted->h;
+    
+    addImageToBatchIfBatching(result);
+    return result;
+}
+
+Image *createImageFromPixels(int width, int height, const Uint32 *pixels){
+    /*
+     * For images made in code rather than loaded, kept around for the CPU like loadImageFromFileKeepPixels
+     */
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA8888);
+    if (surface == NULL){
+        LOG_ERR("Failed to create %dx%d surface: %s", width, height, SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+    int y;
+    for (y = 0; y < height; y++){
+        memcpy((Uint8 *)surface->pixels + (y * surface->pitch), pixels + (y * width), width * 4);
+    }
+    
+    Image *result = init_Image(malloc(sizeof(Image)));
+    result->_texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if (result->_texture == NULL){
+        LOG_ERR("Problem converting an SDL_Surface to an SDL_Texture!");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    SDL_SetTextureBlendMode(result->_texture, SDL_BLENDMODE_BLEND);
+    result->_surface = surface;
+    result->width = width;
+    result->height = height;
+    
+    addImageToBatchIfBatching(result);
+    return result;
+}
+
+Image **loadImageSlicesFromFile(char *filename, int numSlices, int horizontal){
+    return loadImageSlicesFromFileSharingRepeats(filename, numSlices, horizontal, 0);
+}
+
+Image **loadImageSlicesFromFileSharingRepeats(char *filename, int numSlices, int horizontal, int period){
+    /*
+     * Cuts a sheet of equally sized slices into an image per slice, like loadImageFromFileKeepPixels does for a whole
+     * file.  Each slice gets its own texture so that when batching they're packed into atlases like any other image.
+     * With a period, sheets that repeat themselves (like the frames of an animation) only get a texture for the
+     * slices that changed, the rest point back at the same image.
+     */
+    SDL_Surface *loaded = loadSurfaceFromFile(filename);
+    SDL_Surface *sheet = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA8888, 0);
+    SDL_FreeSurface(loaded);
+    if (sheet == NULL){
+        LOG_ERR("Failed to convert %s to RGBA8888: %s", filename, SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    int sliceWidth = horizontal ? sheet->w / numSlices : sheet->w;
+    int sliceHeight = horizontal ? sheet->h : sheet->h / numSlices;
+    if (numSlices <= 0 || sliceWidth * (horizontal ? numSlices : 1) != sheet->w || sliceHeight * (horizontal ? 1 : numSlices) != sheet->h){
+        LOG_ERR("%s is %dx%d, which can't be cut into %d %s slices", filename, sheet->w, sheet->h, numSlices, horizontal ? "horizontal" : "vertical");
+        displayErrorAndExit("Failed to load graphics file");
+    }
+    
+    Image **result = malloc(sizeof(Image *) * numSlices);
+    SDL_Surface *slice;
+    Uint8 *sheetPixel;
+    Uint8 *repeatPixel;
+    int i, y, isRepeat;
+    for (i = 0; i < numSlices; i++){
+        if (period > 0 && i >= period){
+            isRepeat = 1;
+            for (y = 0; y < sliceHeight && isRepeat; y++){
+                sheetPixel = (Uint8 *)sheet->pixels + ((horizontal ? y : (i * sliceHeight) + y) * sheet->pitch) + ((horizontal ? i * sliceWidth : 0) * 4);
+                repeatPixel = (Uint8 *)sheet->pixels + ((horizontal ? y : ((i - period) * sliceHeight) + y) * sheet->pitch) + ((horizontal ? (i - period) * sliceWidth : 0) * 4);
+                isRepeat = memcmp(sheetPixel, repeatPixel, sliceWidth * 4) == 0;
+            }
+            if (isRepeat){
+                result[i] = result[i - period];
+                continue;
+            }
+        }
+        
+        slice = SDL_CreateRGBSurfaceWithFormat(0, sliceWidth, sliceHeight, 32, SDL_PIXELFORMAT_RGBA8888);
+        if (slice == NULL){
+            LOG_ERR("Failed to create surface for slice %d of %s: %s", i, filename, SDL_GetError());
+            displayErrorAndExit("Graphics error encountered");
+        }
+        
+        //same format on both sides, so the rows can be copied straight across
+        for (y = 0; y < sliceHeight; y++){
+            sheetPixel = (Uint8 *)sheet->pixels + ((horizontal ? y : (i * sliceHeight) + y) * sheet->pitch) + ((horizontal ? i * sliceWidth : 0) * 4);
+            memcpy((Uint8 *)slice->pixels + (y * slice->pitch), sheetPixel, sliceWidth * 4);
+        }
+        
+        result[i] = init_Image(malloc(sizeof(Image)));
+        result[i]->_texture = SDL_CreateTextureFromSurface(renderer, slice);
+        if (result[i]->_texture == NULL){
+            LOG_ERR("Problem converting an SDL_Surface to an SDL_Texture!");
+            displayErrorAndExit("Graphics error encountered");
+        }
+        result[i]->_surface = slice;
+        result[i]->width = sliceWidth;
+        result[i]->height = sliceHeight;
+        
+        addImageToBatchIfBatching(result[i]);
+    }
+    SDL_FreeSurface(sheet);
+    
+    return result;
+}
+
+Image *createHalfSizeImage(Image *image, int padX, int padY){
+    SDL_Surface *surface = image->_surface;
+    if (surface == NULL){
+        LOG_ERR("Can't make a half size copy of an image that didn't keep its pixels");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    int width = (surface->w + padX + 1) / 2;
+    int height = (surface->h + padY + 1) / 2;
+    Uint32 *pixels = malloc(sizeof(Uint32) * width * height);
+    int x, y;
+    for (y = 0; y < height; y++){
+        for (x = 0; x < width; x++){
+            pixels[(y * width) + x] = halfSizePixel(surface, x, y, padX, padY);
+        }
+    }
+    
+    Image *result = createImageFromPixels(width, height, pixels);
+    free(pixels);
+    return result;
+}
+
+void updateHalfSizeImage(Image *half, Image *image, int padX, int padY, const ImageRect *rect, ImageRect *halfRect){
+    SDL_Surface *surface = image->_surface;
+    SDL_Surface *halfSurface = half->_surface;
+    if (surface == NULL || halfSurface == NULL){
+        LOG_ERR("Can't update a half size copy of an image that didn't keep its pixels");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    //every half size pixel with a bit of the rect in its block
+    int left = (rect->x + padX) / 2;
+    int top = (rect->y + padY) / 2;
+    int right = (rect->x + rect->w - 1 + padX) / 2 + 1;
+    int bottom = (rect->y + rect->h - 1 + padY) / 2 + 1;
+    left = (left < 0) ? 0 : left;
+    top = (top < 0) ? 0 : top;
+    right = (right > halfSurface->w) ? halfSurface->w : right;
+    bottom = (bottom > halfSurface->h) ? halfSurface->h : bottom;
+    
+    int x, y;
+    for (y = top; y < bottom; y++){
+        for (x = left; x < right; x++){
+            ((Uint32 *)((Uint8 *)halfSurface->pixels + (y * halfSurface->pitch)))[x] = halfSizePixel(surface, x, y, padX, padY);
+        }
+    }
+    
+    halfRect->x = left;
+    halfRect->y = top;
+    halfRect->w = (right > left) ? right - left : 0;
+    halfRect->h = (bottom > top) ? bottom - top : 0;
+    updateImageTexture(half, halfRect);
+}
+
+Uint32 halfSizePixel(SDL_Surface *surface, int x, int y, int padX, int padY){
+    /*
+     * The average of a 2x2 block of the original, with the colors weighted by alpha so the transparent pixels
+     * around the edges don't drag them towards black.  Pixels off the edge of the original count as transparent.
+     */
+    int u, v, i;
+    Uint32 pixel, alpha;
+    Uint32 red = 0, green = 0, blue = 0, totalAlpha = 0;
+    for (i = 0; i < 4; i++){
+        u = (x * 2) + (i % 2) - padX;
+        v = (y * 2) + (i / 2) - padY;
+        if (u < 0 || v < 0 || u >= surface->w || v >= surface->h){
+            continue;
+        }
+        pixel = ((Uint32 *)((Uint8 *)surface->pixels + (v * surface->pitch)))[u];
+        alpha = pixel & 0xFF;
+        red += ((pixel >> 24) & 0xFF) * alpha;
+        green += ((pixel >> 16) & 0xFF) * alpha;
+        blue += ((pixel >> 8) & 0xFF) * alpha;
+        totalAlpha += alpha;
+    }
+    
+    if (totalAlpha == 0){
+        return 0;
+    }
+    red = (red + (totalAlpha / 2)) / totalAlpha;
+    green = (green + (totalAlpha / 2)) / totalAlpha;
+    blue = (blue + (totalAlpha / 2)) / totalAlpha;
+    return (red << 24) | (green << 16) | (blue << 8) | ((totalAlpha + 2) / 4);
+}
+
+void updateImageTexture(Image *image, const ImageRect *rect){
+    /*
+     * For images whose kept pixels were changed after loading.  Only the rect goes up, at wherever the image sits in
+     * its texture, so changing a few pixels of an image packed into an atlas page doesn't mean sending the page.
+     */
+    SDL_Surface *surface = image->_surface;
+    if (surface == NULL){
+        LOG_ERR("Can't update the texture of an image that didn't keep its pixels");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    SDL_Rect r;
+    r.x = (rect != NULL) ? rect->x : 0;
+    r.y = (rect != NULL) ? rect->y : 0;
+    r.w = (rect != NULL) ? rect->w : image->width;
+    r.h = (rect != NULL) ? rect->h : image->height;
+    if (r.w <= 0 || r.h <= 0){
+        return;
+    }
+    const Uint8 *pixels = (const Uint8 *)surface->pixels + (r.y * surface->pitch) + (r.x * 4);
+    r.x += image->_x;
+    r.y += image->_y;
+    
+    flushGeometryBatch(); //anything queued from the old pixels has to go first
+    if (SDL_UpdateTexture(image->_texture, &r, pixels, surface->pitch) != 0){
+        LOG_ERR("Call to SDL_UpdateTexture failed: %s", SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+}
+
+ImageQuad *traceImageQuads(Image *image, const ImageRect *within, int numWithin, int maxQuads, int *numQuads){
+    /*
+     * Goes down the image a row at a time, finding the runs of pixels with any alpha.  A run carries on the
+     * trapezoid above it if it's the only run touching it, and both its ends have moved the same number of pixels
+     * as they did last row (up to maxTraceSlope), so a straight edge at an angle costs one quad instead of a
+     * staircase of them.  The trapezoid's sides go through the outside corners of the steps, so every pixel of
+     * every run is inside, with a bit of transparent border along the slopes.
+     */
+    SDL_Surface *surface = image->_surface;
+    if (surface == NULL){
+        LOG_ERR("Can't trace an image that didn't keep its pixels");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    typedef struct Trace{
+        int top; //row it starts on
+        int rows;
+        int firstLeft, firstRight; //its first run, right is one past the end
+        int lastLeft, lastRight; //its latest run
+        int slopeLeft, slopeRight; //pixels the ends move each row
+        int extended; //whether this row carried it on
+    } Trace;
+    const int maxTraceSlope = 3;
+    int width = surface->w;
+    int height = surface->h;
+    Trace *traces = malloc(sizeof(Trace) * (width + 1));
+    Trace *nextTraces = malloc(sizeof(Trace) * (width + 1));
+    int *runLeft = malloc(sizeof(int) * (width + 1));
+    int *runRight = malloc(sizeof(int) * (width + 1));
+    int numTraces = 0;
+    int numNextTraces, numRuns;
+    ImageQuad *result = malloc(sizeof(ImageQuad) * (maxQuads + 1));
+    int count = 0;
+    int x, y, i, k, r, overlaps, match, dl, dr, opaque;
+    Trace *trace;
+    Uint32 *row;
+    
+    for (y = 0; y <= height && count <= maxQuads; y++){
+        //this row's runs, none past the bottom so everything left gets closed
+        numRuns = 0;
+        if (y < height){
+            row = (Uint32 *)((Uint8 *)surface->pixels + (y * surface->pitch));
+            for (x = 0; x < width; x++){
+                opaque = (row[x] & 0xFF) != 0 && isInsideRects(x, y, within, numWithin);
+                if (opaque && (numRuns == 0 || runRight[numRuns - 1] != x)){
+                    runLeft[numRuns] = x;
+                    runRight[numRuns] = x + 1;
+                    numRuns++;
+                } else if (opaque){
+                    runRight[numRuns - 1] = x + 1;
+                }
+            }
+        }
+        
+        for (k = 0; k < numTraces; k++){
+            traces[k].extended = 0;
+        }
+        numNextTraces = 0;
+        for (r = 0; r < numRuns; r++){
+            //the one trace touching this run, if it touches no other run
+            match = -1;
+            overlaps = 0;
+            for (k = 0; k < numTraces; k++){
+                if (runLeft[r] < traces[k].lastRight && runRight[r] > traces[k].lastLeft){
+                    match = k;
+                    overlaps++;
+                }
+            }
+            if (overlaps == 1){
+                trace = traces + match;
+                for (i = 0; i < numRuns; i++){
+                    if (i != r && runLeft[i] < trace->lastRight && runRight[i] > trace->lastLeft){
+                        overlaps++;
+                    }
+                }
+            }
+            
+            if (overlaps == 1){
+                dl = runLeft[r] - trace->lastLeft;
+                dr = runRight[r] - trace->lastRight;
+                if (trace->rows == 1){
+                    //the slopes are set by the second row, and the top corners can't leave the image
+                    match = abs(dl) <= maxTraceSlope && abs(dr) <= maxTraceSlope
+                        && trace->firstLeft - ((dl > 0) ? dl : 0) >= 0 && trace->firstRight - ((dr < 0) ? dr : 0) <= width;
+                } else {
+                    match = dl == trace->slopeLeft && dr == trace->slopeRight;
+                }
+                //nor the bottom ones
+                match = match && runLeft[r] + ((dl < 0) ? dl : 0) >= 0 && runRight[r] + ((dr > 0) ? dr : 0) <= width;
+                if (match){
+                    trace->slopeLeft = dl;
+                    trace->slopeRight = dr;
+                    trace->lastLeft = runLeft[r];
+                    trace->lastRight = runRight[r];
+                    trace->rows++;
+                    trace->extended = 1;
+                    continue;
+                }
+            }
+            
+            trace = nextTraces + numNextTraces;
+            numNextTraces++;
+            trace->top = y;
+            trace->rows = 1;
+            trace->firstLeft = runLeft[r];
+            trace->firstRight = runRight[r];
+            trace->lastLeft = runLeft[r];
+            trace->lastRight = runRight[r];
+            trace->slopeLeft = 0;
+            trace->slopeRight = 0;
+        }
+        
+        //whatever didn't carry on is finished, the rest join the ones that started this row
+        for (k = 0; k < numTraces; k++){
+            trace = traces + k;
+            if (trace->extended){
+                nextTraces[numNextTraces] = *trace;
+                numNextTraces++;
+                continue;
+            }
+            if (count >= maxQuads){
+                count++;
+                break;
+            }
+            result[count].x[0] = trace->firstLeft - ((trace->slopeLeft > 0) ? trace->slopeLeft : 0);
+            result[count].y[0] = trace->top;
+            result[count].x[1] = trace->firstRight - ((trace->slopeRight < 0) ? trace->slopeRight : 0);
+            result[count].y[1] = trace->top;
+            result[count].x[2] = trace->lastRight + ((trace->slopeRight > 0) ? trace->slopeRight : 0);
+            result[count].y[2] = trace->top + trace->rows;
+            result[count].x[3] = trace->lastLeft + ((trace->slopeLeft < 0) ? trace->slopeLeft : 0);
+            result[count].y[3] = trace->top + trace->rows;
+            count++;
+        }
+        trace = traces;
+        traces = nextTraces;
+        nextTraces = trace;
+        numTraces = numNextTraces;
+    }
+    
+    free(traces);
+    free(nextTraces);
+    free(runLeft);
+    free(runRight);
+    if (count > maxQuads){
+        free(result);
+        *numQuads = 0;
+        return NULL;
+    }
+    *numQuads = count;
+    return result;
+}
+
+float imageQuadsArea(const ImageQuad *quads, int numQuads){
+    //shoelace, the corners are in order
+    int i, k;
+    float area = 0;
+    float twice;
+    for (i = 0; i < numQuads; i++){
+        twice = 0;
+        for (k = 0; k < 4; k++){
+            twice += (quads[i].x[k] * quads[i].y[(k + 1) % 4]) - (quads[i].x[(k + 1) % 4] * quads[i].y[k]);
+        }
+        area += fabsf(twice) / 2;
+    }
+    return area;
+}
+
+int isInsideRects(int x, int y, const ImageRect *rects, int numRects){
+    //no rects means everywhere
+    int i;
+    if (numRects <= 0){
+        return 1;
+    }
+    for (i = 0; i < numRects; i++){
+        if (x >= rects[i].x && x < rects[i].x + rects[i].w && y >= rects[i].y && y < rects[i].y + rects[i].h){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void encodeImageSpans(Image *image, const ImageRect *within, int numWithin, int keepPixels){
+    SDL_Surface *surface = image->_surface;
+    if (surface == NULL){
+        LOG_ERR("Can't encode an image that didn't keep its pixels");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    if (surface->w > 65535){
+        LOG_ERR("Image is too wide to encode as spans");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    //counting first, so everything is allocated once at the right size
+    ImageSpans *result = malloc(sizeof(ImageSpans));
+    int x, y, inside, pass;
+    int numSpans = 0;
+    int numPixels = 0;
+    Uint32 *row;
+    for (pass = 0; pass < 2; pass++){
+        if (pass == 1){
+            result->spans = malloc(sizeof(ImageSpan) * ((numSpans > 0) ? numSpans : 1));
+            result->rowSpans = malloc(sizeof(int) * (surface->h + 1));
+            result->pixels = malloc(sizeof(Uint32) * ((numPixels > 0) ? numPixels : 1));
+            numSpans = 0;
+            numPixels = 0;
+        }
+        for (y = 0; y < surface->h; y++){
+            row = (Uint32 *)((Uint8 *)surface->pixels + (y * surface->pitch));
+            if (pass == 1){
+                result->rowSpans[y] = numSpans;
+            }
+            for (x = 0; x < surface->w; x++){
+                inside = (row[x] & 0xFF) != 0 && isInsideRects(x, y, within, numWithin);
+                if (!inside){
+                    continue;
+                }
+                //a new span unless the last one ended right before this pixel, in this row
+                if (pass == 1 && (numSpans == result->rowSpans[y] || result->spans[numSpans - 1].x + result->spans[numSpans - 1].length != x)){
+                    result->spans[numSpans].x = x;
+                    result->spans[numSpans].length = 0;
+                    result->spans[numSpans].offset = numPixels;
+                    numSpans++;
+                } else if (pass == 0 && (x == 0 || (row[x - 1] & 0xFF) == 0 || !isInsideRects(x - 1, y, within, numWithin))){
+                    numSpans++;
+                }
+                if (pass == 1){
+                    result->spans[numSpans - 1].length++;
+                    result->pixels[numPixels] = row[x];
+                }
+                numPixels++;
+            }
+        }
+    }
+    result->rowSpans[surface->h] = numSpans;
+    result->width = surface->w;
+    result->height = surface->h;
+    
+    freeImageSpans(image->_spans);
+    image->_spans = result;
+    if (!keepPixels){
+        SDL_FreeSurface(image->_surface);
+        image->_surface = NULL;
+    }
+}
+
+Uint32 getImageSpansPixel(const ImageSpans *spans, int x, int y){
+    //rows only have a few spans, so looking through them is quick enough
+    int i;
+    const ImageSpan *span;
+    if ((unsigned)y >= (unsigned)spans->height){
+        return 0;
+    }
+    for (i = spans->rowSpans[y]; i < spans->rowSpans[y + 1]; i++){
+        span = spans->spans + i;
+        if (x < span->x){
+            return 0;
+        } else if (x < span->x + span->length){
+            return spans->pixels[span->offset + x - span->x];
+        }
+    }
+    return 0;
+}
+
+int imageSpansBytes(const ImageSpans *spans){
+    //the last span ends where the pixels do
+    int numSpans = spans->rowSpans[spans->height];
+    int numPixels = (numSpans > 0) ? spans->spans[numSpans - 1].offset + spans->spans[numSpans - 1].length : 0;
+    return sizeof(ImageSpans) + (numSpans * sizeof(ImageSpan)) + ((spans->height + 1) * sizeof(int)) + (numPixels * sizeof(Uint32));
+}
+
+void freeImageSpans(ImageSpans *spans){
+    if (spans == NULL){
+        return;
+    }
+    free(spans->spans);
+    free(spans->rowSpans);
+    free(spans->pixels);
+    free(spans);
+}
+
 void deepCopy_Animation(Animation *to, Animation *from){
     to->numLoops = from->numLoops;
     
@@ -627,6 +1194,7 @@ void setAnimationLoop(Animation *self, int loop, int forceRestart){
 // Drawing
 /////////////////////////////////////////////////
 void drawImage(Image *image, int x, int y){
+    flushGeometryBatch(); //keep draw order intact
     SDL_Rect src, dest;
     
     src.x = image->_x;
@@ -646,17 +1214,29 @@ void drawImage(Image *image, int x, int y){
 }
 
 void drawImageRotate(Image *image, float x, float y, float angle, int centerX, int centerY){
+    drawImageSrcRotate(image, NULL, x, y, angle, centerX, centerY);
+}
+
+void drawImageSrcRotate(Image *image, ImageRect *srcRect, float x, float y, float angle, int centerX, int centerY){
+    if (isBatchingGeometry){
+        //the destination rectangle is truncated to ints like below, and the pivot is relative to its top left
+        int destX = x;
+        int destY = y;
+        queueRotatedQuad(image, srcRect, destX + centerX, destY + centerY, -centerX, -centerY, angle);
+        return;
+    }
+    
     SDL_Rect src, dest;
     
-    src.x = image->_x;
-    src.y = image->_y;
-    src.w = image->width;
-    src.h = image->height;
+    src.x = image->_x + ((srcRect != NULL) ? srcRect->x : 0);
+    src.y = image->_y + ((srcRect != NULL) ? srcRect->y : 0);
+    src.w = (srcRect != NULL) ? srcRect->w : image->width;
+    src.h = (srcRect != NULL) ? srcRect->h : image->height;
     
     dest.x = x;
     dest.y = y;
-    dest.w = image->width;
-    dest.h = image->height;
+    dest.w = src.w;
+    dest.h = src.h;
     
     SDL_Point center;
     center.x = centerX;
@@ -669,7 +1249,199 @@ void drawImageRotate(Image *image, float x, float y, float angle, int centerX, i
     }
 }
 
+void drawImagePreRotated(Image *image, ImageRect *srcRect, float x, float y, float angle){
+    if (isBatchingGeometry){
+        queueRotatedQuad(image, srcRect, x, y, 0, 0, angle);
+        return;
+    }
+    
+    //rotating about the top left corner leaves it where it is
+    SDL_Rect src, dest;
+    src.x = image->_x + ((srcRect != NULL) ? srcRect->x : 0);
+    src.y = image->_y + ((srcRect != NULL) ? srcRect->y : 0);
+    src.w = (srcRect != NULL) ? srcRect->w : image->width;
+    src.h = (srcRect != NULL) ? srcRect->h : image->height;
+    dest.x = lroundf(x);
+    dest.y = lroundf(y);
+    dest.w = src.w;
+    dest.h = src.h;
+    SDL_Point center;
+    center.x = 0;
+    center.y = 0;
+    
+    //a plain copy is a lot cheaper than an angled one on some renderers
+    int failed = (angle == 0) ? SDL_RenderCopy(renderer, image->_texture, &src, &dest) : SDL_RenderCopyEx(renderer, image->_texture, &src, &dest, angle, &center, SDL_FLIP_NONE);
+    if (failed != 0){
+        LOG_ERR("Call to SDL_RenderCopy failed: %s", SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+}
+
+void drawImageQuadsPreRotated(Image *image, const ImageQuad *quads, int numQuads, float x, float y, float angle){
+    #if CAN_BATCH_GEOMETRY
+    int i;
+    for (i = 0; i < numQuads; i++){
+        queueImageQuad(image, quads + i, x, y, angle);
+    }
+    //on their own they still go as one submission
+    if (!isBatchingGeometry){
+        flushGeometryBatch();
+    }
+    #else
+    drawImagePreRotated(image, NULL, x, y, angle);
+    #endif
+}
+
+void startBatchingGeometry(){
+    if (isBatchingGeometry){
+        LOG_WAR("Tried to start batching geometry when already batching");
+    }
+    
+    #if CAN_BATCH_GEOMETRY
+    isBatchingGeometry = 1;
+    #endif
+}
+
+void stopBatchingGeometry(){
+    flushGeometryBatch();
+    isBatchingGeometry = 0;
+    #if CAN_BATCH_GEOMETRY
+    geometryTexture = NULL;
+    #endif
+}
+
+void queueRotatedQuad(Image *image, ImageRect *srcRect, float pivotX, float pivotY, float left, float top, float angle){
+    #if CAN_BATCH_GEOMETRY
+    SDL_Vertex *v = nextGeometryQuad(image->_texture);
+    
+    /*
+     * Same math as SDL_RenderCopyEx - each corner is rotated clockwise (y points down) about the pivot, and left and
+     * top are where the image's top left corner is relative to the pivot before rotating
+     */
+    int srcX = image->_x + ((srcRect != NULL) ? srcRect->x : 0);
+    int srcY = image->_y + ((srcRect != NULL) ? srcRect->y : 0);
+    int srcW = (srcRect != NULL) ? srcRect->w : image->width;
+    int srcH = (srcRect != NULL) ? srcRect->h : image->height;
+    float c, s;
+    angleTrig(angle, &c, &s);
+    float right = left + srcW;
+    float bottom = top + srcH;
+    
+    //corners go clockwise starting at the top left, matching the index pattern
+    v[0].position.x = pivotX + (c * left) - (s * top);
+    v[0].position.y = pivotY + (s * left) + (c * top);
+    v[1].position.x = pivotX + (c * right) - (s * top);
+    v[1].position.y = pivotY + (s * right) + (c * top);
+    v[2].position.x = pivotX + (c * right) - (s * bottom);
+    v[2].position.y = pivotY + (s * right) + (c * bottom);
+    v[3].position.x = pivotX + (c * left) - (s * bottom);
+    v[3].position.y = pivotY + (s * left) + (c * bottom);
+    
+    float u0 = (float)srcX / geometryTextureWidth;
+    float u1 = (float)(srcX + srcW) / geometryTextureWidth;
+    float v0 = (float)srcY / geometryTextureHeight;
+    float v1 = (float)(srcY + srcH) / geometryTextureHeight;
+    v[0].tex_coord.x = u0;
+    v[0].tex_coord.y = v0;
+    v[1].tex_coord.x = u1;
+    v[1].tex_coord.y = v0;
+    v[2].tex_coord.x = u1;
+    v[2].tex_coord.y = v1;
+    v[3].tex_coord.x = u0;
+    v[3].tex_coord.y = v1;
+    #endif
+}
+
+void queueImageQuad(Image *image, const ImageQuad *quad, float x, float y, float angle){
+    #if CAN_BATCH_GEOMETRY
+    //like queueRotatedQuad about the top left corner, but the corners can be anywhere in the image
+    SDL_Vertex *v = nextGeometryQuad(image->_texture);
+    float c, s;
+    angleTrig(angle, &c, &s);
+    int i;
+    for (i = 0; i < 4; i++){
+        v[i].position.x = x + (c * quad->x[i]) - (s * quad->y[i]);
+        v[i].position.y = y + (s * quad->x[i]) + (c * quad->y[i]);
+        v[i].tex_coord.x = (image->_x + quad->x[i]) / geometryTextureWidth;
+        v[i].tex_coord.y = (image->_y + quad->y[i]) / geometryTextureHeight;
+    }
+    #endif
+}
+
+#if CAN_BATCH_GEOMETRY
+SDL_Vertex *nextGeometryQuad(SDL_Texture *texture){
+    //everything in one submission must come from the same texture, so a new texture means sending what we have
+    if (texture != geometryTexture){
+        flushGeometryBatch();
+        geometryTexture = texture;
+        SDL_QueryTexture(geometryTexture, NULL, NULL, &geometryTextureWidth, &geometryTextureHeight);
+    }
+    
+    //grow the buffers, writing the index pattern for the new quads as we go
+    int i;
+    if (numGeometryQuads >= geometryQuadCapacity){
+        geometryQuadCapacity = (geometryQuadCapacity == 0) ? 256 : geometryQuadCapacity * 2;
+        geometryVertices = realloc(geometryVertices, sizeof(SDL_Vertex) * 4 * geometryQuadCapacity);
+        geometryIndices = realloc(geometryIndices, sizeof(int) * 6 * geometryQuadCapacity);
+        for (i = numGeometryQuads; i < geometryQuadCapacity; i++){
+            geometryIndices[i*6 + 0] = i*4 + 0;
+            geometryIndices[i*6 + 1] = i*4 + 1;
+            geometryIndices[i*6 + 2] = i*4 + 2;
+            geometryIndices[i*6 + 3] = i*4 + 0;
+            geometryIndices[i*6 + 4] = i*4 + 2;
+            geometryIndices[i*6 + 5] = i*4 + 3;
+        }
+    }
+    
+    //the caller fills in the corners
+    SDL_Vertex *v = geometryVertices + (numGeometryQuads * 4);
+    for (i = 0; i < 4; i++){
+        v[i].color.r = 255;
+        v[i].color.g = 255;
+        v[i].color.b = 255;
+        v[i].color.a = SDL_ALPHA_OPAQUE;
+    }
+    numGeometryQuads++;
+    return v;
+}
+#endif
+
+void angleTrig(float angle, float *c, float *s){
+    //unrotated draws mixed in don't throw out the remembered angle
+    if (angle == 0){
+        *c = 1;
+        *s = 0;
+        return;
+    }
+    if (angle != trigAngle){
+        float radians = angle * (M_PI / 180.0);
+        trigCos = cosf(radians);
+        trigSin = sinf(radians);
+        trigAngle = angle;
+    }
+    *c = trigCos;
+    *s = trigSin;
+}
+
+void flushGeometryBatch(){
+    #if CAN_BATCH_GEOMETRY
+    if (numGeometryQuads == 0){
+        return;
+    }
+    
+    if (SDL_RenderGeometry(renderer, geometryTexture, geometryVertices, numGeometryQuads * 4, geometryIndices, numGeometryQuads * 6) != 0){
+        LOG_ERR("Call to SDL_RenderGeometry failed: %s", SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    numGeometryQuads = 0;
+    //textures come and go every frame, and a new one can land where a freed one was, so never trust the remembered size past here
+    geometryTexture = NULL;
+    #endif
+}
+
 void drawImageToImage(Image *src, Image *dst, ImageRect *srcRect, ImageRect *dstRect){
+    flushGeometryBatch(); //keep draw order intact
     //create SDL_Rects from ImageRects - PIZZA make internal method for this conversion
     SDL_Rect sR, dR;
     SDL_Rect *sRPtr, *dRPtr;
@@ -706,6 +1478,7 @@ void drawImageToImage(Image *src, Image *dst, ImageRect *srcRect, ImageRect *dst
 }
 
 void drawImageSrcDst(Image *image, ImageRect *srcRect, ImageRect *dstRect){
+    flushGeometryBatch(); //keep draw order intact
     //create SDL_Rects from ImageRects - PIZZA make internal method for this conversion
     SDL_Rect sR, dR;
     SDL_Rect *sRPtr, *dRPtr;
@@ -731,6 +1504,7 @@ void drawImageSrcDst(Image *image, ImageRect *srcRect, ImageRect *dstRect){
 }
 
 void drawUnfilledRect(int x, int y, int w, int h, int r, int g, int b){
+    flushGeometryBatch(); //keep draw order intact
     /*
      * Set the color, draw the rectangle, revert the color to black
      */
@@ -757,6 +1531,7 @@ void drawFilledRect(int x, int y, int w, int h, int r, int g, int b){
 }
 
 void drawFilledRectA(int x, int y, int w, int h, int r, int g, int b, int a){
+    flushGeometryBatch(); //keep draw order intact
     /*
      * Set the color, draw the rectangle, revert the color to black
      */
@@ -789,6 +1564,7 @@ void drawFilledRectA(int x, int y, int w, int h, int r, int g, int b, int a){
 }
 
 void drawLine(int x1, int y1, int x2, int y2, int r, int g, int b){
+    flushGeometryBatch(); //keep draw order intact
     /*
      * Set the color, draw the line, revert the color to black
      */
@@ -840,6 +1616,7 @@ void drawAnimation(Sprite *s, Animation *anim, int x, int y){
 // Screen Management
 /////////////////////////////////////////////////
 void clearScreen(){
+    flushGeometryBatch(); //keep draw order intact
     if (SDL_SetRenderDrawColor(renderer, 255, 0, 0, SDL_ALPHA_OPAQUE) != 0){
         LOG_ERR("Call to SDL_SetRenderDrawColor failed: %s", SDL_GetError());
         displayErrorAndExit("Graphics error encountered");
@@ -852,9 +1629,11 @@ void clearScreen(){
 }
 
 void bufferToScreen(){
+    flushGeometryBatch(); //keep draw order intact
     SDL_RenderPresent(renderer); //returns no status, cannot check for failure
 }
 
 void setDrawScaling(int scaling){
+    flushGeometryBatch(); //keep draw order intact
     SDL_RenderSetScale(renderer, scaling, scaling);
 }
@@ -24,13 +24,33 @@ extern SDL_Renderer *renderer;
 /////////////////////////////////////////////////
 // Structs
 /////////////////////////////////////////////////
+//a run of pixels in one row of an image that aren't fully transparent
+typedef struct ImageSpan{
+    Uint16 x;
+    Uint16 length;
+    Uint32 offset; //of its first pixel in ImageSpans' pixels
+} ImageSpan;
+
+//an image's pixels run length encoded a row at a time, keeping only the runs that aren't fully transparent
+typedef struct ImageSpans{
+    ImageSpan *spans; //array, row by row, left to right
+    int *rowSpans; //array [row], index of the row's first span, with one more at the end for the total
+    Uint32 *pixels; //array, RGBA8888 like _surface, only what's inside the spans
+    int width;
+    int height;
+} ImageSpans;
+
 //The base abstract type for all raster graphics in the engine
 typedef struct Image{
     //What is actually used for drawing with SDL
     SDL_Texture *_texture;
-    //not actually used, a holdover from when we used SDL1.  Sometimes surfaces are used for loading, but then they should be converted
-    //at the moment this is always NULL, but I'm going to leave it as its easier to access pixel data through a surface than a texture, so if we need that its easy to modify
+    //a holdover from when we used SDL1.  Sometimes surfaces are used for loading, but then they should be converted
+    //usually NULL, but images loaded with loadImageFromFileKeepPixels keep an RGBA8888 copy here for drawing on the CPU
+    //unlike the texture this is never shared, and covers only this image (so ignore _x and _y)
     SDL_Surface *_surface;
+    //NULL unless encodeImageSpans was called, then the same pixels as spans, which can stand in for _surface when
+    //drawing on the CPU; never shared either
+    ImageSpans *_spans;
     //whether or not the texture is shared through a texture atlas
     int _isShared;
     //the underlying texture may actually contain more than just this image, so offset the draws to these coordinates
@@ -58,6 +78,12 @@ typedef struct ImageRect{
     int h;
 } ImageRect;
 
+//part of an image to draw, corners clockwise from the top left in the image's pixels, always convex
+typedef struct ImageQuad{
+    float x[4];
+    float y[4];
+} ImageQuad;
+
 //Probably ought to be called a spritesheet properly - an image along with data about how to cut up said image into rectangles,
 //each rectangle being a frame.  Frames are numbered starting from 0, right and down
 typedef struct Sprite{
@@ -125,6 +151,21 @@ void free_Animation(Animation *self);
  */
 Image *createEmptyImage(int width, int height);
 Image *loadImageFromFile(char *filename);
+Image *loadImageFromFileKeepPixels(char *filename); //also keeps the pixels in _surface
+Image *createImageFromPixels(int width, int height, const Uint32 *pixels); //pixels are RGBA8888, tightly packed, and are copied into _surface
+Image **loadImageSlicesFromFile(char *filename, int numSlices, int horizontal); //array of numSlices images, keeping pixels like above, sheet is cut top to bottom (or left to right)
+Image **loadImageSlicesFromFileSharingRepeats(char *filename, int numSlices, int horizontal, int period); //same, but a slice identical to the one period slices before it shares that one's Image, so free each pointer once
+Image *createHalfSizeImage(Image *image, int padX, int padY); //box filtered to half size, needs the image's pixels; pads with 0 or 1 transparent columns/rows at the left/top first, so the 2x2 blocks can start on an odd pixel
+void updateHalfSizeImage(Image *half, Image *image, int padX, int padY, const ImageRect *rect, ImageRect *halfRect); //redoes the part of a createHalfSizeImage copy covering rect of the original, and sets halfRect to what changed
+void updateImageTexture(Image *image, const ImageRect *rect); //sends rect (NULL for all) of the kept pixels to the texture, after changing them
+//quads covering every pixel that isn't fully transparent (and is inside one of the within rects, if there are any),
+//so drawing the image through them skips the empty parts; NULL if it takes more than maxQuads, needs the image's pixels
+ImageQuad *traceImageQuads(Image *image, const ImageRect *within, int numWithin, int maxQuads, int *numQuads);
+float imageQuadsArea(const ImageQuad *quads, int numQuads); //pixels they cover, to compare with the image's width x height
+//keeps the image's pixels as spans (only inside the within rects, if there are any) and frees _surface unless keepPixels
+void encodeImageSpans(Image *image, const ImageRect *within, int numWithin, int keepPixels);
+Uint32 getImageSpansPixel(const ImageSpans *spans, int x, int y); //0 outside the spans
+int imageSpansBytes(const ImageSpans *spans); //memory used, to compare with the surface's width x height x 4
 void deepCopy_Animation(Animation *to, Animation *from);
 Animation *shallowCopyAnimation(Animation *original);
 void startBatchingLoadedImages(); //1 on success, 0 on failure
@@ -147,6 +188,11 @@ void setAnimationLoop(Animation *self, int loop, int forceRestart);
  */
 void drawImage(Image *image, int x, int y);
 void drawImageRotate(Image *image, float x, float y, float angle, int centerX, int centerY);
+void drawImageSrcRotate(Image *image, ImageRect *srcRect, float x, float y, float angle, int centerX, int centerY); //only part of the image, drawn the same size; srcRect can be null for the whole thing
+//the image's top left corner already rotated to (x, y), say by rotateStackAnchors, and the image rotated about it; saves redoing the pivot per draw
+void drawImagePreRotated(Image *image, ImageRect *srcRect, float x, float y, float angle);
+//the same, but only where the quads cover; with SDL older than 2.0.18 it's the whole image
+void drawImageQuadsPreRotated(Image *image, const ImageQuad *quads, int numQuads, float x, float y, float angle);
 void drawImageToImage(Image *src, Image *dst, ImageRect *srcRect, ImageRect *dstRect); //either rectangle is allowed to be null for full size
 void drawImageSrcDst(Image *image, ImageRect *srcRect, ImageRect *dstRect); //either rectangle is allowed to be null for full size
 void drawUnfilledRect(int x, int y, int w, int h, int r, int g, int b);
@@ -154,6 +200,14 @@ void drawFilledRect(int x, int y, int w, int h, int r, int g, int b);
 void drawFilledRectA(int x, int y, int w, int h, int r, int g, int b, int a);
 void drawLine(int x1, int y1, int x2, int y2, int r, int g, int b);
 void drawAnimation(Sprite *s, Animation *anim, int x, int y); //anim can be null to just draw entire sprite
+/*
+ * While batching geometry, drawImageRotate queues a quad instead of drawing, and consecutive quads from the same
+ * texture go to the renderer as one SDL_RenderGeometry call.  Any other draw call (or changing the scaling) sends
+ * the queue first so the draw order is unchanged.  Stop batching before changing the render target yourself.
+ * With SDL older than 2.0.18 this does nothing and drawImageRotate draws immediately like always.
+ */
+void startBatchingGeometry();
+void stopBatchingGeometry();
 
 
 /////////////////////////////////////////////////
@@ -6,6 +6,7 @@
 #include "logging.h"
 #include "omni_exit.h"
 #include "stack_frame.h"
+#include "quality_governor.h"
 #include "font.h"
 
 #include <stdio.h>
@@ -29,6 +30,7 @@ void initializeOmnisquash(){
     setbuf(stderr, NULL);
     
     loadConfiguration();
+    initQualityGovernor();
     
     initSDL();
 //	freopen( "CON", "w", stdout );
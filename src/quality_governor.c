@@ -0,0 +1,169 @@
+#include "quality_governor.h"
+#include "configuration.h"
+#include "constants.h"
+#include "logging.h"
+
+static void levelSettings(int index, QualityLevels *result);
+static void changeLevel(int newLevel);
+
+static QualityLevels levels = {1, 0, 0};
+static int level = 0;
+static int numLevels = 1;
+static int minBufferScale = 1;
+static int maxBufferScale = 1;
+static int maxLodBias = 0;
+static int maxGapFillDrop = 0;
+
+static double lastFrameTime = 0;
+static double smoothedFrameTime = 0;
+static const double smoothing = 0.1; //how much of each new frame goes into the smoothed time
+static unsigned frame = 0;
+
+//hysteresis, as fractions of the target and numbers of frames
+static const double overTarget = 1.1;
+static const double underTarget = 0.7;
+static const int framesBeforeDropping = 15;
+static const int baseRaiseWait = 120;
+static const int maxRaiseWait = 1920;
+static const int settleFrames = 30; //after changing level, so the smoothed time catches up before deciding again
+static const int raiseProbation = 300; //dropping within this many frames of going up means going up was too much
+static int framesOver = 0;
+static int framesUnder = 0;
+static int framesSettling = 0;
+static int raiseWait = 120;
+static unsigned lastRaiseFrame = 0;
+
+//for the log, so the policy can be tuned
+static const int framesPerReport = 300;
+static int reportFrames = 0;
+static double reportTotal = 0;
+static double reportWorst = 0;
+
+
+/////////////////////////////////////////////////
+// Init
+/////////////////////////////////////////////////
+void initQualityGovernor(){
+    //keep the configuration sensible, the buffer can't be finer than the window
+    minBufferScale = (STACK_GOVERNOR_MIN_BUFFER_SCALE < 1) ? 1 : STACK_GOVERNOR_MIN_BUFFER_SCALE;
+    maxBufferScale = (STACK_GOVERNOR_MAX_BUFFER_SCALE > RENDER_SCALE_MULTIPLE) ? RENDER_SCALE_MULTIPLE : STACK_GOVERNOR_MAX_BUFFER_SCALE;
+    if (maxBufferScale < minBufferScale){
+        LOG_WAR("Quality governor's buffer scale bounds are backwards (%d to %d), only using %d", STACK_GOVERNOR_MIN_BUFFER_SCALE, STACK_GOVERNOR_MAX_BUFFER_SCALE, minBufferScale);
+        maxBufferScale = minBufferScale;
+    }
+    maxLodBias = (STACK_GOVERNOR_MAX_LOD_BIAS < 0) ? 0 : STACK_GOVERNOR_MAX_LOD_BIAS;
+    maxGapFillDrop = (STACK_GOVERNOR_MAX_GAP_FILL_DROP < 0) ? 0 : STACK_GOVERNOR_MAX_GAP_FILL_DROP;
+    
+    numLevels = 1 + maxGapFillDrop + maxLodBias + (maxBufferScale - minBufferScale);
+    level = 0;
+    levelSettings(level, &levels);
+    
+    framesOver = 0;
+    framesUnder = 0;
+    framesSettling = 0;
+    raiseWait = baseRaiseWait;
+    frame = 0;
+    
+    if (STACK_USE_QUALITY_GOVERNOR){
+        LOG_INF("Quality governor aiming for %.1f ms with %d levels, starting at buffer scale %d", STACK_GOVERNOR_TARGET_MS, numLevels, levels.bufferScale);
+    }
+}
+
+
+/////////////////////////////////////////////////
+// Frames
+/////////////////////////////////////////////////
+void reportFrameTime(double milliseconds){
+    frame++;
+    lastFrameTime = milliseconds;
+    smoothedFrameTime = (frame == 1) ? milliseconds : smoothedFrameTime + ((milliseconds - smoothedFrameTime) * smoothing);
+    
+    reportFrames++;
+    reportTotal += milliseconds;
+    reportWorst = (milliseconds > reportWorst) ? milliseconds : reportWorst;
+    if (reportFrames >= framesPerReport){
+        LOG_DEB("Frame time %.2f ms average, %.2f ms worst, %.2f ms smoothed; quality level %d of %d (buffer scale %d, lod bias %d, gap fill drop %d)",
+            reportTotal / reportFrames, reportWorst, smoothedFrameTime, level, numLevels - 1, levels.bufferScale, levels.lodBias, levels.gapFillDrop
+        );
+        reportFrames = 0;
+        reportTotal = 0;
+        reportWorst = 0;
+    }
+    
+    if (!STACK_USE_QUALITY_GOVERNOR){
+        return;
+    }
+    if (framesSettling > 0){
+        framesSettling--;
+        return;
+    }
+    
+    if (smoothedFrameTime > STACK_GOVERNOR_TARGET_MS * overTarget){
+        framesOver++;
+        framesUnder = 0;
+    } else if (smoothedFrameTime < STACK_GOVERNOR_TARGET_MS * underTarget){
+        framesUnder++;
+        framesOver = 0;
+    } else {
+        framesOver = 0;
+        framesUnder = 0;
+    }
+    
+    if (framesOver >= framesBeforeDropping && level < numLevels - 1){
+        //straight back down after going up means that level was too much, so leave it alone for longer next time
+        if (lastRaiseFrame != 0 && frame - lastRaiseFrame <= (unsigned)raiseProbation){
+            raiseWait = (raiseWait * 2 > maxRaiseWait) ? maxRaiseWait : raiseWait * 2;
+        } else {
+            raiseWait = baseRaiseWait;
+        }
+        changeLevel(level + 1);
+    } else if (framesUnder >= raiseWait && level > 0){
+        lastRaiseFrame = frame;
+        changeLevel(level - 1);
+    }
+}
+
+void changeLevel(int newLevel){
+    LOG_INF("Quality governor: %.2f ms smoothed against %.1f ms, level %d -> %d", smoothedFrameTime, STACK_GOVERNOR_TARGET_MS, level, newLevel);
+    level = newLevel;
+    levelSettings(level, &levels);
+    LOG_INF("Quality governor: buffer scale %d, lod bias %d, gap fill drop %d", levels.bufferScale, levels.lodBias, levels.gapFillDrop);
+    
+    framesOver = 0;
+    framesUnder = 0;
+    framesSettling = settleFrames;
+}
+
+void levelSettings(int index, QualityLevels *result){
+    //each level down the ladder takes one more step off, the cheapest looking ones first
+    int steps = index;
+    result->gapFillDrop = (steps < maxGapFillDrop) ? steps : maxGapFillDrop;
+    steps -= result->gapFillDrop;
+    result->lodBias = (steps < maxLodBias) ? steps : maxLodBias;
+    steps -= result->lodBias;
+    result->bufferScale = maxBufferScale - steps;
+}
+
+
+/////////////////////////////////////////////////
+// Access
+/////////////////////////////////////////////////
+const QualityLevels *getQualityLevels(){
+    return &levels;
+}
+
+int getQualityLevel(){
+    return level;
+}
+
+int getQualityLevelCount(){
+    return numLevels;
+}
+
+double getLastFrameTime(){
+    return lastFrameTime;
+}
+
+double getSmoothedFrameTime(){
+    return smoothedFrameTime;
+}
@@ -0,0 +1,51 @@
+#ifndef QUALITY_GOVERNOR_H
+#define QUALITY_GOVERNOR_H
+
+/*
+ * Trades the stack pass's quality for speed when frames take too long, and back again when there's time to spare,
+ * so slow machines don't need a rebuild with a smaller buffer.
+ *
+ * The game loop reports how long each frame's work took (not counting waiting for vsync), and the governor keeps
+ * a smoothed frame time to compare against the configured target.  The settings it can change are laid out as a
+ * ladder of levels, best first, each a step worse than the last: first the gap filling copies are cut down, then
+ * the level of detail is biased coarser, then the buffer scale comes down, each within the configured bounds.
+ *
+ * To keep it from flickering between two levels, it has to be over the target for a little while before dropping
+ * a level, and well under it for a lot longer before going back up.  If going up turns out to be too much and it
+ * has to drop straight back down, it waits twice as long before trying that again.
+ */
+
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+//what the stack pass should be drawing with at the current level
+typedef struct QualityLevels{
+    int bufferScale; //stack buffer pixels per screen pixel
+    int lodBias; //levels of detail coarser than the pitch alone would pick
+    int gapFillDrop; //gap filling copies left out of each layer, there's always at least one copy
+} QualityLevels;
+
+
+/////////////////////////////////////////////////
+// Init
+/////////////////////////////////////////////////
+void initQualityGovernor(); //after the configuration is loaded, starts at the best level
+
+
+/////////////////////////////////////////////////
+// Frames
+/////////////////////////////////////////////////
+void reportFrameTime(double milliseconds); //once a frame, might change the level
+
+
+/////////////////////////////////////////////////
+// Access
+/////////////////////////////////////////////////
+const QualityLevels *getQualityLevels();
+int getQualityLevel(); //0 is the best
+int getQualityLevelCount();
+double getLastFrameTime(); //milliseconds
+double getSmoothedFrameTime(); //milliseconds, what the level is chosen from
+
+#endif
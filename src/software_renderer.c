@@ -0,0 +1,1174 @@
+#include "software_renderer.h"
+#include "graphics.h"
+#include "logging.h"
+#include "omni_exit.h"
+#include "SDL2/SDL.h"
+#include <math.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define HAS_X86_INTRINSICS 1
+    #include <immintrin.h>
+#else
+    #define HAS_X86_INTRINSICS 0
+#endif
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+//everything the inner loop needs to draw one row of a rotated image
+typedef struct AffineSpan{
+    const Uint32 *src;
+    int srcPitch; //in pixels
+    int srcWidth;
+    int srcHeight;
+    //the image's spans instead, when it has them, with where the part being drawn starts in it
+    const ImageSpans *spans;
+    int spansX;
+    int spansY;
+    //texture coordinates of the first pixel, and how much they change per pixel, 16.16 fixed point
+    Sint32 u;
+    Sint32 v;
+    Sint32 du;
+    Sint32 dv;
+} AffineSpan;
+
+//a queued softwareDrawImageRotate
+typedef struct SoftwareDraw{
+    SDL_Surface *src;
+    const ImageSpans *spans; //drawn from instead of src when there are some
+    //the part of src being drawn
+    int srcX;
+    int srcY;
+    int srcW;
+    int srcH;
+    //where the center ends up in the target, before scaling
+    double pivotX;
+    double pivotY;
+    //the angle, as its cosine and sine, worked out once when queued rather than every time a band draws it
+    double cosine;
+    double sine;
+    int centerX;
+    int centerY;
+    int scaling;
+    //drawn this many times, each a pixel higher than the last, see setSoftwareExtrusion
+    int extrusion;
+    int group;
+    //rows of the target this can touch, already clipped to the target
+    int top;
+    int bottom;
+} SoftwareDraw;
+
+//a horizontal strip of the target, with the draws that touch it in the order they were made
+typedef struct RenderBand{
+    int top;
+    int bottom;
+    int *draws; //array of indices into the queue
+    int numDraws;
+    int drawCapacity;
+    Uint64 ticks; //performance counter ticks spent on the band last frame
+    SoftwareCoverageCounts coverage; //last frame, when drawn front to back
+} RenderBand;
+
+
+/////////////////////////////////////////////////
+// statics
+/////////////////////////////////////////////////
+static void splitIntoBands(int height);
+static void queueDraw(Image *image, ImageRect *srcRect, double pivotX, double pivotY, float angle, int centerX, int centerY);
+static void renderQueuedDraws();
+static void runBands();
+static void renderBands();
+static int renderWorker(void *data);
+static void renderBandFrontToBack(RenderBand *band, const SDL_Rect *clip);
+static void rasterizeRotated(const SoftwareDraw *draw, int lift, const SDL_Rect *clip, RenderBand *band);
+static void allocateCoverage(int width, int height);
+static void rotatedBounds(const SoftwareDraw *draw, double *minX, double *maxX, double *minY, double *maxY);
+static void angleTrig(float angle, double *c, double *s);
+static void trimSpan(double start, double step, double limit, double *lower, double *upper);
+static Uint32 blendPixel(Uint32 src, Uint32 dst);
+static void rasterizeSpanScalar(Uint32 *dst, int count, const AffineSpan *span);
+static void rasterizeSpanRuns(Uint32 *dst, int count, const AffineSpan *span);
+static Sint32 stepsToReach(Sint64 from, Sint64 to, Sint32 step, double reciprocal);
+static void rasterizeSpanUnder(int x, int y, int count, const AffineSpan *span, RenderBand *band);
+static Uint32 underPixel(Uint32 src, Uint32 dst);
+static Uint32 resolvePixel(Uint32 accumulated, Uint32 background);
+#if HAS_X86_INTRINSICS && defined(__SSE2__)
+static void rasterizeSpanSSE2(Uint32 *dst, int count, const AffineSpan *span);
+#endif
+#if HAS_X86_INTRINSICS
+static void rasterizeSpanAVX2(Uint32 *dst, int count, const AffineSpan *span);
+#endif
+
+static SDL_Surface *target = NULL;
+static int drawScaling = 1;
+static int drawExtrusion = 1;
+static int drawGroup = 0;
+static void (*rasterizeSpan)(Uint32 *dst, int count, const AffineSpan *span) = &rasterizeSpanScalar;
+static const char *instructionSet = "scalar";
+//the last angle's sine and cosine, since a frame's draws are nearly all at the same angle
+static float trigAngle = 0;
+static double trigCos = 1;
+static double trigSin = 0;
+
+//draws are queued up and done all at once when the frame is finished
+static SoftwareDraw *queue = NULL; //array
+static int queueLength = 0;
+static int queueCapacity = 0;
+static int clearPending = 0;
+static Uint32 clearColor = 0;
+/*
+ * Front to back, each band goes through its draws last first, compositing each one under what's there (the
+ * target holds premultiplied color until the band is done, then the clear color goes under everything).  Once a
+ * pixel is opaque nothing below it can show, so a bit is set for it in the coverage mask and later draws skip it.
+ * A whole word of the mask set skips 32 pixels at once, and rows keep a count of what's left uncovered so a
+ * finished row is skipped without looking at the mask at all.  Only frames that start with a clear can be drawn
+ * this way, since we need to know what's underneath.
+ */
+static int frontToBack = 0;
+static Uint32 *coverage = NULL; //array [y * coverageWords + x / 32], a bit per pixel, set once the pixel is opaque
+static int coverageWords = 0;
+static int *rowUncovered = NULL; //array [y], how many pixels in the row aren't covered yet
+
+//while runSoftwareRenderPass is going, the bands run this instead of drawing
+static SoftwareRenderPass renderPass = NULL;
+static void *renderPassData = NULL;
+
+/*
+ * The target is split into bands, and the bands are shared out between the worker threads and the main thread.
+ * Bands never overlap, so nobody needs to lock anything while drawing.  There are a few more bands than threads
+ * so that a thread that got an empty band can pick up another one.
+ */
+static RenderBand *bands = NULL; //array
+static int numBands = 0;
+static int numRenderThreads = 1;
+static const int bandsPerThread = 4;
+static const int minimumBandHeight = 8;
+static const int minimumSimdStretch = 8; //pixels inside one span before rasterizeSpanRuns hands them to rasterizeSpan
+static SDL_atomic_t nextBand;
+
+static SDL_Thread **workers = NULL; //array
+static int numWorkers = 0;
+static SDL_sem *workAvailable = NULL;
+static SDL_sem *workDone = NULL;
+static SDL_atomic_t workersShouldExit;
+
+
+/////////////////////////////////////////////////
+// Init/Term
+/////////////////////////////////////////////////
+void initSoftwareRenderer(int width, int height, int numThreads){
+    if (target != NULL){
+        termSoftwareRenderer();
+    }
+    
+    target = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA8888);
+    if (target == NULL){
+        LOG_ERR("Failed to create %dx%d surface for software rendering: %s", width, height, SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+    drawScaling = 1;
+    drawExtrusion = 1;
+    drawGroup = 0;
+    
+    //pick the widest inner loop the CPU can run
+    rasterizeSpan = &rasterizeSpanScalar;
+    instructionSet = "scalar";
+    #if HAS_X86_INTRINSICS && defined(__SSE2__)
+    if (SDL_HasSSE2()){
+        rasterizeSpan = &rasterizeSpanSSE2;
+        instructionSet = "SSE2";
+    }
+    #endif
+    #if HAS_X86_INTRINSICS
+    if (SDL_HasAVX2()){
+        rasterizeSpan = &rasterizeSpanAVX2;
+        instructionSet = "AVX2";
+    }
+    #endif
+    
+    if (numThreads <= 0){
+        numThreads = SDL_GetCPUCount();
+    }
+    numThreads = (numThreads < 1) ? 1 : numThreads;
+    numRenderThreads = numThreads;
+    splitIntoBands(height);
+    allocateCoverage(width, height);
+    
+    //the main thread renders too, so it only needs help from the rest
+    numWorkers = numThreads - 1;
+    SDL_AtomicSet(&workersShouldExit, 0);
+    workAvailable = SDL_CreateSemaphore(0);
+    workDone = SDL_CreateSemaphore(0);
+    if (workAvailable == NULL || workDone == NULL){
+        LOG_ERR("Failed to create semaphores for software rendering: %s", SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+    workers = malloc(sizeof(SDL_Thread *) * (numWorkers > 0 ? numWorkers : 1));
+    int i;
+    for (i = 0; i < numWorkers; i++){
+        workers[i] = SDL_CreateThread(&renderWorker, "software renderer", NULL);
+        if (workers[i] == NULL){
+            LOG_ERR("Failed to create software rendering thread: %s", SDL_GetError());
+            displayErrorAndExit("Graphics error encountered");
+        }
+    }
+    
+    LOG_INF("Software renderer using %s, %dx%d in %d bands on %d threads", instructionSet, width, height, numBands, numThreads);
+}
+
+void resizeSoftwareRender(int width, int height){
+    if (target == NULL){
+        LOG_WAR("Tried to resize the software render before initializing the software renderer");
+        return;
+    }
+    if (target->w == width && target->h == height){
+        return;
+    }
+    
+    //the threads don't care how big the target is, so only the surface and the bands change
+    SDL_FreeSurface(target);
+    target = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA8888);
+    if (target == NULL){
+        LOG_ERR("Failed to create %dx%d surface for software rendering: %s", width, height, SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+    queueLength = 0;
+    clearPending = 0;
+    splitIntoBands(height);
+    allocateCoverage(width, height);
+    
+    LOG_DEB("Software render resized to %dx%d, %d bands", width, height, numBands);
+}
+
+void splitIntoBands(int height){
+    //cut the target into bands, evenly as we can
+    int i;
+    for (i = 0; i < numBands; i++){
+        free(bands[i].draws);
+    }
+    free(bands);
+    
+    numBands = numRenderThreads * bandsPerThread;
+    if (numBands > height / minimumBandHeight){
+        numBands = height / minimumBandHeight;
+    }
+    numBands = (numBands < 1) ? 1 : numBands;
+    bands = malloc(sizeof(RenderBand) * numBands);
+    
+    for (i = 0; i < numBands; i++){
+        bands[i].top = (height * i) / numBands;
+        bands[i].bottom = (height * (i+1)) / numBands;
+        bands[i].draws = NULL;
+        bands[i].numDraws = 0;
+        bands[i].drawCapacity = 0;
+        bands[i].ticks = 0;
+        bands[i].coverage.pixelsWritten = 0;
+        bands[i].coverage.pixelsRejected = 0;
+        bands[i].coverage.blocksRejected = 0;
+        bands[i].coverage.rowsRejected = 0;
+    }
+}
+
+void allocateCoverage(int width, int height){
+    coverageWords = (width + 31) / 32;
+    free(coverage);
+    free(rowUncovered);
+    coverage = malloc(sizeof(Uint32) * coverageWords * height);
+    rowUncovered = malloc(sizeof(int) * height);
+}
+
+void termSoftwareRenderer(){
+    int i;
+    
+    //wake everybody up to tell them to leave
+    SDL_AtomicSet(&workersShouldExit, 1);
+    for (i = 0; i < numWorkers; i++){
+        SDL_SemPost(workAvailable);
+    }
+    for (i = 0; i < numWorkers; i++){
+        SDL_WaitThread(workers[i], NULL);
+    }
+    free(workers);
+    workers = NULL;
+    numWorkers = 0;
+    SDL_DestroySemaphore(workAvailable);
+    SDL_DestroySemaphore(workDone);
+    workAvailable = NULL;
+    workDone = NULL;
+    
+    for (i = 0; i < numBands; i++){
+        free(bands[i].draws);
+    }
+    free(bands);
+    bands = NULL;
+    numBands = 0;
+    
+    free(queue);
+    queue = NULL;
+    queueLength = 0;
+    queueCapacity = 0;
+    clearPending = 0;
+    
+    free(coverage);
+    free(rowUncovered);
+    coverage = NULL;
+    rowUncovered = NULL;
+    coverageWords = 0;
+    
+    SDL_FreeSurface(target);
+    target = NULL;
+}
+
+
+/////////////////////////////////////////////////
+// Drawing
+/////////////////////////////////////////////////
+void clearSoftwareRender(Uint8 r, Uint8 g, Uint8 b, Uint8 a){
+    //anything queued before this would just be cleared over
+    queueLength = 0;
+    drawGroup = 0;
+    clearPending = 1;
+    clearColor = SDL_MapRGBA(target->format, r, g, b, a);
+}
+
+void setSoftwareFrontToBack(int enabled){
+    frontToBack = enabled;
+}
+
+void setSoftwareDrawScaling(int scaling){
+    drawScaling = scaling;
+}
+
+void setSoftwareExtrusion(int copies){
+    drawExtrusion = (copies < 1) ? 1 : copies;
+    drawGroup++;
+}
+
+void softwareDrawImageRotate(Image *image, float x, float y, float angle, int centerX, int centerY){
+    softwareDrawImageSrcRotate(image, NULL, x, y, angle, centerX, centerY);
+}
+
+void softwareDrawImageSrcRotate(Image *image, ImageRect *srcRect, float x, float y, float angle, int centerX, int centerY){
+    //truncate like drawImageRotate does when it makes its SDL_Rect
+    int destX = x;
+    int destY = y;
+    queueDraw(image, srcRect, destX + centerX, destY + centerY, angle, centerX, centerY);
+}
+
+void softwareDrawImagePreRotated(Image *image, ImageRect *srcRect, float x, float y, float angle){
+    //rotating about the top left corner leaves it where it is
+    queueDraw(image, srcRect, x, y, angle, 0, 0);
+}
+
+void queueDraw(Image *image, ImageRect *srcRect, double pivotX, double pivotY, float angle, int centerX, int centerY){
+    if (image->_surface == NULL && image->_spans == NULL){
+        LOG_ERR("Tried to draw an image without pixels in the software renderer");
+        displayErrorAndExit("Graphics error encountered");
+    }
+    
+    if (queueLength >= queueCapacity){
+        queueCapacity = (queueCapacity == 0) ? 256 : queueCapacity * 2;
+        queue = realloc(queue, sizeof(SoftwareDraw) * queueCapacity);
+    }
+    
+    SoftwareDraw *draw = queue + queueLength;
+    draw->src = image->_surface;
+    draw->spans = image->_spans;
+    draw->srcX = (srcRect != NULL) ? srcRect->x : 0;
+    draw->srcY = (srcRect != NULL) ? srcRect->y : 0;
+    draw->srcW = (srcRect != NULL) ? srcRect->w : image->width;
+    draw->srcH = (srcRect != NULL) ? srcRect->h : image->height;
+    draw->pivotX = pivotX;
+    draw->pivotY = pivotY;
+    angleTrig(angle, &draw->cosine, &draw->sine);
+    draw->centerX = centerX;
+    draw->centerY = centerY;
+    draw->scaling = drawScaling;
+    draw->extrusion = drawExtrusion;
+    draw->group = drawGroup;
+    
+    //work out which rows it touches now so it can be handed to the right bands
+    double minX, maxX, minY, maxY;
+    rotatedBounds(draw, &minX, &maxX, &minY, &maxY);
+    minY -= (draw->extrusion - 1) * draw->scaling;
+    if (maxX <= 0 || minX >= target->w || maxY <= 0 || minY >= target->h){
+        return;
+    }
+    draw->top = (minY < 0) ? 0 : floor(minY);
+    draw->bottom = (maxY > target->h) ? target->h : ceil(maxY);
+    
+    queueLength++;
+}
+
+void copySoftwareRenderToImage(Image *dst){
+    renderQueuedDraws();
+    
+    if (SDL_UpdateTexture(dst->_texture, NULL, target->pixels, target->pitch) != 0){
+        LOG_ERR("Call to SDL_UpdateTexture failed: %s", SDL_GetError());
+        displayErrorAndExit("Graphics error encountered");
+    }
+}
+
+void runSoftwareRenderPass(SoftwareRenderPass pass, void *data){
+    //anything already queued goes underneath
+    renderQueuedDraws();
+    
+    int band;
+    for (band = 0; band < numBands; band++){
+        bands[band].numDraws = 0;
+    }
+    renderPass = pass;
+    renderPassData = data;
+    runBands();
+    renderPass = NULL;
+    renderPassData = NULL;
+}
+
+void renderQueuedDraws(){
+    int i, band;
+    
+    //hand each draw to every band it touches, keeping the draw order within each band
+    for (band = 0; band < numBands; band++){
+        bands[band].numDraws = 0;
+    }
+    int bandHeight = (target->h + numBands - 1) / numBands;
+    for (i = 0; i < queueLength; i++){
+        //bands are within a row of even, so start from the guess and walk to the right one
+        band = queue[i].top / bandHeight;
+        band = (band >= numBands) ? numBands - 1 : band;
+        while (band > 0 && bands[band].top > queue[i].top){
+            band--;
+        }
+        while (band < numBands - 1 && bands[band].bottom <= queue[i].top){
+            band++;
+        }
+        
+        for (; band < numBands && bands[band].top < queue[i].bottom; band++){
+            if (bands[band].numDraws >= bands[band].drawCapacity){
+                bands[band].drawCapacity = (bands[band].drawCapacity == 0) ? 64 : bands[band].drawCapacity * 2;
+                bands[band].draws = realloc(bands[band].draws, sizeof(int) * bands[band].drawCapacity);
+            }
+            bands[band].draws[bands[band].numDraws] = i;
+            bands[band].numDraws++;
+        }
+    }
+    
+    runBands();
+    
+    queueLength = 0;
+    clearPending = 0;
+}
+
+void runBands(){
+    //everybody grabs bands until they're gone, including us
+    int i;
+    SDL_AtomicSet(&nextBand, 0);
+    for (i = 0; i < numWorkers; i++){
+        SDL_SemPost(workAvailable);
+    }
+    renderBands();
+    for (i = 0; i < numWorkers; i++){
+        SDL_SemWait(workDone);
+    }
+}
+
+void renderBands(){
+    int band, i, x, y, runEnd, copy, k;
+    Uint32 *row;
+    Uint64 start;
+    SDL_Rect clip;
+    
+    //SDL_AtomicAdd gives back the value from before adding, so every band goes to exactly one thread
+    while ((band = SDL_AtomicAdd(&nextBand, 1)) < numBands){
+        start = SDL_GetPerformanceCounter();
+        
+        if (renderPass != NULL){
+            renderPass((Uint32 *)target->pixels, target->pitch / 4, target->w, bands[band].top, bands[band].bottom, renderPassData);
+            bands[band].ticks = SDL_GetPerformanceCounter() - start;
+            continue;
+        }
+        
+        clip.x = 0;
+        clip.y = bands[band].top;
+        clip.w = target->w;
+        clip.h = bands[band].bottom - bands[band].top;
+        if (frontToBack && clearPending){
+            renderBandFrontToBack(bands + band, &clip);
+            bands[band].ticks = SDL_GetPerformanceCounter() - start;
+            continue;
+        }
+        bands[band].coverage.pixelsWritten = 0;
+        bands[band].coverage.pixelsRejected = 0;
+        bands[band].coverage.blocksRejected = 0;
+        bands[band].coverage.rowsRejected = 0;
+        
+        if (clearPending){
+            for (y = bands[band].top; y < bands[band].bottom; y++){
+                row = (Uint32 *)((Uint8 *)target->pixels + (y * target->pitch));
+                for (x = 0; x < target->w; x++){
+                    row[x] = clearColor;
+                }
+            }
+        }
+        
+        /*
+         * Draws from one setSoftwareExtrusion call are done copy by copy, every draw's first copy and then every
+         * draw's second, which is the order the copies would have been drawn in if they were separate draws
+         */
+        for (i = 0; i < bands[band].numDraws; i = runEnd){
+            runEnd = i + 1;
+            while (runEnd < bands[band].numDraws && queue[bands[band].draws[runEnd]].group == queue[bands[band].draws[i]].group){
+                runEnd++;
+            }
+            
+            for (copy = 0; copy < queue[bands[band].draws[i]].extrusion; copy++){
+                for (k = i; k < runEnd; k++){
+                    rasterizeRotated(queue + bands[band].draws[k], copy, &clip, NULL);
+                }
+            }
+        }
+        
+        bands[band].ticks = SDL_GetPerformanceCounter() - start;
+    }
+}
+
+void renderBandFrontToBack(RenderBand *band, const SDL_Rect *clip){
+    int i, x, y, runStart, copy, k;
+    Uint32 *row;
+    
+    //nothing drawn and nothing covered yet
+    for (y = band->top; y < band->bottom; y++){
+        row = (Uint32 *)((Uint8 *)target->pixels + (y * target->pitch));
+        for (x = 0; x < target->w; x++){
+            row[x] = 0;
+        }
+        for (x = 0; x < coverageWords; x++){
+            coverage[(y * coverageWords) + x] = 0;
+        }
+        rowUncovered[y] = target->w;
+    }
+    band->coverage.pixelsWritten = 0;
+    band->coverage.pixelsRejected = 0;
+    band->coverage.blocksRejected = 0;
+    band->coverage.rowsRejected = 0;
+    
+    //exactly the reverse of renderBands' order, runs last first, copies top first, draws last first
+    for (i = band->numDraws - 1; i >= 0; i = runStart - 1){
+        runStart = i;
+        while (runStart > 0 && queue[band->draws[runStart - 1]].group == queue[band->draws[i]].group){
+            runStart--;
+        }
+        
+        for (copy = queue[band->draws[i]].extrusion - 1; copy >= 0; copy--){
+            for (k = i; k >= runStart; k--){
+                rasterizeRotated(queue + band->draws[k], copy, clip, band);
+            }
+        }
+    }
+    
+    //and finally the clear color under whatever isn't covered
+    for (y = band->top; y < band->bottom; y++){
+        row = (Uint32 *)((Uint8 *)target->pixels + (y * target->pitch));
+        for (x = 0; x < target->w; x++){
+            row[x] = resolvePixel(row[x], clearColor);
+        }
+    }
+}
+
+int renderWorker(void *data){
+    while (1){
+        SDL_SemWait(workAvailable);
+        if (SDL_AtomicGet(&workersShouldExit)){
+            break;
+        }
+        
+        renderBands();
+        SDL_SemPost(workDone);
+    }
+    
+    return 0;
+}
+
+void rotatedBounds(const SoftwareDraw *draw, double *minX, double *maxX, double *minY, double *maxY){
+    //the rotated corners of the image, in target pixels
+    double c = draw->cosine;
+    double s = draw->sine;
+    double pivotX = draw->pivotX;
+    double pivotY = draw->pivotY;
+    double cornersX[4] = { -draw->centerX, draw->srcW - draw->centerX, draw->srcW - draw->centerX, -draw->centerX };
+    double cornersY[4] = { -draw->centerY, -draw->centerY, draw->srcH - draw->centerY, draw->srcH - draw->centerY };
+    double rotatedX, rotatedY;
+    int i;
+    for (i = 0; i < 4; i++){
+        rotatedX = (pivotX + (c * cornersX[i]) - (s * cornersY[i])) * draw->scaling;
+        rotatedY = (pivotY + (s * cornersX[i]) + (c * cornersY[i])) * draw->scaling;
+        *minX = (i == 0 || rotatedX < *minX) ? rotatedX : *minX;
+        *maxX = (i == 0 || rotatedX > *maxX) ? rotatedX : *maxX;
+        *minY = (i == 0 || rotatedY < *minY) ? rotatedY : *minY;
+        *maxY = (i == 0 || rotatedY > *maxY) ? rotatedY : *maxY;
+    }
+}
+
+void rasterizeRotated(const SoftwareDraw *draw, int lift, const SDL_Rect *clip, RenderBand *band){
+    /*
+     * Same setup as SDL_RenderCopyEx: the image's top left is at dest, and it is rotated clockwise about dest + center.
+     * We go the other way - for each target pixel center, rotate back into the image to find which texel lands there.
+     */
+    SDL_Surface *src = draw->src;
+    double c = draw->cosine;
+    double s = draw->sine;
+    double pivotX = draw->pivotX;
+    double pivotY = draw->pivotY - lift;
+    
+    double minX, maxX, minY, maxY;
+    rotatedBounds(draw, &minX, &maxX, &minY, &maxY);
+    int left = floor(minX);
+    int right = ceil(maxX);
+    int top = floor(minY - (lift * draw->scaling));
+    int bottom = ceil(maxY - (lift * draw->scaling));
+    left = (left < clip->x) ? clip->x : left;
+    top = (top < clip->y) ? clip->y : top;
+    right = (right > clip->x + clip->w) ? clip->x + clip->w : right;
+    bottom = (bottom > clip->y + clip->h) ? clip->y + clip->h : bottom;
+    if (left >= right || top >= bottom){
+        return;
+    }
+    
+    AffineSpan span;
+    span.spans = draw->spans;
+    span.spansX = draw->srcX;
+    span.spansY = draw->srcY;
+    span.srcPitch = (span.spans == NULL) ? src->pitch / 4 : 0;
+    span.src = (span.spans == NULL) ? (Uint32 *)src->pixels + (draw->srcY * span.srcPitch) + draw->srcX : NULL;
+    span.srcWidth = draw->srcW;
+    span.srcHeight = draw->srcH;
+    double du = c / draw->scaling;
+    double dv = -s / draw->scaling;
+    span.du = lround(du * 65536);
+    span.dv = lround(dv * 65536);
+    
+    Uint32 *targetPixels = target->pixels;
+    int targetPitch = target->pitch / 4;
+    int y, spanStart, spanEnd;
+    double relativeX, relativeY, u, v, lower, upper;
+    for (y = top; y < bottom; y++){
+        //front to back, rows with nothing left uncovered can't take anything more
+        if (band != NULL && rowUncovered[y] == 0){
+            band->coverage.rowsRejected++;
+            band->coverage.pixelsRejected += right - left; //the span isn't worked out, so this is a bit over
+            continue;
+        }
+        
+        //texture coordinates at the center of the first pixel in the row
+        relativeX = (left + 0.5) / draw->scaling - pivotX;
+        relativeY = (y + 0.5) / draw->scaling - pivotY;
+        u = (c * relativeX) + (s * relativeY) + draw->centerX;
+        v = -(s * relativeX) + (c * relativeY) + draw->centerY;
+        
+        //only walk the part of the row that can land inside the image, with a pixel of slack for rounding
+        lower = 0;
+        upper = right - left;
+        trimSpan(u, du, draw->srcW, &lower, &upper);
+        trimSpan(v, dv, draw->srcH, &lower, &upper);
+        if (lower >= upper){
+            continue;
+        }
+        spanStart = left + (int)floor(lower) - 1;
+        spanEnd = left + (int)ceil(upper) + 1;
+        spanStart = (spanStart < left) ? left : spanStart;
+        spanEnd = (spanEnd > right) ? right : spanEnd;
+        if (spanStart >= spanEnd){
+            continue;
+        }
+        
+        span.u = lround((u + du * (spanStart - left)) * 65536);
+        span.v = lround((v + dv * (spanStart - left)) * 65536);
+        if (band != NULL){
+            rasterizeSpanUnder(spanStart, y, spanEnd - spanStart, &span, band);
+        } else if (span.spans != NULL){
+            rasterizeSpanRuns(targetPixels + (y * targetPitch) + spanStart, spanEnd - spanStart, &span);
+        } else {
+            rasterizeSpan(targetPixels + (y * targetPitch) + spanStart, spanEnd - spanStart, &span);
+        }
+    }
+}
+
+void angleTrig(float angle, double *c, double *s){
+    //unrotated draws mixed in don't throw out the remembered angle
+    if (angle == 0){
+        *c = 1;
+        *s = 0;
+        return;
+    }
+    if (angle != trigAngle){
+        double radians = angle * (M_PI / 180.0);
+        trigCos = cos(radians);
+        trigSin = sin(radians);
+        trigAngle = angle;
+    }
+    *c = trigCos;
+    *s = trigSin;
+}
+
+void trimSpan(double start, double step, double limit, double *lower, double *upper){
+    //narrow [lower, upper) to the steps where start + step*i is within [0, limit)
+    double first, last;
+    if (step > 1e-9 || step < -1e-9){
+        first = (0 - start) / step;
+        last = (limit - start) / step;
+        if (step < 0){
+            double temp = first;
+            first = last;
+            last = temp;
+        }
+        *lower = (first > *lower) ? first : *lower;
+        *upper = (last < *upper) ? last : *upper;
+    } else if (start < 0 || start >= limit){
+        *upper = *lower;
+    }
+}
+
+
+/////////////////////////////////////////////////
+// Inner loops
+/////////////////////////////////////////////////
+Uint32 blendPixel(Uint32 src, Uint32 dst){
+    /*
+     * SDL_BLENDMODE_BLEND on RGBA8888, alpha is the low byte:
+     *   dstRGB = srcRGB * srcA + dstRGB * (1 - srcA)
+     *   dstA = srcA + dstA * (1 - srcA)
+     * Dividing by 255 as (x + (x >> 8)) >> 8 after adding 128, which is exact for the range we have.  The SIMD
+     * versions do exactly this, so all of them produce the same pixels.
+     */
+    Uint32 alpha = src & 0xFF;
+    if (alpha == 0){
+        return dst;
+    } else if (alpha == 0xFF){
+        return src;
+    }
+    
+    Uint32 inverse = 255 - alpha;
+    Uint32 result = 0;
+    Uint32 x;
+    int shift;
+    for (shift = 8; shift < 32; shift += 8){
+        x = (((src >> shift) & 0xFF) * alpha) + (((dst >> shift) & 0xFF) * inverse) + 128;
+        result |= ((x + (x >> 8)) >> 8) << shift;
+    }
+    x = (255 * alpha) + ((dst & 0xFF) * inverse) + 128;
+    result |= (x + (x >> 8)) >> 8;
+    
+    return result;
+}
+
+void rasterizeSpanScalar(Uint32 *dst, int count, const AffineSpan *span){
+    Sint32 u = span->u;
+    Sint32 v = span->v;
+    int i, texelX, texelY;
+    for (i = 0; i < count; i++){
+        texelX = u >> 16;
+        texelY = v >> 16;
+        if ((unsigned)texelX < (unsigned)span->srcWidth && (unsigned)texelY < (unsigned)span->srcHeight){
+            dst[i] = blendPixel(span->src[(texelY * span->srcPitch) + texelX], dst[i]);
+        }
+        u += span->du;
+        v += span->dv;
+    }
+}
+
+void rasterizeSpanRuns(Uint32 *dst, int count, const AffineSpan *span){
+    /*
+     * The scalar loop reading from the image's spans, a stretch at a time.  Wherever the texel lands, it works out
+     * how many pixels until the texel coordinates leave the span they're in (or the gap they're in), or move to
+     * another row of the image, and does all of those at once - blending them with no more checks inside a span
+     * (with the SIMD loop if there are enough), and jumping straight over them in a gap, so a transparent gap costs
+     * about the same however wide it is.
+     * Jumping adds the same steps the loop would have, so the pixels drawn are exactly the ones
+     * rasterizeSpanScalar would draw.
+     */
+    const ImageSpans *runs = span->spans;
+    const ImageSpan *run;
+    const Uint32 *texels;
+    Sint32 u = span->u;
+    Sint32 v = span->v;
+    Sint32 du = span->du;
+    Sint32 dv = span->dv;
+    double duReciprocal = (du != 0) ? 1.0 / abs(du) : 0;
+    double dvReciprocal = (dv != 0) ? 1.0 / abs(dv) : 0;
+    AffineSpan inside = *span;
+    inside.srcPitch = 0;
+    inside.srcHeight = 1;
+    inside.spans = NULL;
+    int i = 0;
+    int texelX, texelY, x, first, last, k, j, runLeft, runRight;
+    Sint32 stretch, steps;
+    while (i < count){
+        texelX = u >> 16;
+        texelY = v >> 16;
+        if ((unsigned)texelX >= (unsigned)span->srcWidth || (unsigned)texelY >= (unsigned)span->srcHeight){
+            i++;
+            u += du;
+            v += dv;
+            continue;
+        }
+        
+        //the first span in the row that doesn't end before the texel
+        x = span->spansX + texelX;
+        first = runs->rowSpans[span->spansY + texelY];
+        last = runs->rowSpans[span->spansY + texelY + 1];
+        for (k = first; k < last && runs->spans[k].x + runs->spans[k].length <= x; k++){
+        }
+        
+        //until the row changes or the count runs out
+        stretch = count - i;
+        if (dv > 0){
+            steps = stepsToReach(v, (Sint64)(texelY + 1) << 16, dv, dvReciprocal);
+            stretch = (steps < stretch) ? steps : stretch;
+        } else if (dv < 0){
+            steps = stepsToReach(v, ((Sint64)texelY << 16) - 1, dv, dvReciprocal);
+            stretch = (steps < stretch) ? steps : stretch;
+        }
+        
+        run = runs->spans + k;
+        if (k < last && run->x <= x){
+            //inside a span, in texels of the part being drawn, which the span might run past
+            runLeft = run->x - span->spansX;
+            runRight = run->x + run->length - span->spansX;
+            runLeft = (runLeft < 0) ? 0 : runLeft;
+            runRight = (runRight > span->srcWidth) ? span->srcWidth : runRight;
+            if (du > 0){
+                steps = stepsToReach(u, (Sint64)runRight << 16, du, duReciprocal);
+                stretch = (steps < stretch) ? steps : stretch;
+            } else if (du < 0){
+                steps = stepsToReach(u, ((Sint64)runLeft << 16) - 1, du, duReciprocal);
+                stretch = (steps < stretch) ? steps : stretch;
+            }
+            texels = runs->pixels + run->offset - run->x + span->spansX;
+            if (stretch >= minimumSimdStretch){
+                //a one row image as far as the widest loop knows, starting from the same texel
+                inside.src = texels;
+                inside.srcWidth = runRight;
+                inside.u = u;
+                inside.v = v - (texelY << 16);
+                rasterizeSpan(dst + i, stretch, &inside);
+                u += du * stretch;
+            } else {
+                for (j = 0; j < stretch; j++){
+                    dst[i + j] = blendPixel(texels[u >> 16], dst[i + j]);
+                    u += du;
+                }
+            }
+            i += stretch;
+            v += dv * stretch;
+            continue;
+        }
+        
+        //in a gap, until the span ahead
+        if (du > 0 && k < last){
+            steps = stepsToReach(u, (Sint64)(run->x - span->spansX) << 16, du, duReciprocal);
+            stretch = (steps < stretch) ? steps : stretch;
+        } else if (du < 0 && k > first){
+            //the span behind ends at its last pixel's right edge, so one less than that is inside it
+            steps = stepsToReach(u, ((Sint64)(run[-1].x + run[-1].length - span->spansX) << 16) - 1, du, duReciprocal);
+            stretch = (steps < stretch) ? steps : stretch;
+        }
+        i += stretch;
+        u += du * stretch;
+        v += dv * stretch;
+    }
+}
+
+Sint32 stepsToReach(Sint64 from, Sint64 to, Sint32 step, double reciprocal){
+    //the fewest steps from from that get to or past to, going the way step goes; at least one
+    Sint64 distance = (step > 0) ? to - from : from - to;
+    Sint64 size = (step > 0) ? step : -(Sint64)step;
+    if (distance <= 0){
+        return 1;
+    }
+    //multiplying by 1 / size gets within a step of it, and is a lot cheaper than dividing
+    Sint64 steps = (Sint64)(distance * reciprocal);
+    while (steps * size < distance){
+        steps++;
+    }
+    while (steps > 1 && (steps - 1) * size >= distance){
+        steps--;
+    }
+    return (steps > 0x7FFFFFFF) ? 0x7FFFFFFF : (Sint32)steps;
+}
+
+void rasterizeSpanUnder(int x, int y, int count, const AffineSpan *span, RenderBand *band){
+    /*
+     * The scalar loop again, but checking the coverage mask first.  This is the front to back path, where most
+     * pixels are skipped rather than drawn, so there's not much for SIMD to speed up.
+     */
+    Uint32 *dst = (Uint32 *)((Uint8 *)target->pixels + (y * target->pitch));
+    Uint32 *mask = coverage + (y * coverageWords);
+    Sint32 u = span->u;
+    Sint32 v = span->v;
+    int end = x + count;
+    int texelX, texelY, skip;
+    Uint32 texel;
+    while (x < end){
+        //a word of the mask that's all set covers the rest of its 32 pixels
+        if (mask[x >> 5] == 0xFFFFFFFF){
+            skip = 32 - (x & 31);
+            skip = (skip > end - x) ? end - x : skip;
+            band->coverage.blocksRejected++;
+            band->coverage.pixelsRejected += skip;
+            x += skip;
+            u += span->du * skip;
+            v += span->dv * skip;
+            continue;
+        }
+        
+        if (mask[x >> 5] & (1u << (x & 31))){
+            band->coverage.pixelsRejected++;
+        } else {
+            texelX = u >> 16;
+            texelY = v >> 16;
+            if ((unsigned)texelX < (unsigned)span->srcWidth && (unsigned)texelY < (unsigned)span->srcHeight){
+                if (span->spans != NULL){
+                    texel = getImageSpansPixel(span->spans, span->spansX + texelX, span->spansY + texelY);
+                } else {
+                    texel = span->src[(texelY * span->srcPitch) + texelX];
+                }
+                if (texel & 0xFF){
+                    dst[x] = underPixel(texel, dst[x]);
+                    band->coverage.pixelsWritten++;
+                    if ((dst[x] & 0xFF) == 0xFF){
+                        mask[x >> 5] |= 1u << (x & 31);
+                        rowUncovered[y]--;
+                        if (rowUncovered[y] == 0){
+                            return;
+                        }
+                    }
+                }
+            }
+        }
+        x++;
+        u += span->du;
+        v += span->dv;
+    }
+}
+
+Uint32 underPixel(Uint32 src, Uint32 dst){
+    /*
+     * src goes under dst, which is premultiplied:
+     *   weight = srcA * (1 - dstA)
+     *   dstRGB = dstRGB + srcRGB * weight
+     *   dstA = dstA + weight
+     * An opaque src under nothing gives src back exactly, which is nearly every pixel of a stack.
+     */
+    Uint32 alpha = src & 0xFF;
+    Uint32 dstAlpha = dst & 0xFF;
+    if (dstAlpha == 0 && alpha == 0xFF){
+        return src;
+    }
+    
+    Uint32 x = (alpha * (255 - dstAlpha)) + 128;
+    Uint32 weight = (x + (x >> 8)) >> 8;
+    Uint32 result = dstAlpha + weight;
+    Uint32 channel;
+    int shift;
+    for (shift = 8; shift < 32; shift += 8){
+        x = (((src >> shift) & 0xFF) * weight) + 128;
+        channel = ((dst >> shift) & 0xFF) + ((x + (x >> 8)) >> 8);
+        result |= ((channel > 255) ? 255 : channel) << shift;
+    }
+    
+    return result;
+}
+
+Uint32 resolvePixel(Uint32 accumulated, Uint32 background){
+    //the background under the premultiplied accumulation, and back to straight alpha
+    Uint32 alpha = accumulated & 0xFF;
+    if (alpha == 0xFF){
+        return accumulated;
+    } else if (alpha == 0){
+        return background;
+    }
+    
+    Uint32 result = underPixel(background, accumulated);
+    Uint32 resultAlpha = result & 0xFF;
+    if (resultAlpha == 0xFF || resultAlpha == 0){
+        return result;
+    }
+    Uint32 straight = resultAlpha;
+    int shift;
+    for (shift = 8; shift < 32; shift += 8){
+        straight |= ((((result >> shift) & 0xFF) * 255 + (resultAlpha / 2)) / resultAlpha) << shift;
+    }
+    return straight;
+}
+
+#if HAS_X86_INTRINSICS && defined(__SSE2__)
+void rasterizeSpanSSE2(Uint32 *dst, int count, const AffineSpan *span){
+    /*
+     * Four pixels at a time.  Coordinates and bounds are done as vectors, SSE2 can't gather so the texel reads are
+     * scalar, then the blend is done on 16 bit lanes.  Texels outside the image read as 0, which has zero alpha and
+     * so leaves the destination alone without needing a separate mask.
+     */
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i minusOne = _mm_set1_epi32(-1);
+    const __m128i width = _mm_set1_epi32(span->srcWidth);
+    const __m128i height = _mm_set1_epi32(span->srcHeight);
+    const __m128i alphaLanes = _mm_set_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    const __m128i all255 = _mm_set1_epi16(255);
+    const __m128i half = _mm_set1_epi16(128);
+    const __m128i stepU = _mm_set1_epi32(span->du * 4);
+    const __m128i stepV = _mm_set1_epi32(span->dv * 4);
+    __m128i u = _mm_add_epi32(_mm_set1_epi32(span->u), _mm_set_epi32(span->du * 3, span->du * 2, span->du, 0));
+    __m128i v = _mm_add_epi32(_mm_set1_epi32(span->v), _mm_set_epi32(span->dv * 3, span->dv * 2, span->dv, 0));
+    
+    union { __m128i vector; Sint32 values[4]; } texelX, texelY;
+    union { __m128i vector; Uint32 values[4]; } texels;
+    __m128i inside, srcLow, srcHigh, dstLow, dstHigh, alphaLow, alphaHigh, x, d;
+    int i, k, insideBits;
+    for (i = 0; i + 4 <= count; i += 4){
+        texelX.vector = _mm_srai_epi32(u, 16);
+        texelY.vector = _mm_srai_epi32(v, 16);
+        inside = _mm_and_si128(
+            _mm_and_si128(_mm_cmpgt_epi32(texelX.vector, minusOne), _mm_cmplt_epi32(texelX.vector, width)),
+            _mm_and_si128(_mm_cmpgt_epi32(texelY.vector, minusOne), _mm_cmplt_epi32(texelY.vector, height))
+        );
+        insideBits = _mm_movemask_ps(_mm_castsi128_ps(inside));
+        u = _mm_add_epi32(u, stepU);
+        v = _mm_add_epi32(v, stepV);
+        if (insideBits == 0){
+            continue;
+        }
+        
+        for (k = 0; k < 4; k++){
+            texels.values[k] = (insideBits & (1 << k)) ? span->src[(texelY.values[k] * span->srcPitch) + texelX.values[k]] : 0;
+        }
+        
+        //widen to 16 bits per channel, spread each pixel's alpha across its channels, and treat source alpha as 255 so the alpha channel works out too
+        d = _mm_loadu_si128((__m128i *)(dst + i));
+        srcLow = _mm_unpacklo_epi8(texels.vector, zero);
+        srcHigh = _mm_unpackhi_epi8(texels.vector, zero);
+        dstLow = _mm_unpacklo_epi8(d, zero);
+        dstHigh = _mm_unpackhi_epi8(d, zero);
+        alphaLow = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcLow, 0), 0);
+        alphaHigh = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcHigh, 0), 0);
+        srcLow = _mm_or_si128(srcLow, alphaLanes);
+        srcHigh = _mm_or_si128(srcHigh, alphaLanes);
+        
+        x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(srcLow, alphaLow), _mm_mullo_epi16(dstLow, _mm_sub_epi16(all255, alphaLow))), half);
+        dstLow = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(srcHigh, alphaHigh), _mm_mullo_epi16(dstHigh, _mm_sub_epi16(all255, alphaHigh))), half);
+        dstHigh = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+        
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(dstLow, dstHigh));
+    }
+    
+    //whatever doesn't fill a vector
+    if (i < count){
+        AffineSpan rest = *span;
+        rest.u = span->u + (span->du * i);
+        rest.v = span->v + (span->dv * i);
+        rasterizeSpanScalar(dst + i, count - i, &rest);
+    }
+}
+#endif
+
+#if HAS_X86_INTRINSICS
+__attribute__((target("avx2")))
+void rasterizeSpanAVX2(Uint32 *dst, int count, const AffineSpan *span){
+    //the same as the SSE2 version but eight pixels at a time, and the texel reads are a masked gather
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i minusOne = _mm256_set1_epi32(-1);
+    const __m256i width = _mm256_set1_epi32(span->srcWidth);
+    const __m256i height = _mm256_set1_epi32(span->srcHeight);
+    const __m256i pitch = _mm256_set1_epi32(span->srcPitch);
+    const __m256i alphaLanes = _mm256_set_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+    const __m256i all255 = _mm256_set1_epi16(255);
+    const __m256i half = _mm256_set1_epi16(128);
+    const __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i stepU = _mm256_set1_epi32(span->du * 8);
+    const __m256i stepV = _mm256_set1_epi32(span->dv * 8);
+    __m256i u = _mm256_add_epi32(_mm256_set1_epi32(span->u), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(span->du)));
+    __m256i v = _mm256_add_epi32(_mm256_set1_epi32(span->v), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(span->dv)));
+    
+    __m256i texelX, texelY, inside, index, texels, srcLow, srcHigh, dstLow, dstHigh, alphaLow, alphaHigh, x, d;
+    int i;
+    for (i = 0; i + 8 <= count; i += 8){
+        texelX = _mm256_srai_epi32(u, 16);
+        texelY = _mm256_srai_epi32(v, 16);
+        inside = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpgt_epi32(texelX, minusOne), _mm256_cmpgt_epi32(width, texelX)),
+            _mm256_and_si256(_mm256_cmpgt_epi32(texelY, minusOne), _mm256_cmpgt_epi32(height, texelY))
+        );
+        u = _mm256_add_epi32(u, stepU);
+        v = _mm256_add_epi32(v, stepV);
+        if (_mm256_testz_si256(inside, inside)){
+            continue;
+        }
+        
+        index = _mm256_add_epi32(_mm256_mullo_epi32(texelY, pitch), texelX);
+        texels = _mm256_mask_i32gather_epi32(zero, (const int *)span->src, index, inside, 4);
+        
+        d = _mm256_loadu_si256((__m256i *)(dst + i));
+        srcLow = _mm256_unpacklo_epi8(texels, zero);
+        srcHigh = _mm256_unpackhi_epi8(texels, zero);
+        dstLow = _mm256_unpacklo_epi8(d, zero);
+        dstHigh = _mm256_unpackhi_epi8(d, zero);
+        alphaLow = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(srcLow, 0), 0);
+        alphaHigh = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(srcHigh, 0), 0);
+        srcLow = _mm256_or_si256(srcLow, alphaLanes);
+        srcHigh = _mm256_or_si256(srcHigh, alphaLanes);
+        
+        x = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(srcLow, alphaLow), _mm256_mullo_epi16(dstLow, _mm256_sub_epi16(all255, alphaLow))), half);
+        dstLow = _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+        x = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(srcHigh, alphaHigh), _mm256_mullo_epi16(dstHigh, _mm256_sub_epi16(all255, alphaHigh))), half);
+        dstHigh = _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+        
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(dstLow, dstHigh));
+    }
+    
+    if (i < count){
+        AffineSpan rest = *span;
+        rest.u = span->u + (span->du * i);
+        rest.v = span->v + (span->dv * i);
+        rasterizeSpanScalar(dst + i, count - i, &rest);
+    }
+}
+#endif
+
+
+/////////////////////////////////////////////////
+// Access
+/////////////////////////////////////////////////
+SDL_Surface *getSoftwareRenderSurface(){
+    return target;
+}
+
+const char *getSoftwareRendererInstructionSet(){
+    return instructionSet;
+}
+
+int getSoftwareRenderBandCount(){
+    return numBands;
+}
+
+double getSoftwareRenderBandMilliseconds(int band){
+    return (bands[band].ticks * 1000.0) / SDL_GetPerformanceFrequency();
+}
+
+int getSoftwareRenderBandDrawCount(int band){
+    return bands[band].numDraws;
+}
+
+void getSoftwareRenderCoverage(SoftwareCoverageCounts *counts){
+    int i;
+    counts->pixelsWritten = 0;
+    counts->pixelsRejected = 0;
+    counts->blocksRejected = 0;
+    counts->rowsRejected = 0;
+    for (i = 0; i < numBands; i++){
+        counts->pixelsWritten += bands[i].coverage.pixelsWritten;
+        counts->pixelsRejected += bands[i].coverage.pixelsRejected;
+        counts->blocksRejected += bands[i].coverage.blocksRejected;
+        counts->rowsRejected += bands[i].coverage.rowsRejected;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include "graphics.h"
+#include "SDL2/SDL.h"
+
+/*
+ * A CPU rasterizer for the stack pass, for machines where SDL ends up with its own software renderer and
+ * SDL_RenderCopyEx with an angle is painfully slow.  Everything is drawn into an RGBA8888 surface, which is
+ * uploaded to a texture once at the end of the frame.
+ *
+ * The drawing calls mirror graphics.h - softwareDrawImageRotate takes the same arguments as drawImageRotate and
+ * should put the same pixels in the same places (sampling is nearest neighbor, blending is SDL_BLENDMODE_BLEND).
+ * Only images loaded with loadImageFromFileKeepPixels can be drawn, since we need their pixels.  Images encoded
+ * with encodeImageSpans are drawn from their spans instead, by a scalar loop that jumps across the gaps between
+ * them in one step.  Unrotated, that makes a mostly transparent image cost about what its solid pixels do; rotated,
+ * each image row crossed means finding the place in its spans again, which costs more than the SIMD loops save.
+ * Same pixels either way.
+ *
+ * Texture coordinates are stepped across each row in 16.16 fixed point.  The inner loop uses AVX2 or SSE2 when
+ * the CPU has them (checked at init), and every path blends with the same integer math so they match exactly.
+ *
+ * Draws are queued, and nothing is rasterized until copySoftwareRenderToImage.  Then the target is cut into
+ * horizontal bands, each band gets the list of draws that touch it (in order), and the bands are rasterized in
+ * parallel on a pool of threads.  Each band only writes its own rows so there's no locking while drawing.
+ *
+ * Draws are normally done in order, each blended over the last, so a stack's pixel is drawn once for every layer
+ * under it.  setSoftwareFrontToBack(1) does them in reverse instead, each one going under what's been drawn, and
+ * keeps a mask of which pixels are opaque already so the draws underneath skip them - about one write per pixel.
+ * Opaque pixels come out the same either way; partly transparent ones can be a step or two off from the rounding.
+ *
+ * Renderers that work out every pixel for themselves, rather than drawing images, can use the same bands and
+ * threads with runSoftwareRenderPass.
+ */
+
+//what the coverage mask saved in the last frame, summed over the bands
+typedef struct SoftwareCoverageCounts{
+    long pixelsWritten;
+    long pixelsRejected; //already covered when a draw got to them, including the ones below
+    long blocksRejected; //times 32 covered pixels were skipped at once
+    long rowsRejected; //times a draw skipped a whole row because every pixel in it was covered
+} SoftwareCoverageCounts;
+
+//fills in rows top up to bottom of the target; pixels is the target's first row, pitch is in pixels
+typedef void (*SoftwareRenderPass)(Uint32 *pixels, int pitch, int width, int top, int bottom, void *data);
+
+
+/////////////////////////////////////////////////
+// Init/Term
+/////////////////////////////////////////////////
+void initSoftwareRenderer(int width, int height, int numThreads); //numThreads of 0 or less means one per CPU core
+void termSoftwareRenderer();
+void resizeSoftwareRender(int width, int height); //keeps the threads, drops anything queued
+
+
+/////////////////////////////////////////////////
+// Drawing
+/////////////////////////////////////////////////
+void clearSoftwareRender(Uint8 r, Uint8 g, Uint8 b, Uint8 a);
+void setSoftwareFrontToBack(int enabled); //only used for frames that start with clearSoftwareRender
+void setSoftwareDrawScaling(int scaling);
+//following draws are each drawn this many times, each copy a pixel (before scaling) higher than the last, to fill
+//the gaps between pitched slices with one draw instead of several
+void setSoftwareExtrusion(int copies);
+void softwareDrawImageRotate(Image *image, float x, float y, float angle, int centerX, int centerY);
+void softwareDrawImageSrcRotate(Image *image, ImageRect *srcRect, float x, float y, float angle, int centerX, int centerY); //like drawImageSrcRotate
+void softwareDrawImagePreRotated(Image *image, ImageRect *srcRect, float x, float y, float angle); //like drawImagePreRotated
+void copySoftwareRenderToImage(Image *dst); //rasterizes everything queued, dst must be the same size as the software render
+void runSoftwareRenderPass(SoftwareRenderPass pass, void *data); //right away, after anything queued, each band on whichever thread grabs it
+
+
+/////////////////////////////////////////////////
+// Access
+/////////////////////////////////////////////////
+SDL_Surface *getSoftwareRenderSurface();
+const char *getSoftwareRendererInstructionSet(); //"AVX2", "SSE2" or "scalar", for logging
+//how each band did in the last frame, for seeing how well the work is spread out
+int getSoftwareRenderBandCount();
+double getSoftwareRenderBandMilliseconds(int band);
+int getSoftwareRenderBandDrawCount(int band);
+void getSoftwareRenderCoverage(SoftwareCoverageCounts *counts); //all zero unless the last frame was drawn front to back
+
+#endif
@@ -0,0 +1,214 @@
+#include "stack_billboard.h"
+#include "graphics.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+
+static Uint32 depthKey(float depth);
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackBillboardList *init_StackBillboardList(StackBillboardList *self){
+    self->billboards = NULL;
+    self->numBillboards = 0;
+    self->capacity = 0;
+    
+    self->order = NULL;
+    self->numOrdered = 0;
+    self->bucketStart = NULL;
+    self->numBuckets = 0;
+    self->bucketCapacity = 0;
+    self->keys = NULL;
+    self->keyScratch = NULL;
+    self->orderScratch = NULL;
+    self->sortCapacity = 0;
+    
+    return self;
+}
+
+void free_StackBillboardList(StackBillboardList *self){
+    if (self == NULL){
+        LOG_WAR("Tried to free NULL StackBillboardList");
+        return;
+    }
+    
+    free(self->billboards);
+    free(self->order);
+    free(self->bucketStart);
+    free(self->keys);
+    free(self->keyScratch);
+    free(self->orderScratch);
+    
+    free(self);
+}
+
+
+/////////////////////////////////////////////////
+// Billboards
+/////////////////////////////////////////////////
+StackBillboard *addStackBillboard(StackBillboardList *self, Sprite *sprite, Animation *animation, float x, float y, int layer){
+    if (self->numBillboards >= self->capacity){
+        self->capacity = (self->capacity == 0) ? 64 : self->capacity * 2;
+        self->billboards = realloc(self->billboards, sizeof(StackBillboard) * self->capacity);
+    }
+    
+    StackBillboard *result = self->billboards + self->numBillboards;
+    result->sprite = sprite;
+    result->animation = animation;
+    result->mips = NULL;
+    result->x = x;
+    result->y = y;
+    result->layer = layer;
+    result->_bucket = -1;
+    result->_depth = 0;
+    result->_screenX = 0;
+    self->numBillboards++;
+    
+    return result;
+}
+
+Image *getStackBillboardFrame(const StackBillboard *self, ImageRect *frame){
+    //same frame drawAnimation would pick
+    const Sprite *s = self->sprite;
+    if (self->animation == NULL){
+        frame->x = 0;
+        frame->y = 0;
+        frame->w = s->image->width;
+        frame->h = s->image->height;
+        return s->image;
+    }
+    
+    int spriteIndex = self->animation->spriteIndices[self->animation->currLoop][self->animation->currFrame];
+    frame->x = (spriteIndex % s->numFramesPerRow) * s->frameWidth;
+    frame->y = (spriteIndex / s->numFramesPerRow) * s->frameHeight;
+    frame->w = s->frameWidth;
+    frame->h = s->frameHeight;
+    return s->image;
+}
+
+Image *getStackBillboardMipFrame(const StackBillboard *self, int *level, ImageRect *frame){
+    Image *image = getStackBillboardFrame(self, frame);
+    if (*level <= 0 || self->mips == NULL){
+        *level = 0;
+        return image;
+    }
+    
+    //frames are laid out on a grid, so they halve along with the sheet
+    frame->x >>= *level;
+    frame->y >>= *level;
+    frame->w >>= *level;
+    frame->h >>= *level;
+    return self->mips[*level - 1];
+}
+
+
+/////////////////////////////////////////////////
+// Sorting
+/////////////////////////////////////////////////
+void sortStackBillboards(StackBillboardList *self, int numBuckets){
+    /*
+     * An LSD radix sort on depth, a byte at a time, then one more stable counting pass on the bucket.  Passes where
+     * every key has the same byte (common, since billboards on screen are all about the same depth) are skipped.
+     */
+    int i, pass, shift, digit, total, count;
+    Uint32 *swapKeys;
+    int *swapOrder;
+    int counts[256];
+    
+    if (self->numBillboards > self->sortCapacity){
+        self->sortCapacity = self->numBillboards;
+        self->order = realloc(self->order, sizeof(int) * self->sortCapacity);
+        self->orderScratch = realloc(self->orderScratch, sizeof(int) * self->sortCapacity);
+        self->keys = realloc(self->keys, sizeof(Uint32) * self->sortCapacity);
+        self->keyScratch = realloc(self->keyScratch, sizeof(Uint32) * self->sortCapacity);
+    }
+    if (numBuckets + 1 > self->bucketCapacity){
+        self->bucketCapacity = numBuckets + 1;
+        self->bucketStart = realloc(self->bucketStart, sizeof(int) * self->bucketCapacity);
+    }
+    self->numBuckets = numBuckets;
+    
+    //only the billboards being drawn
+    self->numOrdered = 0;
+    for (i = 0; i < self->numBillboards; i++){
+        if (self->billboards[i]._bucket < 0 || self->billboards[i]._bucket >= numBuckets){
+            continue;
+        }
+        self->order[self->numOrdered] = i;
+        self->keys[self->numOrdered] = depthKey(self->billboards[i]._depth);
+        self->numOrdered++;
+    }
+    
+    for (pass = 0; pass < 4; pass++){
+        shift = pass * 8;
+        memset(counts, 0, sizeof(counts));
+        for (i = 0; i < self->numOrdered; i++){
+            counts[(self->keys[i] >> shift) & 0xFF]++;
+        }
+        if (self->numOrdered == 0 || counts[(self->keys[0] >> shift) & 0xFF] == self->numOrdered){
+            continue;
+        }
+        
+        total = 0;
+        for (digit = 0; digit < 256; digit++){
+            count = counts[digit];
+            counts[digit] = total;
+            total += count;
+        }
+        for (i = 0; i < self->numOrdered; i++){
+            digit = (self->keys[i] >> shift) & 0xFF;
+            self->keyScratch[counts[digit]] = self->keys[i];
+            self->orderScratch[counts[digit]] = self->order[i];
+            counts[digit]++;
+        }
+        
+        swapKeys = self->keys;
+        self->keys = self->keyScratch;
+        self->keyScratch = swapKeys;
+        swapOrder = self->order;
+        self->order = self->orderScratch;
+        self->orderScratch = swapOrder;
+    }
+    
+    //and finally into buckets, which keeps the depth order within each
+    for (i = 0; i <= numBuckets; i++){
+        self->bucketStart[i] = 0;
+    }
+    for (i = 0; i < self->numOrdered; i++){
+        self->bucketStart[self->billboards[self->order[i]]._bucket + 1]++;
+    }
+    for (i = 0; i < numBuckets; i++){
+        self->bucketStart[i + 1] += self->bucketStart[i];
+    }
+    for (i = 0; i < self->numOrdered; i++){
+        //bucketStart[bucket] is used as the next free spot, then put back below
+        self->orderScratch[self->bucketStart[self->billboards[self->order[i]]._bucket]++] = self->order[i];
+    }
+    for (i = numBuckets; i > 0; i--){
+        self->bucketStart[i] = self->bucketStart[i - 1];
+    }
+    self->bucketStart[0] = 0;
+    
+    swapOrder = self->order;
+    self->order = self->orderScratch;
+    self->orderScratch = swapOrder;
+}
+
+int getStackBillboardBucket(const StackBillboardList *self, int bucket, const int **indices){
+    if (bucket < 0 || bucket >= self->numBuckets){
+        *indices = NULL;
+        return 0;
+    }
+    
+    *indices = self->order + self->bucketStart[bucket];
+    return self->bucketStart[bucket + 1] - self->bucketStart[bucket];
+}
+
+Uint32 depthKey(float depth){
+    //flips a float's bits so that comparing them as unsigned ints orders them like the floats
+    Uint32 bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    return (bits & 0x80000000) ? ~bits : bits | 0x80000000;
+}
@@ -0,0 +1,79 @@
+#ifndef STACK_BILLBOARD_H
+#define STACK_BILLBOARD_H
+
+#include "graphics.h"
+
+/*
+ * Billboards are flat sprites that always face the camera (NPCs, particles, that sort of thing), standing among
+ * the stacks.  Since the stacks are drawn a layer at a time rather than an object at a time, a billboard is cut
+ * into horizontal strips, a row per layer, and each strip is drawn along with the layer it's level with.  That way
+ * a crate's top layers still cover the head of someone standing behind it, without any per-object depth test.
+ *
+ * Billboards in the same layer do still need drawing back to front.  Each frame whoever draws them fills in
+ * every billboard's _bucket (the layer its bottom strip is in) and _depth (its screen y), and then
+ * sortStackBillboards buckets them by layer and radix sorts them by depth, which is linear in the number of
+ * billboards rather than n log n, and doesn't care how many there are in a layer.
+ */
+
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+typedef struct StackBillboard{
+    Sprite *sprite;
+    Animation *animation; //NULL to draw the sprite's whole image
+    Image **mips; //array [level - 1], the sprite's image box filtered to half size each level, NULL to always draw it full size
+    //where the middle of the sprite's bottom edge stands, in world coordinates
+    float x;
+    float y;
+    int layer; //the layer its bottom row is level with, 0 for the floor
+    //filled in each frame before sorting
+    int _bucket; //-1 to leave it out this frame
+    float _depth; //screen y of its feet
+    float _screenX;
+} StackBillboard;
+
+typedef struct StackBillboardList{
+    StackBillboard *billboards; //array
+    int numBillboards;
+    int capacity;
+    
+    //the last sort: indices of the sorted billboards, bucket by bucket, each bucket back to front
+    int *order; //array
+    int numOrdered;
+    int *bucketStart; //array [bucket + 1], where each bucket starts in order
+    int numBuckets;
+    int bucketCapacity;
+    //scratch for sorting
+    Uint32 *keys;
+    Uint32 *keyScratch;
+    int *orderScratch;
+    int sortCapacity;
+} StackBillboardList;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackBillboardList *init_StackBillboardList(StackBillboardList *self);
+void free_StackBillboardList(StackBillboardList *self); //doesn't free the sprites or animations
+
+
+/////////////////////////////////////////////////
+// Billboards
+/////////////////////////////////////////////////
+//returns the billboard, which is valid until the next add
+StackBillboard *addStackBillboard(StackBillboardList *self, Sprite *sprite, Animation *animation, float x, float y, int layer);
+//the image the billboard is showing right now, and the part of it that's the current frame
+Image *getStackBillboardFrame(const StackBillboard *self, ImageRect *frame);
+//the same from a mip of the sprite's image, level is set to 0 if the billboard has no mips
+Image *getStackBillboardMipFrame(const StackBillboard *self, int *level, ImageRect *frame);
+
+
+/////////////////////////////////////////////////
+// Sorting
+/////////////////////////////////////////////////
+void sortStackBillboards(StackBillboardList *self, int numBuckets); //buckets at or past numBuckets are left out
+int getStackBillboardBucket(const StackBillboardList *self, int bucket, const int **indices); //how many are in the bucket, indices back to front
+
+#endif
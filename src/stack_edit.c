@@ -0,0 +1,254 @@
+#include "stack_edit.h"
+#include "graphics.h"
+#include "logging.h"
+#include "random.h"
+#include <math.h>
+#include <stdlib.h>
+
+static Uint32 *findVoxel(EditableStackModel *self, int x, int y, int layer, int *slice, int *u, int *v);
+static void markDirty(EditableStackModel *self, int slice, int x, int y);
+static void unionRect(ImageRect *into, const ImageRect *other);
+static void flushWholeSlices(EditableStackModel *self);
+
+static const int benchmarkFrames = 200;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+EditableStackModel *init_EditableStackModel(EditableStackModel *self, StackModel *model){
+    self->model = model;
+    self->edits = calloc(model->numSlices, sizeof(StackSliceEdits));
+    self->numEdits = 0;
+    self->lastFlushRects = 0;
+    self->lastFlushPixels = 0;
+    
+    return self;
+}
+
+void free_EditableStackModel(EditableStackModel *self){
+    if (self == NULL){
+        LOG_WAR("Tried to free NULL EditableStackModel");
+        return;
+    }
+    
+    free(self->edits);
+    
+    free(self);
+}
+
+
+/////////////////////////////////////////////////
+// Editing
+/////////////////////////////////////////////////
+int setStackVoxel(EditableStackModel *self, int x, int y, int layer, Uint32 color){
+    int slice, u, v;
+    Uint32 *voxel = findVoxel(self, x, y, layer, &slice, &u, &v);
+    if (voxel == NULL || *voxel == color){
+        return 0;
+    }
+    
+    *voxel = color;
+    markDirty(self, slice, u, v);
+    self->numEdits++;
+    return 1;
+}
+
+int carveStackSphere(EditableStackModel *self, float x, float y, float layer, float radius){
+    //voxel centers inside the ball, a layer being as thick as a pixel is wide
+    int u, v, w, slice, sliceX, sliceY;
+    float dx, dy, dz;
+    Uint32 *voxel;
+    int carved = 0;
+    for (w = (int)floorf(layer - radius); w <= (int)ceilf(layer + radius); w++){
+        dz = (w + 0.5f) - layer;
+        for (v = (int)floorf(y - radius); v <= (int)ceilf(y + radius); v++){
+            dy = (v + 0.5f) - y;
+            for (u = (int)floorf(x - radius); u <= (int)ceilf(x + radius); u++){
+                dx = (u + 0.5f) - x;
+                if ((dx * dx) + (dy * dy) + (dz * dz) > radius * radius){
+                    continue;
+                }
+                voxel = findVoxel(self, u, v, w, &slice, &sliceX, &sliceY);
+                if (voxel == NULL || (*voxel & 0xFF) == 0){
+                    continue;
+                }
+                
+                *voxel = 0;
+                markDirty(self, slice, sliceX, sliceY);
+                self->numEdits++;
+                carved++;
+            }
+        }
+    }
+    return carved;
+}
+
+Uint32 *findVoxel(EditableStackModel *self, int x, int y, int layer, int *slice, int *u, int *v){
+    //the pixel in the first frame's slice for that layer, NULL if there isn't one
+    StackModel *model = self->model;
+    if (layer < 0 || layer >= model->numLayers || model->layerSlices[layer] < 0){
+        return NULL;
+    }
+    
+    *slice = model->layerSlices[layer];
+    *u = x - model->slices[*slice].offsetX;
+    *v = y - model->slices[*slice].offsetY;
+    SDL_Surface *surface = model->slices[*slice].image->_surface;
+    if (*u < 0 || *v < 0 || *u >= surface->w || *v >= surface->h){
+        return NULL;
+    }
+    return (Uint32 *)((Uint8 *)surface->pixels + ((*v) * surface->pitch)) + (*u);
+}
+
+void markDirty(EditableStackModel *self, int slice, int x, int y){
+    StackSliceEdits *edits = self->edits + slice;
+    ImageRect pixel = {x, y, 1, 1};
+    ImageRect *rect;
+    int i, j;
+    
+    //usually edits come in clumps, so a rect the pixel is in or right next to just grows
+    for (i = 0; i < edits->numDirty; i++){
+        rect = edits->dirty + i;
+        if (x >= rect->x - 1 && x <= rect->x + rect->w && y >= rect->y - 1 && y <= rect->y + rect->h){
+            unionRect(rect, &pixel);
+            return;
+        }
+    }
+    
+    //no room, so merge the two that would add the least area to the upload between them
+    if (edits->numDirty >= STACK_EDIT_MAX_DIRTY_RECTS){
+        int bestI = 0;
+        int bestJ = 1;
+        int bestCost = -1;
+        int cost;
+        ImageRect merged;
+        for (i = 0; i < edits->numDirty; i++){
+            for (j = i + 1; j < edits->numDirty; j++){
+                merged = edits->dirty[i];
+                unionRect(&merged, edits->dirty + j);
+                cost = (merged.w * merged.h) - (edits->dirty[i].w * edits->dirty[i].h) - (edits->dirty[j].w * edits->dirty[j].h);
+                if (bestCost < 0 || cost < bestCost){
+                    bestCost = cost;
+                    bestI = i;
+                    bestJ = j;
+                }
+            }
+        }
+        unionRect(edits->dirty + bestI, edits->dirty + bestJ);
+        edits->dirty[bestJ] = edits->dirty[edits->numDirty - 1];
+        edits->numDirty--;
+    }
+    
+    edits->dirty[edits->numDirty] = pixel;
+    edits->numDirty++;
+}
+
+void unionRect(ImageRect *into, const ImageRect *other){
+    int right = (into->x + into->w > other->x + other->w) ? into->x + into->w : other->x + other->w;
+    int bottom = (into->y + into->h > other->y + other->h) ? into->y + into->h : other->y + other->h;
+    into->x = (into->x < other->x) ? into->x : other->x;
+    into->y = (into->y < other->y) ? into->y : other->y;
+    into->w = right - into->x;
+    into->h = bottom - into->y;
+}
+
+void flushStackModelEdits(EditableStackModel *self){
+    int i, k;
+    StackSliceEdits *edits;
+    self->lastFlushRects = 0;
+    self->lastFlushPixels = 0;
+    for (i = 0; i < self->model->numSlices; i++){
+        edits = self->edits + i;
+        for (k = 0; k < edits->numDirty; k++){
+            self->lastFlushPixels += refreshStackModelSlice(self->model, i, edits->dirty + k);
+            self->lastFlushRects++;
+        }
+        edits->numDirty = 0;
+    }
+    self->numEdits = 0;
+}
+
+void flushWholeSlices(EditableStackModel *self){
+    //what flushing would cost without the dirty rects, every edited slice sent whole
+    int i;
+    ImageRect all;
+    self->lastFlushRects = 0;
+    self->lastFlushPixels = 0;
+    for (i = 0; i < self->model->numSlices; i++){
+        if (self->edits[i].numDirty == 0){
+            continue;
+        }
+        all.x = 0;
+        all.y = 0;
+        all.w = self->model->slices[i].image->width;
+        all.h = self->model->slices[i].image->height;
+        self->lastFlushPixels += refreshStackModelSlice(self->model, i, &all);
+        self->lastFlushRects++;
+        self->edits[i].numDirty = 0;
+    }
+    self->numEdits = 0;
+}
+
+
+/////////////////////////////////////////////////
+// Benchmark
+/////////////////////////////////////////////////
+void benchmarkStackModelEdits(char *filename, int editsPerFrame){
+    /*
+     * Each frame recolors editsPerFrame voxels here and there, then flushes them one way or the other, taking turns
+     * so both see the same sort of edits.  The times are how long it takes to hand the pixels over to SDL, the
+     * driver might still be copying them after that.
+     */
+    startBatchingLoadedImages();
+    StackModel *model = loadEditableStackModel(filename);
+    ImageAtlas *atlas = stopBatchingLoadedImages();
+    EditableStackModel *editable = init_EditableStackModel(malloc(sizeof(EditableStackModel)), model);
+    
+    Uint64 editTicks = 0;
+    Uint64 dirtyTicks = 0;
+    Uint64 wholeTicks = 0;
+    Uint64 start;
+    long dirtyPixels = 0;
+    long wholePixels = 0;
+    long dirtyRects = 0;
+    int frame, i;
+    Uint32 color;
+    for (frame = 0; frame < benchmarkFrames; frame++){
+        color = (frame & 1) ? 0xC08040FF : 0x804020FF;
+        
+        start = SDL_GetPerformanceCounter();
+        for (i = 0; i < editsPerFrame; i++){
+            setStackVoxel(editable, randomNumberLessThan(model->width), randomNumberLessThan(model->height), randomNumberLessThan(model->numLayers), color);
+        }
+        editTicks += SDL_GetPerformanceCounter() - start;
+        
+        start = SDL_GetPerformanceCounter();
+        if (frame & 1){
+            flushWholeSlices(editable);
+            wholeTicks += SDL_GetPerformanceCounter() - start;
+            wholePixels += editable->lastFlushPixels;
+        } else {
+            flushStackModelEdits(editable);
+            dirtyTicks += SDL_GetPerformanceCounter() - start;
+            dirtyPixels += editable->lastFlushPixels;
+            dirtyRects += editable->lastFlushRects;
+        }
+    }
+    
+    int flushes = benchmarkFrames / 2;
+    double microseconds = 1000000.0 / SDL_GetPerformanceFrequency();
+    double editMicroseconds = editTicks * microseconds / benchmarkFrames;
+    double dirtyMicroseconds = dirtyTicks * microseconds / flushes;
+    double wholeMicroseconds = wholeTicks * microseconds / flushes;
+    LOG_INF("Edit benchmark, %s with %d edits a frame: editing %.1f us, dirty rects %.1f us (%ld rects, %ld pixels), whole slices %.1f us (%ld pixels) a frame",
+        filename, editsPerFrame, editMicroseconds, dirtyMicroseconds, dirtyRects / flushes, dirtyPixels / flushes, wholeMicroseconds, wholePixels / flushes
+    );
+    LOG_INF("Edit benchmark, %s: %.0f edits a second flushing dirty rects, %.0f flushing whole slices",
+        filename, editsPerFrame * 1000000.0 / (editMicroseconds + dirtyMicroseconds), editsPerFrame * 1000000.0 / (editMicroseconds + wholeMicroseconds)
+    );
+    
+    free_EditableStackModel(editable);
+    free_StackModel(model);
+    free_ImageAtlas(atlas);
+}
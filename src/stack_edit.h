@@ -0,0 +1,69 @@
+#ifndef STACK_EDIT_H
+#define STACK_EDIT_H
+
+#include "SDL2/SDL.h"
+#include "stack_model.h"
+
+/*
+ * Changing a model's voxels while the game runs, for props that get chipped, carved or knocked apart.
+ *
+ * Every slice already keeps its pixels on the CPU (the software renderer draws from them), so an edit just changes
+ * those and remembers which part of the slice it touched.  Each slice keeps a few dirty rectangles, growing one
+ * when an edit lands next to it and merging the closest two when there are too many.  Once a frame,
+ * flushStackModelEdits sends only those rectangles up to the textures with SDL_UpdateTexture, at wherever the slice
+ * was packed in its atlas page, and redoes the same part of the mips and the coarser levels of detail.  A few
+ * hundred edits a frame then cost about what the pixels they touched cost, rather than a whole slice (or page)
+ * each.  The software renderer sees an edit straight away, flushed or not.
+ *
+ * The model has to come from loadEditableStackModel, so nothing was trimmed away that an edit could uncover, and
+ * every object drawing it changes together.  Put those objects in the world as dynamic objects, since the chunk
+ * layer caches and the raycaster's voxel grid are built once and won't see edits.  Layers that share a slice (slice
+ * spacing, or frames of an animation that didn't change) change together too, and edits go to the first frame.
+ */
+
+#define STACK_EDIT_MAX_DIRTY_RECTS 4 //per slice, past this the two closest are merged
+
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+typedef struct StackSliceEdits{
+    ImageRect dirty[STACK_EDIT_MAX_DIRTY_RECTS]; //in the slice's pixels
+    int numDirty;
+} StackSliceEdits;
+
+typedef struct EditableStackModel{
+    StackModel *model; //not owned
+    StackSliceEdits *edits; //array [full detail slice]
+    int numEdits; //voxels changed since the last flush
+    //what the last flush sent, for keeping an eye on it
+    int lastFlushRects;
+    int lastFlushPixels;
+} EditableStackModel;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+EditableStackModel *init_EditableStackModel(EditableStackModel *self, StackModel *model); //model from loadEditableStackModel
+void free_EditableStackModel(EditableStackModel *self); //leaves the model
+
+
+/////////////////////////////////////////////////
+// Editing
+/////////////////////////////////////////////////
+//x and y from the model's top left, color RGBA8888 with 0 for empty; returns 1 if anything changed, a layer
+//without a slice or a pixel outside its slice can't be changed
+int setStackVoxel(EditableStackModel *self, int x, int y, int layer, Uint32 color);
+int carveStackSphere(EditableStackModel *self, float x, float y, float layer, float radius); //empties a ball of voxels, returns how many
+void flushStackModelEdits(EditableStackModel *self); //once a frame, before drawing
+
+
+/////////////////////////////////////////////////
+// Benchmark
+/////////////////////////////////////////////////
+//loads its own copy of the model and logs how long editsPerFrame small edits take to flush as dirty rects, as
+//whole edited slices, and as the whole model
+void benchmarkStackModelEdits(char *filename, int editsPerFrame);
+
+#endif
@@ -4,22 +4,66 @@
 #include "input.h"
 #include "logging.h"
 #include "constants.h"
+#include "configuration.h"
+#include "texture_cache.h"
+#include "software_renderer.h"
+#include "stack_model.h"
+#include "stack_world.h"
+#include "stack_billboard.h"
+#include "stack_edit.h"
+#include "stack_transform.h"
+#include "stack_raycaster.h"
+#include "vox_loader.h"
+#include "quality_governor.h"
+#include "random.h"
 #include <math.h>
-
-/////////////////////////////////////////////////
-// Structs
-/////////////////////////////////////////////////
-typedef struct{
-    float x;
-    float y;
-} Object;
-
-
+#include <stdlib.h>
 
 /////////////////////////////////////////////////
 // statics
 /////////////////////////////////////////////////
-static void drawObject(Object *obj);
+static void buildRoom();
+static void buildStressScene();
+static void addNpc(float x, float y, int layer);
+static void addAnimatedObject(float x, float y, StackModel *model, Animation *animation);
+static Animation *createLoopingAnimation(int numFrames, int frameMilliseconds);
+static void prepareBillboards(int offsetX, int offsetY);
+static void drawBillboardLayer(int layer, int lift, int software);
+static void drawSlice(const StackSlice *slice, float x, float y, float angle, int software);
+static void drawObject(StackObject *obj);
+static void chooseStackBuffer();
+static void drawStackBuffer();
+static void drawStackBufferSoftware();
+static void drawStackBufferRaycast();
+static int usesSoftwareRender();
+static float currentDrawRotation();
+static int gapFillCopies();
+static float drawPitch();
+static float worldToBufferX(float x);
+static float worldToBufferY(float y);
+static Image *currentFloorImage();
+static int lodLayerCount(int numLayers);
+static void startCulling(float angle, int copies);
+static int isRotatedRectVisible(float x, float y, float width, float height, float centerX, float centerY, float rise);
+static void cullWorld(int offsetX, int offsetY);
+static void rotateObjectAnchors(int offsetX, int offsetY);
+static void compareStackRenderers();
+static int angleBucket(float angle, float step);
+static int rotationCacheAngleBucket(float angle);
+static void prepareRotatedLayers(int angleBucket, float angle, int copies);
+static void releaseRotatedLayers();
+static void drawRotatedLayer(int visibleChunk, int layer, float x, float y, float angle, int centerX, int centerY);
+static void prepareImpostors(float angle, int copies);
+static void findIsolatedObjects();
+static void objectBufferBounds(const StackObject *obj, int anchor, float *left, float *top, float *right, float *bottom);
+static int overlapCellRange(float left, float top, float right, float bottom, int *firstColumn, int *firstRow, int *lastColumn, int *lastRow);
+static void countOverlapCells(float left, float top, float right, float bottom);
+static int isAloneInOverlapCells(float left, float top, float right, float bottom);
+static Image *buildImpostor(const StackObject *obj, float angle, float impostorPitch, int copies);
+static int impostorModelIndex(const StackModel *model);
+static float objectMiddleDepth(const StackObject *obj, int anchor);
+static void drawImpostors();
+static void releaseImpostors();
 
 /*
  * It might make more sense to center the room at 0 and rotate around that
@@ -27,16 +71,196 @@ static void drawObject(Object *obj);
 static const float drawOffset = 16*2;
 static float center;
 
-static Image *wallImage = NULL;
+static StackModel *crateModel = NULL;
+static StackModel *fanModel = NULL;
+static StackModel *barrelModel = NULL;
+static ImageAtlas *modelAtlas = NULL; //every model's slices, packed together
 static Image *floorImage = NULL;
-static Object *objectList = NULL;
-static int numObjects = 26;
-static const int numLayers = 10;
+static ImageQuad *floorQuads = NULL; //the floor's solid parts, NULL to draw all of it, see meshStackModelSlices
+static int numFloorQuads = 0;
+static const int maxFloorQuads = 64;
 static float rotation = 0;
 
 static float pitch = 1;
 
-static Image *bufferImage = NULL;
+/*
+ * Every object lives in the world, which hands us the chunks near the camera and keeps a layer cache per chunk.
+ * The camera is the world position that ends up at (center, center) in the buffer, which is what everything
+ * rotates about, so with the camera at center the room is drawn exactly where it always was.
+ */
+static StackWorld *world = NULL;
+static float cameraX;
+static float cameraY;
+static const float cameraSpeed = 2;
+static const int chunkLayerFramesUnused = 120; //chunks off screen this long give their layer cache back
+static const int stressSceneTiles = 400; //square, and about two thirds full, so a bit over 100k crates
+static const int stressSceneSeed = 1;
+
+/*
+ * The layer images already rotated, for when the camera keeps landing on the same angles.  Keyed by (chunk, chunk
+ * version, level of detail, layer, angle bucket, bufferScale, copies, zoom level).  Each frame the images for the current angle are looked up (or
+ * built) for every visible chunk before drawing starts, since building one means switching render targets.
+ *
+ * When extruding, the gap filling copies are baked in too: the rotated layer is drawn once per copy, a pixel higher
+ * each time, into an image that many pixels taller.  Then a pitched layer is one draw however many copies it needs.
+ */
+static TextureCache *rotationCache = NULL;
+static Image **rotatedLayers = NULL; //array [visible chunk * world layers + layer], this frame's images
+static int *rotatedLayerIsOwned = NULL; //same layout, 1 if the image didn't fit in the cache and must be freed after drawing
+static int rotatedLayerCapacity = 0;
+static int numRotatedLayers = 0;
+static int framesSinceCacheReport = 0;
+static const int framesPerCacheReport = 300;
+
+//when comparing renderers, how far apart a channel can be before the pixel counts as different
+static const int rendererComparisonTolerance = 8;
+static int renderersCompared = 0;
+static int framesSinceBandReport = 0;
+
+/*
+ * Only part of the buffer makes it to the screen (see the view rect in drawStackFrame), so anything whose rotated
+ * bounds miss that window is skipped before it gets anywhere near SDL.  The window is turned back into a world
+ * rect to ask the world which chunks could be in it, so the cost doesn't grow with the world.  Then chunks and
+ * the objects in them are tested with the bounds of their whole stack, and layers are tested one at a time.
+ */
+static float visibleLeft, visibleTop, visibleRight, visibleBottom; //in buffer coordinates before scaling
+static float cullAngle, cullCos, cullSin;
+static int cullCopies;
+static StackChunk **visibleChunks = NULL; //array, filled by cullWorld
+static int *visibleChunkFirstObject = NULL; //array [visible chunk], where its objects start in objectIsVisible
+static int *chunkLayerIsVisible = NULL; //array [visible chunk], for the layer being drawn
+static int visibleChunkCapacity = 0;
+static int numVisibleChunks = 0;
+static int *objectIsVisible = NULL; //array, filled by cullWorld
+static int objectIsVisibleCapacity = 0;
+static int numVisibleObjects = 0;
+static int numTestedObjects = 0;
+
+static int numCulledLayers = 0;
+static int framesSinceCullReport = 0;
+
+/*
+ * Everything rotates about the same point by the same angle, so instead of every draw being handed the angle and
+ * pivot and doing the rotation itself, the objects' top left corners are rotated all together once a frame (see
+ * stack_transform.h).  Going up a layer or a copy only moves a draw straight up the buffer after rotating, and a
+ * slice's offset just needs rotating by cullCos and cullSin, so each draw is a couple of multiplies from its anchor.
+ */
+static StackAnchors *objectAnchors = NULL; //same layout as objectIsVisible, each object's layer 0 top left
+static StackAnchors *billboardAnchors = NULL; //[billboard], where each one's feet are
+static const int transformBenchmarkObjects = 10000;
+
+/*
+ * Scenes can be raycast from a voxel grid instead of drawn as stacks (see stack_raycaster.h), which wins once
+ * there are enough objects crammed into the view.  The grid is only built if the world is small enough for it, so
+ * each scene ends up with whichever the budget allows.
+ */
+static StackVoxelGrid *voxelGrid = NULL;
+static Uint64 raycastTicks = 0;
+static int framesSinceRaycastReport = 0;
+
+/*
+ * A dynamic object with nothing else drawn over or under any part of it doesn't need its layers interleaved with
+ * everyone else's, so it can be drawn whole, every layer and gap filling copy, into an impostor image for its model,
+ * animation frame and view (the angle and pitch snapped to the configured steps), and that's drawn as one quad.
+ * Whether an object is on its own is worked out with a coarse grid over the visible window, counting how many
+ * objects' and billboards' buffer bounds touch each cell, so walls, clusters and anything a person walks past keep
+ * drawing a layer at a time.  Impostors are drawn back to front after the layers.
+ *
+ * The impostors live in their own cache, like the rotated layers, keyed by model (and its edit version), frame,
+ * view, level of detail, buffer scale, copies and zoom.  Only so many are built a frame so turning the camera
+ * doesn't stall, the rest are drawn a layer at a time until their turn.  Only the SDL renderer uses them.
+ */
+static TextureCache *impostorCache = NULL;
+static Image **objectImpostors = NULL; //same layout as objectIsVisible, NULL for objects drawn a layer at a time
+static int *objectImpostorIsOwned = NULL; //same, 1 if the image didn't fit in the cache and must be freed after drawing
+static char *objectIsAlone = NULL; //same, 1 for dynamic objects that don't overlap anything
+static int objectImpostorCapacity = 0;
+static int *impostorAnchors = NULL; //array, this frame's impostors back to front
+static const StackObject **impostorObjects = NULL; //same
+static int impostorOrderCapacity = 0;
+static int numImpostors = 0;
+static const StackModel **impostorModels = NULL; //array, so a key can say which model with an int
+static int numImpostorModels = 0;
+static Uint8 *overlapCells = NULL; //array [row * overlapCellsWide + column], bounds touching each cell, stopping at 2
+static int overlapCellCapacity = 0;
+static int overlapCellsWide = 0;
+static int overlapCellsHigh = 0;
+static const int overlapCellSize = 8; //buffer pixels
+static int impostorsBuiltThisFrame = 0;
+//counted since the last report
+static long impostorCandidates = 0;
+static long impostorsIsolated = 0;
+static long impostorsDrawn = 0;
+static int impostorsBuilt = 0;
+static int mostImpostorsBuilt = 0;
+static int framesSinceImpostorReport = 0;
+
+/*
+ * The level of detail everything is drawn at, picked each frame from how far apart layers land in the buffer.
+ * Objects all share the same scale, so one level suits every object on screen and the chunk layer caches can be
+ * built at that level too.  A layer at level n covers getStackLodLayersPerSlice(n) full detail layers.
+ */
+static int drawLod = 0;
+
+/*
+ * Zooming out draws everything a half or a quarter of the size, from the slices' mips (see stack_model.h), so each
+ * slice is drawn one to one instead of being squeezed into a smaller area.  The zoom only goes in mip levels, so
+ * there's never a level in between to blend.  Positions, the pitch and the chunk layer caches are all scaled
+ * about the camera, and the floor and billboards have their own mips.  Hold Y and use up and down to zoom.
+ */
+static int zoomLevel = 0;
+static float zoom = 1; //buffer pixels per world pixel, 1 / 2^zoomLevel
+static int zoomHeld = 0; //so holding the buttons only zooms once
+static Image *floorMips[STACK_SLICE_MIP_LEVELS - 1] = {NULL};
+static Image *npcMips[STACK_SLICE_MIP_LEVELS - 1] = {NULL};
+
+/*
+ * Billboards stand among the stacks and are drawn a strip per layer, see stack_billboard.h.  Each NPC has its own
+ * copy of the walk animation so they aren't all in step.
+ */
+static Sprite *npcSprite = NULL;
+static Animation *npcWalk = NULL;
+static StackBillboardList *billboards = NULL;
+static int maxBillboardSpan = 1; //the most layers any billboard drawn this frame covers
+static const int npcFrameMilliseconds = 250;
+static const int stressSceneBillboards = 5000;
+
+/*
+ * Animated models, like the fan in the middle of the room, are dynamic objects with an animation each (see
+ * stack_model.h).  The world doesn't update them, so their animations are kept here to step each frame.
+ */
+static Animation *fanSpin = NULL;
+static const int fanFrameMilliseconds = 60;
+static Animation **objectAnimations = NULL; //array
+static int numObjectAnimations = 0;
+static int objectAnimationCapacity = 0;
+
+/*
+ * One crate in the room can be knocked apart, hold select to take chunks out of it.  It has its own editable copy
+ * of the crate model (see stack_edit.h), so the rest stay whole, and it's dynamic so the chunk caches don't keep
+ * an old copy of it.  Edits are flushed to the atlas once a frame, before drawing.
+ */
+static StackModel *brokenCrateModel = NULL;
+static EditableStackModel *brokenCrate = NULL;
+static const float brokenCrateChunkRadius = 2.5f;
+static const int editBenchmarkEdits = 256;
+
+/*
+ * Only the bottom pitch screens of the buffer ever make it to the screen (see the view rect in drawStackFrame), so
+ * rather than clearing and filling all three screens every frame, the buffer is only as tall as the current pitch
+ * needs, rounded up to a step.  Each step has its own render target, made the first time the pitch needs it and
+ * freed once the pitch has stayed away from it for a while, so going back and forth doesn't keep reallocating.
+ * Everything is still placed as if the buffer were full size, bufferTop is the full size row the buffer starts at.
+ */
+#define STACK_BUFFER_STEPS 6 //half a screen each
+static Image *bufferPool[STACK_BUFFER_STEPS] = {NULL};
+static unsigned bufferPoolLastUsed[STACK_BUFFER_STEPS] = {0};
+static unsigned bufferPoolFrame = 0;
+static const int bufferPoolFramesUnused = 300;
+static int bufferStep = -1;
+static int bufferTop = 0;
+
+static Image *bufferImage = NULL; //the pool's target for this frame
 /*
  * change this to change how the buffer is scaled - smaller means that we hide the stacking artifacts but everything is pixelated
  * should be between 1 and RENDER_SCALE_MULTIPLE, 2 seems to give a good balance for quality but still hiding artifacts
@@ -46,37 +270,223 @@ static Image *bufferImage = NULL;
  * some scaling with the screen idk). I notice that some details are lost in the buffer (fine) BUT when you pitch the camera, since
  * its just stretching an image, the details don't change, and that doesn't quite look right?
  * (maybe try the buffer having some interpolation?)
+ *
+ * The quality governor picks it now (see quality_governor.h), from the configured bounds, and it can change from
+ * frame to frame.  The buffer pool is made at one scale, so it's thrown out and remade when the scale changes.
  */
-static const int bufferScale = 1;
+static int bufferScale = 1;
+static int bufferPoolScale = 0;
 
 
 void initStackFrame(){
-    wallImage = loadImageFromFile("gfx/crate_top.png");
-    floorImage = loadImageFromFile("gfx/floor.png");
+    int i;
+    //keep the pixels around in case we're rasterizing on the CPU
+    floorImage = loadImageFromFileKeepPixels("gfx/floor.png");
+    for (i = 0; i < STACK_SLICE_MIP_LEVELS - 1; i++){
+        floorMips[i] = createHalfSizeImage((i == 0) ? floorImage : floorMips[i - 1], 0, 0);
+    }
+    if (STACK_MESH_SLICES){
+        floorQuads = traceImageQuads(floorImage, NULL, 0, maxFloorQuads, &numFloorQuads);
+        //a solid floor comes back as one quad the size of the image, no better than drawing it
+        if (floorQuads != NULL && imageQuadsArea(floorQuads, numFloorQuads) >= floorImage->width * floorImage->height){
+            free(floorQuads);
+            floorQuads = NULL;
+            numFloorQuads = 0;
+        }
+        LOG_INF("Meshed the floor into %d quads: %.0f of %d pixels rasterized", numFloorQuads,
+            (floorQuads != NULL) ? imageQuadsArea(floorQuads, numFloorQuads) : (float)(floorImage->width * floorImage->height), floorImage->width * floorImage->height
+        );
+    }
+    
+    //models go into the same atlas pages so their slices can be batched together
+    startBatchingLoadedImages();
+    crateModel = loadStackModel("data/models/crate.model");
+    fanModel = loadStackModel("data/models/fan.model");
+    barrelModel = loadStackModel("data/models/barrel.vox");
+    brokenCrateModel = loadEditableStackModel("data/models/crate.model");
+    npcSprite = init_Sprite(malloc(sizeof(Sprite)));
+    npcSprite->image = loadImageFromFileKeepPixels("gfx/npc_sheet.png");
+    for (i = 0; i < STACK_SLICE_MIP_LEVELS - 1; i++){
+        npcMips[i] = createHalfSizeImage((i == 0) ? npcSprite->image : npcMips[i - 1], 0, 0);
+    }
+    modelAtlas = stopBatchingLoadedImages();
+    npcSprite->frameWidth = 8;
+    npcSprite->frameHeight = 16;
+    npcSprite->numFramesPerRow = 2;
+    
+    //two frames of walking, and every frame of the fan's spin, forever
+    npcWalk = createLoopingAnimation(2, npcFrameMilliseconds);
+    fanSpin = createLoopingAnimation(getStackModelFrameCount(fanModel), fanFrameMilliseconds);
+    billboards = init_StackBillboardList(malloc(sizeof(StackBillboardList)));
+    objectAnchors = init_StackAnchors(malloc(sizeof(StackAnchors)));
+    billboardAnchors = init_StackAnchors(malloc(sizeof(StackAnchors)));
+    if (DEBUG_BENCHMARK_STACK_TRANSFORMS){
+        benchmarkStackTransforms(transformBenchmarkObjects);
+    }
+    brokenCrate = init_EditableStackModel(malloc(sizeof(EditableStackModel)), brokenCrateModel);
+    if (DEBUG_BENCHMARK_STACK_EDITS){
+        benchmarkStackModelEdits("data/models/crate.model", editBenchmarkEdits);
+    }
+    if (DEBUG_CHECK_VOX_CACHE){
+        checkVoxStackModelCache("data/models/barrel.vox");
+    }
     
-    //16x16 objects forming a 7x7 perimeter
     center = drawOffset + 3*16 + 8;
-    objectList = malloc(sizeof(Object) * numObjects);
+    cameraX = center;
+    cameraY = center;
+    if (DEBUG_STACK_STRESS_SCENE){
+        buildStressScene();
+    } else {
+        buildRoom();
+    }
+    
+    if (STACK_USE_RAYCASTER){
+        voxelGrid = buildStackVoxelGrid(world, STACK_RAYCASTER_BUDGET_KB);
+    }
+    if (STACK_USE_ROTATION_CACHE){
+        rotationCache = init_TextureCache(malloc(sizeof(TextureCache)), STACK_ROTATION_CACHE_BUDGET_KB * 1024);
+    }
+    if (STACK_USE_IMPOSTORS){
+        impostorCache = init_TextureCache(malloc(sizeof(TextureCache)), STACK_IMPOSTOR_BUDGET_KB * 1024);
+    }
+    
+    // the buffer we draw to before stretching to the screen, normal width but up to triple height
+    bufferScale = getQualityLevels()->bufferScale;
+    chooseStackBuffer();
+    if (usesSoftwareRender()){
+        initSoftwareRenderer(bufferImage->width, bufferImage->height, STACK_SOFTWARE_RENDERER_THREADS);
+        setSoftwareFrontToBack(STACK_SOFTWARE_FRONT_TO_BACK);
+    }
+    if (DEBUG_BENCHMARK_STACK_SPANS){
+        benchmarkStackModelSpans("data/models/crate.model");
+    }
+}
+
+void buildRoom(){
+    //16x16 objects forming a 7x7 perimeter, all in the one chunk
+    world = init_StackWorld(malloc(sizeof(StackWorld)), STACK_CHUNK_TILES, STACK_CHUNK_TILES, 16);
     int i;
+    float x[26];
+    float y[26];
     for (i = 0; i < 7; i++){
-        objectList[i].x = i * 16 + drawOffset;
-        objectList[i].y = 0 + drawOffset;
+        x[i] = i * 16 + drawOffset;
+        y[i] = 0 + drawOffset;
     }
     for (i = 7; i < 13; i++){
-        objectList[i].x = 0 + drawOffset;
-        objectList[i].y = (i-7) * 16 + drawOffset;
+        x[i] = 0 + drawOffset;
+        y[i] = (i-7) * 16 + drawOffset;
     }
     for (i = 13; i < 19; i++){
-        objectList[i].x = 16*6 + drawOffset;
-        objectList[i].y = (i-13) * 16 + drawOffset;
+        x[i] = 16*6 + drawOffset;
+        y[i] = (i-13) * 16 + drawOffset;
     }
     for (i = 19; i < 26; i++){
-        objectList[i].x = (i-19) * 16 + drawOffset;
-        objectList[i].y = 16*6 + drawOffset;
+        x[i] = (i-19) * 16 + drawOffset;
+        y[i] = 16*6 + drawOffset;
+    }
+    for (i = 0; i < 26; i++){
+        //positions above are top left corners, and objects are placed by their pivot
+        addStackObject(world, x[i] + crateModel->pivotX, y[i] + crateModel->pivotY, crateModel, 1);
+    }
+    
+    //a few people inside, and one standing on a crate
+    addNpc(center - 20, center + 4, 0);
+    addNpc(center + 14, center + 20, 0);
+    addNpc(center + 2, center - 22, 0);
+    addNpc(drawOffset + 16*3 + 8, drawOffset + 12, getStackModelLayerCount(crateModel));
+    
+    //and something that moves, and something that breaks
+    addAnimatedObject(center, center + 24, fanModel, fanSpin);
+    addStackObject(world, center + 24, center - 16, brokenCrateModel, 0);
+    
+    //a couple of barrels from a .vox, in the corners
+    addStackObject(world, drawOffset + 16 + 8, drawOffset + 16 + 8, barrelModel, 1);
+    addStackObject(world, drawOffset + 16*5 + 8, drawOffset + 16*5 + 8, barrelModel, 1);
+}
+
+void buildStressScene(){
+    /*
+     * A huge field of crates, to check that a frame costs about the same however many objects there are.  Hold X
+     * and use the arrow keys to move around it.  A few are dynamic so the per object path gets exercised too.
+     * Each chunk's rotated layers are a few MB, so give the rotation cache 32768 KB or so when running this.
+     */
+    world = init_StackWorld(malloc(sizeof(StackWorld)), stressSceneTiles, stressSceneTiles, 16);
+    seedPRNG(stressSceneSeed);
+    char *hasCrate = malloc(stressSceneTiles * stressSceneTiles);
+    int x, y, i;
+    for (y = 0; y < stressSceneTiles; y++){
+        for (x = 0; x < stressSceneTiles; x++){
+            hasCrate[(y * stressSceneTiles) + x] = randomNumberLessThan(3) != 0;
+            if (!hasCrate[(y * stressSceneTiles) + x]){
+                continue;
+            }
+            addStackObject(world, (x * 16) + crateModel->pivotX, (y * 16) + crateModel->pivotY, crateModel, randomNumberLessThan(50) != 0);
+        }
+    }
+    
+    //people in the gaps, or on top of the crates, crowded around the middle where the camera starts
+    int spread = stressSceneTiles / 8;
+    for (i = 0; i < stressSceneBillboards; i++){
+        x = (stressSceneTiles / 2) - spread + randomNumberLessThan(spread * 2);
+        y = (stressSceneTiles / 2) - spread + randomNumberLessThan(spread * 2);
+        addNpc((x * 16) + 4 + randomNumberLessThan(8), (y * 16) + 4 + randomNumberLessThan(8),
+            hasCrate[(y * stressSceneTiles) + x] ? getStackModelLayerCount(crateModel) : 0
+        );
+    }
+    free(hasCrate);
+    
+    cameraX = stressSceneTiles * 16 / 2;
+    cameraY = stressSceneTiles * 16 / 2;
+    LOG_INF("Stress scene: %d objects in %dx%d chunks of %d tiles, %d billboards",
+        world->numObjects, world->chunksWide, world->chunksHigh, STACK_CHUNK_TILES, billboards->numBillboards
+    );
+}
+
+void addNpc(float x, float y, int layer){
+    Animation *walk = shallowCopyAnimation(npcWalk);
+    updateAnimation(walk, randomNumberLessThan(npcFrameMilliseconds * 2));
+    StackBillboard *billboard = addStackBillboard(billboards, npcSprite, walk, x, y, layer);
+    billboard->mips = npcMips;
+}
+
+void addAnimatedObject(float x, float y, StackModel *model, Animation *animation){
+    //its own copy of the animation, started somewhere random like the NPCs' walks
+    StackObject *obj = addStackObject(world, x, y, model, 0);
+    if (obj == NULL){
+        return;
+    }
+    obj->animation = shallowCopyAnimation(animation);
+    updateAnimation(obj->animation, randomNumberLessThan(animation->loopEndTime[0]));
+    
+    if (numObjectAnimations >= objectAnimationCapacity){
+        objectAnimationCapacity = (objectAnimationCapacity == 0) ? 16 : objectAnimationCapacity * 2;
+        objectAnimations = realloc(objectAnimations, sizeof(Animation *) * objectAnimationCapacity);
+    }
+    objectAnimations[numObjectAnimations] = obj->animation;
+    numObjectAnimations++;
+}
+
+Animation *createLoopingAnimation(int numFrames, int frameMilliseconds){
+    //one loop through the first numFrames sprite indices, repeating
+    int i;
+    Animation *result = init_Animation(malloc(sizeof(Animation)));
+    result->numLoops = 1;
+    result->loopLength = malloc(sizeof(int));
+    result->loopLength[0] = numFrames;
+    result->frameStartTime = malloc(sizeof(int *));
+    result->frameStartTime[0] = malloc(sizeof(int) * numFrames);
+    result->spriteIndices = malloc(sizeof(int *));
+    result->spriteIndices[0] = malloc(sizeof(int) * numFrames);
+    for (i = 0; i < numFrames; i++){
+        result->frameStartTime[0][i] = i * frameMilliseconds;
+        result->spriteIndices[0][i] = i;
     }
+    result->loopEndTime = malloc(sizeof(int));
+    result->loopEndTime[0] = numFrames * frameMilliseconds;
+    result->repeatLoop = malloc(sizeof(int));
+    result->repeatLoop[0] = 1;
     
-    // the buffer we draw to before stretching to the screen, normal width but triple height
-    bufferImage = createEmptyImage(SCREEN_WIDTH * bufferScale, SCREEN_HEIGHT * bufferScale * 3);
+    return result;
 }
 
 
@@ -85,21 +495,53 @@ void initStackFrame(){
 // Logic
 /////////////////////////////////////////////////
 void doStackFrame(int delta){
-    if (checkInput(LEFT_BUTTON)){
-        rotation -= 2;
-    } else if (checkInput(RIGHT_BUTTON)){
-        rotation += 2;
-    }
-    
-    //actually, this is not pitch but SCALING
-    //the pitch should change linearly, as it is an angle, and the SCALING should change based on the trig for that, non-linearly
-    //if constrained to a small interval it may not be noticeable
-    if (checkInput(UP_BUTTON)){
-        pitch += .1;
-        printf("%f\n", pitch);
-    } else if (checkInput(DOWN_BUTTON)){
-        pitch -= .1;
-        printf("%f\n", pitch);
+    //holding Y zooms in and out a mip level at a time
+    float screenX = 0;
+    float screenY = 0;
+    if (checkInput(Y_BUTTON)){
+        if (!zoomHeld && checkInput(UP_BUTTON) && zoomLevel > 0){
+            zoomLevel--;
+            LOG_DEB("Stack zoom level %d", zoomLevel);
+        } else if (!zoomHeld && checkInput(DOWN_BUTTON) && zoomLevel < STACK_SLICE_MIP_LEVELS - 1){
+            zoomLevel++;
+            LOG_DEB("Stack zoom level %d", zoomLevel);
+        }
+        zoomHeld = checkInput(UP_BUTTON) || checkInput(DOWN_BUTTON);
+        zoom = 1.0f / (1 << zoomLevel);
+    } else if (checkInput(X_BUTTON)){
+        //holding X moves the camera around the world, in the direction the arrows point on screen
+        if (checkInput(LEFT_BUTTON)){
+            screenX = -cameraSpeed;
+        } else if (checkInput(RIGHT_BUTTON)){
+            screenX = cameraSpeed;
+        }
+        if (checkInput(UP_BUTTON)){
+            screenY = -cameraSpeed;
+        } else if (checkInput(DOWN_BUTTON)){
+            screenY = cameraSpeed;
+        }
+        
+        //undo the view's rotation, and the zoom so it moves at the same speed on screen
+        float radians = rotation * (M_PI / 180.0);
+        cameraX += ((cosf(radians) * screenX) + (sinf(radians) * screenY)) / zoom;
+        cameraY += ((-sinf(radians) * screenX) + (cosf(radians) * screenY)) / zoom;
+    } else {
+        if (checkInput(LEFT_BUTTON)){
+            rotation -= 2;
+        } else if (checkInput(RIGHT_BUTTON)){
+            rotation += 2;
+        }
+        
+        //actually, this is not pitch but SCALING
+        //the pitch should change linearly, as it is an angle, and the SCALING should change based on the trig for that, non-linearly
+        //if constrained to a small interval it may not be noticeable
+        if (checkInput(UP_BUTTON)){
+            pitch += .1;
+            printf("%f\n", pitch);
+        } else if (checkInput(DOWN_BUTTON)){
+            pitch -= .1;
+            printf("%f\n", pitch);
+        }
     }
     
     //lock to some range
@@ -110,6 +552,35 @@ void doStackFrame(int delta){
         pitch = 3;
     }
     
+    int i;
+    for (i = 0; i < billboards->numBillboards; i++){
+        if (billboards->billboards[i].animation != NULL){
+            updateAnimation(billboards->billboards[i].animation, delta);
+        }
+    }
+    for (i = 0; i < numObjectAnimations; i++){
+        updateAnimation(objectAnimations[i], delta);
+    }
+    
+    //a chunk out of the breakable crate every frame select is held, anywhere in it
+    if (checkInput(SELECT_BUTTON)){
+        carveStackSphere(brokenCrate,
+            randomNumberLessThan(brokenCrateModel->width), randomNumberLessThan(brokenCrateModel->height),
+            randomNumberLessThan(getStackModelLayerCount(brokenCrateModel)), brokenCrateChunkRadius
+        );
+    }
+    
+    //the governor can push the level of detail coarser, if it's on at all
+    int lod = chooseStackModelLod(drawPitch() * bufferScale);
+    if (STACK_USE_LOD){
+        lod += getQualityLevels()->lodBias;
+        lod = (lod >= STACK_MODEL_LOD_LEVELS) ? STACK_MODEL_LOD_LEVELS - 1 : lod;
+    }
+    if (lod != drawLod){
+        LOG_DEB("Stack level of detail %d -> %d", drawLod, lod);
+        drawLod = lod;
+    }
+    
     float xScale;
     float yScale;
     SDL_Rect view;
@@ -141,10 +612,106 @@ void doStackFrame(int delta){
 // Drawing
 /////////////////////////////////////////////////
 void drawStackFrame(int excessTime){
+    if (DEBUG_COMPARE_STACK_RENDERERS && !renderersCompared){
+        compareStackRenderers();
+        renderersCompared = 1;
+    }
+    
+    bufferScale = getQualityLevels()->bufferScale;
+    chooseStackBuffer();
+    startStackWorldFrame(world);
+    flushStackModelEdits(brokenCrate);
+    
+    //fill the buffer with one renderer or another
+    if (voxelGrid != NULL){
+        drawStackBufferRaycast();
+    } else if (STACK_USE_SOFTWARE_RENDERER){
+        drawStackBufferSoftware();
+    } else {
+        drawStackBuffer();
+    }
+    
+    SDL_Rect view;
+    SDL_Rect dest;
+    
+    view.x = 0;
+    view.y = ((SCREEN_HEIGHT * (3 - pitch)) - bufferTop) * bufferScale;
+    view.w = SCREEN_WIDTH * bufferScale;
+    view.h = SCREEN_HEIGHT * pitch * bufferScale;
+    
+    dest.x = 0;
+    dest.y = (((1/pitch) - 1)* center) * RENDER_SCALE_MULTIPLE; //re-centers the image - WARNING: has problems when pitch is < 1, due to only drawing part of the buffer; probably need to clamp 1/pitch or something
+    dest.w = WINDOW_WIDTH;
+    dest.h = WINDOW_HEIGHT;
+    
+    SDL_RenderCopy(renderer, bufferImage->_texture, &view, &dest);
+}
+
+void chooseStackBuffer(){
+    //enough steps to cover pitch screens, or all of them
+    int step = STACK_BUFFER_STEPS - 1;
+    if (STACK_FIT_BUFFER_TO_PITCH){
+        step = ceilf(pitch * STACK_BUFFER_STEPS / 3) - 1;
+        step = (step < 0) ? 0 : step;
+        step = (step >= STACK_BUFFER_STEPS) ? STACK_BUFFER_STEPS - 1 : step;
+    }
+    
+    //the whole pool is at the old scale
+    int i;
+    if (bufferScale != bufferPoolScale){
+        if (bufferPoolScale != 0){
+            LOG_DEB("Stack buffer scale %d -> %d", bufferPoolScale, bufferScale);
+        }
+        for (i = 0; i < STACK_BUFFER_STEPS; i++){
+            if (bufferPool[i] != NULL){
+                free_Image(bufferPool[i]);
+                bufferPool[i] = NULL;
+            }
+        }
+        bufferPoolScale = bufferScale;
+        bufferImage = NULL;
+    }
+    
+    bufferPoolFrame++;
+    if (bufferPool[step] == NULL){
+        int height = ((SCREEN_HEIGHT * 3 * (step + 1)) + STACK_BUFFER_STEPS - 1) / STACK_BUFFER_STEPS;
+        bufferPool[step] = createEmptyImage(SCREEN_WIDTH * bufferScale, height * bufferScale);
+        LOG_DEB("Created %dx%d stack buffer for pitches up to %.1f", bufferPool[step]->width, bufferPool[step]->height, 3.0 * (step + 1) / STACK_BUFFER_STEPS);
+    }
+    bufferPoolLastUsed[step] = bufferPoolFrame;
+    
+    if (step != bufferStep || bufferImage == NULL){
+        //the software render has to match, unless it isn't made yet
+        if (bufferStep >= 0 && usesSoftwareRender()){
+            resizeSoftwareRender(bufferPool[step]->width, bufferPool[step]->height);
+        }
+        bufferStep = step;
+        bufferImage = bufferPool[step];
+        bufferTop = (SCREEN_HEIGHT * 3) - (bufferImage->height / bufferScale);
+    }
+    
+    //and give back the ones the pitch has moved away from
+    for (i = 0; i < STACK_BUFFER_STEPS; i++){
+        if (i != step && bufferPool[i] != NULL && bufferPoolFrame - bufferPoolLastUsed[i] > (unsigned)bufferPoolFramesUnused){
+            LOG_DEB("Freeing %dx%d stack buffer", bufferPool[i]->width, bufferPool[i]->height);
+            free_Image(bufferPool[i]);
+            bufferPool[i] = NULL;
+        }
+    }
+}
+
+void drawStackBuffer(){
     int i;
     int j;
     int k;
-    Object obj;
+    int v;
+    int anchor;
+    StackChunk *chunk;
+    const StackObject *obj;
+    const StackSlice *slice;
+    Image **layerImages;
+    float left, top;
+    float x, y;
     
     /*
      * Drawing one object at a time requires computing depth to the camera per-object 
@@ -154,15 +721,49 @@ void drawStackFrame(int excessTime){
     //}
     
     int offsetX = 0;
-    int offsetY = SCREEN_HEIGHT * (3-1);
+    int offsetY = SCREEN_HEIGHT * (3-1) - bufferTop;
+    
+    //only the chunks that made it through culling get their layer caches built, and rotated if using the cache
+    float drawRotation = currentDrawRotation();
+    int copies = gapFillCopies();
+    int extrude = STACK_EXTRUDE_SLICES && rotationCache != NULL;
+    startCulling(drawRotation, copies);
+    cullWorld(offsetX, offsetY);
+    rotateObjectAnchors(offsetX, offsetY);
+    prepareBillboards(offsetX, offsetY);
+    prepareImpostors(drawRotation, copies);
+    for (v = 0; v < numVisibleChunks; v++){
+        if (visibleChunks[v]->numStatic > 0){
+            getChunkLayerImages(world, visibleChunks[v], drawLod, zoomLevel);
+        }
+    }
+    if (rotationCache != NULL){
+        prepareRotatedLayers(rotationCacheAngleBucket(rotation), drawRotation, extrude ? copies : 1);
+    }
     
     //change the target to be our buffer, clear the buffer
     SDL_SetRenderTarget(renderer, bufferImage->_texture);
     SDL_RenderClear(renderer);
     setDrawScaling(bufferScale); //scale up to match the buffer resolution
     
+    //every rotated draw below is queued and sent to the renderer as geometry, one submission per texture change
+    startBatchingGeometry();
+    
     //floor is not layered
-    drawImageRotate(floorImage, 0 + drawOffset + offsetX, 0 + drawOffset + offsetY, rotation, center - (0 + drawOffset), center - (0 + drawOffset));
+    left = worldToBufferX(drawOffset);
+    top = worldToBufferY(drawOffset);
+    if (floorQuads != NULL && zoomLevel == 0){
+        //where drawImageRotate would put the top left corner, with its truncating
+        int destX = left + offsetX;
+        int destY = top + offsetY;
+        int pivotX = center - left;
+        int pivotY = center - top;
+        drawImageQuadsPreRotated(floorImage, floorQuads, numFloorQuads,
+            destX + pivotX - (cullCos * pivotX) + (cullSin * pivotY), destY + pivotY - (cullSin * pivotX) - (cullCos * pivotY), drawRotation
+        );
+    } else {
+        drawImageRotate(currentFloorImage(), left + offsetX, top + offsetY, drawRotation, center - left, center - top);
+    }
     
     
     /*
@@ -170,47 +771,1102 @@ void drawStackFrame(int excessTime){
      * For billboarded sprites, just draw them repeatedly at each layer - sure you get overdraw, but it should work? As long as you draw back to front with the things in the layer I guess?
      * So I suppose it requires some 2d depth sorting, but it still avoids cycle problems with various depth algorithms
      */
-    for (i = 0; i < numLayers; i++){
+    float layerPitch = getStackLodLayersPerSlice(drawLod) * drawPitch();
+    for (i = 0; i < lodLayerCount(world->numLayers); i++){
+        for (v = 0; v < numVisibleChunks; v++){
+            chunk = visibleChunks[v];
+            chunkLayerIsVisible[v] = 0;
+            if (chunk->numStatic == 0 || i >= lodLayerCount(chunk->numLayers)){
+                continue;
+            }
+            
+            layerImages = chunk->layerImages[drawLod][zoomLevel];
+            left = worldToBufferX(chunk->layerOriginX);
+            top = worldToBufferY(chunk->layerOriginY);
+            chunkLayerIsVisible[v] = isRotatedRectVisible(left + offsetX, top - (i * layerPitch) + offsetY, layerImages[i]->width, layerImages[i]->height, center - left, center - top, copies - 1);
+            numCulledLayers += !chunkLayerIsVisible[v];
             
+            //with extrusion the static layer's copies are already in its rotated image, so it's drawn once
+            if (extrude && chunkLayerIsVisible[v]){
+                drawRotatedLayer(v, i, left + offsetX, top - (i * layerPitch) + offsetY, drawRotation, center - left, center - top);
+            }
+        }
+        
         //adds extra copies of the image to hide the gaps, although my theory is that if rendering at a low resolution, the gaps won't be visibile anyway
         //some rounding error here, probably because our draw methods don't take floats and you get some inconsistencies with draw positions
-        for (j = 0; j < pitch; j++){
-            for (k = 0; k < numObjects; k++){
-                obj = objectList[k];
-                drawImageRotate(wallImage, obj.x + offsetX, obj.y - (i * pitch) - j + offsetY, rotation, center - obj.x, center - obj.y);
+        for (j = 0; j < copies; j++){
+            for (v = 0; v < numVisibleChunks; v++){
+                chunk = visibleChunks[v];
+                
+                //all the chunk's static objects at once
+                if (!extrude && chunkLayerIsVisible[v]){
+                    left = worldToBufferX(chunk->layerOriginX);
+                    top = worldToBufferY(chunk->layerOriginY);
+                    drawRotatedLayer(v, i, left + offsetX, top - (i * layerPitch) - j + offsetY, drawRotation, center - left, center - top);
+                }
+                
+                if (chunk->numStatic == chunk->numObjects){
+                    continue;
+                }
+                for (k = 0; k < chunk->numObjects; k++){
+                    obj = chunk->objects + k;
+                    slice = getStackModelFrameSliceForLayer(obj->model, getStackObjectFrame(obj), drawLod, i);
+                    anchor = visibleChunkFirstObject[v] + k;
+                    if (obj->isStatic || !objectIsVisible[anchor] || objectImpostors[anchor] != NULL || slice == NULL){
+                        continue;
+                    }
+                    x = objectAnchors->rotatedX[anchor];
+                    y = objectAnchors->rotatedY[anchor] - (i * layerPitch) - j;
+                    drawSlice(slice, x, y, drawRotation, 0);
+                }
             }
+            
+            //people and such level with this layer, in front of everything drawn so far
+            drawBillboardLayer(i, j, 0);
         }
     }
+    drawImpostors();
+    releaseRotatedLayers();
+    releaseImpostors();
     
-    //change target back to screen, draw stretched buffer
+    //change target back to screen
+    stopBatchingGeometry();
     SDL_SetRenderTarget(renderer, NULL);
     setDrawScaling(1); //no scaling
     
-    SDL_Rect view;
-    SDL_Rect dest;
+    //chunks the camera has moved away from give back their texture memory
+    freeUnusedChunkLayers(world, chunkLayerFramesUnused);
+}
+
+void drawStackBufferSoftware(){
+    /*
+     * The same drawing as drawStackBuffer, but on the CPU and then uploaded once.  The layer images and rotation
+     * cache are there to cut down draw calls, which we don't have here, so every object is drawn.
+     */
+    int i;
+    int j;
+    int k;
+    int v;
+    int anchor;
+    StackChunk *chunk;
+    const StackObject *obj;
+    const StackSlice *slice;
+    float x, y;
+    int offsetX = 0;
+    int offsetY = SCREEN_HEIGHT * (3-1) - bufferTop;
+    float drawRotation = currentDrawRotation();
     
-    view.x = 0;
-    view.y = SCREEN_HEIGHT * (3 - pitch) * bufferScale;
-    view.w = SCREEN_WIDTH * bufferScale;
-    view.h = SCREEN_HEIGHT * pitch * bufferScale;
+    //clear with whatever SDL_RenderClear would have used
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    clearSoftwareRender(r, g, b, a);
+    setSoftwareDrawScaling(bufferScale);
     
-    dest.x = 0;
-    dest.y = (((1/pitch) - 1)* center) * RENDER_SCALE_MULTIPLE; //re-centers the image - WARNING: has problems when pitch is < 1, due to only drawing part of the buffer; probably need to clamp 1/pitch or something
-    dest.w = WINDOW_WIDTH;
-    dest.h = WINDOW_HEIGHT;
+    float floorLeft = worldToBufferX(drawOffset);
+    float floorTop = worldToBufferY(drawOffset);
+    softwareDrawImageRotate(currentFloorImage(), floorLeft + offsetX, floorTop + offsetY, drawRotation, center - floorLeft, center - floorTop);
+    //when extruding, a layer's copies come from the one draw of each slice
+    int copies = gapFillCopies();
+    startCulling(drawRotation, copies);
+    cullWorld(offsetX, offsetY);
+    rotateObjectAnchors(offsetX, offsetY);
+    prepareBillboards(offsetX, offsetY);
+    int drawsPerSlice = STACK_EXTRUDE_SLICES ? 1 : copies;
+    float layerPitch = getStackLodLayersPerSlice(drawLod) * drawPitch();
+    for (i = 0; i < lodLayerCount(world->numLayers); i++){
+        for (j = 0; j < drawsPerSlice; j++){
+            setSoftwareExtrusion(STACK_EXTRUDE_SLICES ? copies : 1);
+            for (v = 0; v < numVisibleChunks; v++){
+                chunk = visibleChunks[v];
+                if (i >= lodLayerCount(chunk->numLayers)){
+                    continue;
+                }
+                for (k = 0; k < chunk->numObjects; k++){
+                    obj = chunk->objects + k;
+                    slice = getStackModelFrameSliceForLayer(obj->model, getStackObjectFrame(obj), drawLod, i);
+                    anchor = visibleChunkFirstObject[v] + k;
+                    if (!objectIsVisible[anchor] || slice == NULL){
+                        continue;
+                    }
+                    x = objectAnchors->rotatedX[anchor];
+                    y = objectAnchors->rotatedY[anchor] - (i * layerPitch) - j;
+                    drawSlice(slice, x, y, drawRotation, 1);
+                }
+            }
+            drawBillboardLayer(i, j, 1);
+        }
+    }
+    setSoftwareExtrusion(1);
     
-    SDL_RenderCopy(renderer, bufferImage->_texture, &view, &dest);
+    copySoftwareRenderToImage(bufferImage);
+    
+    //report how evenly the bands split the work, the slowest band is how long the whole frame takes
+    framesSinceBandReport++;
+    if (framesSinceBandReport >= framesPerCacheReport){
+        double slowest = 0;
+        double total = 0;
+        int slowestBand = 0;
+        for (i = 0; i < getSoftwareRenderBandCount(); i++){
+            total += getSoftwareRenderBandMilliseconds(i);
+            if (getSoftwareRenderBandMilliseconds(i) > slowest){
+                slowest = getSoftwareRenderBandMilliseconds(i);
+                slowestBand = i;
+            }
+        }
+        LOG_DEB("Software renderer: %d bands, %.2f ms of work, slowest band %d took %.2f ms with %d draws",
+            getSoftwareRenderBandCount(), total, slowestBand, slowest, getSoftwareRenderBandDrawCount(slowestBand)
+        );
+        if (STACK_SOFTWARE_FRONT_TO_BACK){
+            //how much drawing top layers first saved, written per pixel is the overdraw that's left
+            SoftwareCoverageCounts coverage;
+            getSoftwareRenderCoverage(&coverage);
+            LOG_DEB("Software renderer front to back: %ld pixels written (%.2f per buffer pixel), %ld rejected as covered, %ld blocks and %ld rows skipped whole",
+                coverage.pixelsWritten, (double)coverage.pixelsWritten / (bufferImage->width * bufferImage->height),
+                coverage.pixelsRejected, coverage.blocksRejected, coverage.rowsRejected
+            );
+        }
+        framesSinceBandReport = 0;
+    }
+}
+
+void drawStackBufferRaycast(){
+    /*
+     * Nothing is drawn, every buffer pixel finds the highest layer that lands on it in the voxel grid.  It's at full
+     * detail whatever the level of detail or zoom, and billboards aren't in the grid, so they're left out.
+     */
+    StackRaycastView view;
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    view.clearColor = ((Uint32)r << 24) | ((Uint32)g << 16) | ((Uint32)b << 8) | a;
+    view.cameraX = cameraX;
+    view.cameraY = cameraY;
+    view.pivotX = center;
+    view.pivotY = center + (SCREEN_HEIGHT * (3-1)) - bufferTop;
+    view.angle = currentDrawRotation();
+    view.zoom = zoom;
+    view.layerPitch = drawPitch();
+    view.copies = (view.layerPitch > 1) ? ceilf(view.layerPitch) : 1;
+    view.copies -= getQualityLevels()->gapFillDrop;
+    view.copies = (view.copies < 1) ? 1 : view.copies;
+    view.scaling = bufferScale;
+    view.firstRow = (SCREEN_HEIGHT * (3 - pitch) - bufferTop) * bufferScale;
+    view.floor = floorImage->_surface;
+    view.floorX = drawOffset;
+    view.floorY = drawOffset;
+    
+    Uint64 start = SDL_GetPerformanceCounter();
+    raycastStackVoxels(voxelGrid, &view);
+    copySoftwareRenderToImage(bufferImage);
+    raycastTicks += SDL_GetPerformanceCounter() - start;
+    
+    //to compare against the stacks' band reports, for picking which one a scene should use
+    framesSinceRaycastReport++;
+    if (framesSinceRaycastReport >= framesPerCacheReport){
+        LOG_DEB("Raycaster: %dx%d buffer through a %dx%dx%d grid, %.2f ms a frame",
+            bufferImage->width, bufferImage->height, voxelGrid->width, voxelGrid->height, voxelGrid->numLayers,
+            (raycastTicks * 1000.0) / SDL_GetPerformanceFrequency() / framesSinceRaycastReport
+        );
+        raycastTicks = 0;
+        framesSinceRaycastReport = 0;
+    }
+}
+
+int usesSoftwareRender(){
+    return STACK_USE_SOFTWARE_RENDERER || DEBUG_COMPARE_STACK_RENDERERS || voxelGrid != NULL;
+}
+
+int gapFillCopies(){
+    //how many times each layer gets drawn to cover the gap up to the next one, one per pixel of pitch (merged layers are thicker)
+    float layerPitch = getStackLodLayersPerSlice(drawLod) * drawPitch();
+    int copies = (layerPitch > 1) ? ceilf(layerPitch) : 1;
+    //less the ones the governor says to leave out
+    copies -= getQualityLevels()->gapFillDrop;
+    return (copies < 1) ? 1 : copies;
+}
+
+float drawPitch(){
+    //buffer pixels between one full detail layer and the next
+    return pitch * zoom;
+}
+
+float worldToBufferX(float x){
+    //where a world position sits in the buffer before rotating, without the offset down the buffer
+    return center + ((x - cameraX) * zoom);
+}
+
+float worldToBufferY(float y){
+    return center + ((y - cameraY) * zoom);
 }
 
-void drawObject(Object *obj){
+Image *currentFloorImage(){
+    return (zoomLevel > 0) ? floorMips[zoomLevel - 1] : floorImage;
+}
+
+int lodLayerCount(int numLayers){
+    int layersPerSlice = getStackLodLayersPerSlice(drawLod);
+    return (numLayers + layersPerSlice - 1) / layersPerSlice;
+}
+
+void startCulling(float angle, int copies){
+    //the part of the buffer drawStackFrame copies to the screen
+    visibleLeft = 0;
+    visibleRight = SCREEN_WIDTH;
+    visibleTop = SCREEN_HEIGHT * (3 - pitch) - bufferTop;
+    visibleBottom = SCREEN_HEIGHT * 3 - bufferTop;
+    
+    float radians = angle * (M_PI / 180.0);
+    cullAngle = angle;
+    cullCos = cosf(radians);
+    cullSin = sinf(radians);
+    cullCopies = copies;
+}
+
+int isRotatedRectVisible(float x, float y, float width, float height, float centerX, float centerY, float rise){
+    /*
+     * Same arguments as drawImageRotate at the angle given to startCulling, plus how far the rect is stretched
+     * upward after rotating (for layers above it, or extrusion).  Rotated about (x, y) + center, the middle of the
+     * rect ends up here, with a bounding box of these half sizes
+     */
+    if (!STACK_CULL_OFFSCREEN){
+        return 1;
+    }
+    
+    float relativeX = (width / 2) - centerX;
+    float relativeY = (height / 2) - centerY;
+    float middleX = x + centerX + (cullCos * relativeX) - (cullSin * relativeY);
+    float middleY = y + centerY + (cullSin * relativeX) + (cullCos * relativeY);
+    float halfWidth = ((fabsf(cullCos) * width) + (fabsf(cullSin) * height)) / 2;
+    float halfHeight = ((fabsf(cullSin) * width) + (fabsf(cullCos) * height)) / 2;
+    
+    //a pixel of slack for the truncation when drawing
+    return middleX + halfWidth + 1 > visibleLeft && middleX - halfWidth - 1 < visibleRight
+        && middleY + halfHeight + 1 > visibleTop && middleY - halfHeight - rise - 1 < visibleBottom;
+}
+
+void cullWorld(int offsetX, int offsetY){
+    int k;
+    int v;
+    float left, top;
+    const StackObject *obj;
+    StackChunk *chunk;
+    StackChunk **candidates;
+    int numCandidates;
+    
+    /*
+     * Turn the window back into the world: the buffer rotates about (center, center) + offset, which is where the
+     * camera ends up, and is scaled about it by the zoom.  Anything below the window can rise up into it, by as
+     * much as the tallest stack.
+     */
+    float worldLeft = 0, worldTop = 0, worldRight = 0, worldBottom = 0;
+    if (STACK_CULL_OFFSCREEN){
+        float rise = ((world->numLayers - 1) * drawPitch()) + cullCopies - 1;
+        float cornerX[4] = {visibleLeft, visibleRight, visibleLeft, visibleRight};
+        float cornerY[4] = {visibleTop, visibleTop, visibleBottom + rise, visibleBottom + rise};
+        float relativeX, relativeY, x, y;
+        for (k = 0; k < 4; k++){
+            relativeX = cornerX[k] - (center + offsetX);
+            relativeY = cornerY[k] - (center + offsetY);
+            x = cameraX + (((cullCos * relativeX) + (cullSin * relativeY)) / zoom);
+            y = cameraY + (((cullCos * relativeY) - (cullSin * relativeX)) / zoom);
+            worldLeft = (k == 0 || x < worldLeft) ? x : worldLeft;
+            worldTop = (k == 0 || y < worldTop) ? y : worldTop;
+            worldRight = (k == 0 || x > worldRight) ? x : worldRight;
+            worldBottom = (k == 0 || y > worldBottom) ? y : worldBottom;
+        }
+        //a couple of pixels of slack for the truncation when drawing
+        worldLeft -= 2;
+        worldTop -= 2;
+        worldRight += 2;
+        worldBottom += 2;
+    } else {
+        worldLeft = -world->largestFootprint;
+        worldTop = -world->largestFootprint;
+        worldRight = (world->chunksWide * world->chunkSize) + world->largestFootprint;
+        worldBottom = (world->chunksHigh * world->chunkSize) + world->largestFootprint;
+    }
+    numCandidates = findChunksInRect(world, worldLeft, worldTop, worldRight, worldBottom, &candidates);
+    
+    //make sure there's room for every candidate and all their objects
+    int numCandidateObjects = 0;
+    for (v = 0; v < numCandidates; v++){
+        numCandidateObjects += candidates[v]->numObjects;
+    }
+    if (numCandidates > visibleChunkCapacity){
+        visibleChunkCapacity = numCandidates;
+        visibleChunks = realloc(visibleChunks, sizeof(StackChunk *) * visibleChunkCapacity);
+        visibleChunkFirstObject = realloc(visibleChunkFirstObject, sizeof(int) * visibleChunkCapacity);
+        chunkLayerIsVisible = realloc(chunkLayerIsVisible, sizeof(int) * visibleChunkCapacity);
+    }
+    if (numCandidateObjects > objectIsVisibleCapacity){
+        objectIsVisibleCapacity = numCandidateObjects;
+        objectIsVisible = realloc(objectIsVisible, sizeof(int) * objectIsVisibleCapacity);
+    }
+    
+    //each chunk's bounds stretched up by its tallest stack, then each object's footprint stretched up to the top of its top layer
+    numVisibleChunks = 0;
+    numVisibleObjects = 0;
+    numTestedObjects = 0;
+    for (v = 0; v < numCandidates; v++){
+        chunk = candidates[v];
+        left = worldToBufferX(chunk->minX);
+        top = worldToBufferY(chunk->minY);
+        if (!isRotatedRectVisible(left + offsetX, top + offsetY, (chunk->maxX - chunk->minX) * zoom, (chunk->maxY - chunk->minY) * zoom, center - left, center - top,
+            ((chunk->numLayers - 1) * drawPitch()) + cullCopies - 1
+        )){
+            continue;
+        }
+        
+        visibleChunks[numVisibleChunks] = chunk;
+        visibleChunkFirstObject[numVisibleChunks] = numTestedObjects;
+        for (k = 0; k < chunk->numObjects; k++){
+            obj = chunk->objects + k;
+            left = worldToBufferX(obj->x - obj->model->pivotX);
+            top = worldToBufferY(obj->y - obj->model->pivotY);
+            objectIsVisible[numTestedObjects + k] = isRotatedRectVisible(left + offsetX, top + offsetY, obj->model->width * zoom, obj->model->height * zoom, center - left, center - top,
+                ((getStackModelLayerCount(obj->model) - 1) * drawPitch()) + cullCopies - 1
+            );
+            numVisibleObjects += objectIsVisible[numTestedObjects + k];
+        }
+        numTestedObjects += chunk->numObjects;
+        numVisibleChunks++;
+    }
+    
+    //report every so often how much we're skipping
+    framesSinceCullReport++;
+    if (framesSinceCullReport >= framesPerCacheReport){
+        LOG_DEB("Culling: %d of %d chunks and %d of %d objects visible (%d tested), %d layers culled in the last %d frames",
+            numVisibleChunks, world->chunksWide * world->chunksHigh, numVisibleObjects, world->numObjects, numTestedObjects, numCulledLayers, framesSinceCullReport
+        );
+        numCulledLayers = 0;
+        framesSinceCullReport = 0;
+    }
+}
+
+void rotateObjectAnchors(int offsetX, int offsetY){
+    //where every tested object's top left sits in the buffer before rotating, in the order cullWorld tested them
+    int k;
+    int v;
+    const StackObject *obj;
+    clearStackAnchors(objectAnchors);
+    reserveStackAnchors(objectAnchors, numTestedObjects);
+    for (v = 0; v < numVisibleChunks; v++){
+        for (k = 0; k < visibleChunks[v]->numObjects; k++){
+            obj = visibleChunks[v]->objects + k;
+            addStackAnchor(objectAnchors, worldToBufferX(obj->x - obj->model->pivotX) + offsetX, worldToBufferY(obj->y - obj->model->pivotY) + offsetY);
+        }
+    }
+    
+    rotateStackAnchors(objectAnchors, cullAngle, center + offsetX, center + offsetY);
+}
+
+void prepareBillboards(int offsetX, int offsetY){
+    /*
+     * Where each billboard stands in the buffer, which layer it starts in, and whether it's on screen at all.
+     * They stand upright whatever the angle, so only their feet get rotated.
+     */
+    int i;
+    StackBillboard *billboard;
+    ImageRect frame;
+    int layersPerSlice = getStackLodLayersPerSlice(drawLod);
+    int numDrawLayers = (lodLayerCount(world->numLayers) > 0) ? lodLayerCount(world->numLayers) : 1;
+    float top;
+    int span;
+    clearStackAnchors(billboardAnchors);
+    reserveStackAnchors(billboardAnchors, billboards->numBillboards);
+    for (i = 0; i < billboards->numBillboards; i++){
+        addStackAnchor(billboardAnchors, worldToBufferX(billboards->billboards[i].x) + offsetX, worldToBufferY(billboards->billboards[i].y) + offsetY);
+    }
+    rotateStackAnchors(billboardAnchors, cullAngle, center + offsetX, center + offsetY);
+    
+    maxBillboardSpan = 1;
+    for (i = 0; i < billboards->numBillboards; i++){
+        billboard = billboards->billboards + i;
+        getStackBillboardFrame(billboard, &frame);
+        billboard->_screenX = billboardAnchors->rotatedX[i];
+        billboard->_depth = billboardAnchors->rotatedY[i];
+        
+        top = billboard->_depth - ((billboard->layer + frame.h) * drawPitch()) - cullCopies;
+        if (STACK_CULL_OFFSCREEN && (billboard->_screenX + (frame.w * zoom / 2) + 1 < visibleLeft || billboard->_screenX - (frame.w * zoom / 2) - 1 > visibleRight
+            || billboard->_depth + 1 < visibleTop || top - 1 > visibleBottom)){
+            billboard->_bucket = -1;
+            continue;
+        }
+        
+        //anything above the top layer is drawn with the top layer
+        billboard->_bucket = billboard->layer / layersPerSlice;
+        billboard->_bucket = (billboard->_bucket >= numDrawLayers) ? numDrawLayers - 1 : billboard->_bucket;
+        span = ((billboard->layer + frame.h - 1) / layersPerSlice) - billboard->_bucket + 1;
+        maxBillboardSpan = (span > maxBillboardSpan) ? span : maxBillboardSpan;
+    }
+    
+    sortStackBillboards(billboards, numDrawLayers);
+}
+
+void drawBillboardLayer(int layer, int lift, int software){
+    //the strip of every billboard that's level with this layer, layersPerSlice rows of it (or the rest of it at the top)
+    int bucket, k, count, lowRow, highRow, mip;
+    const int *indices;
+    StackBillboard *billboard;
+    Image *image;
+    ImageRect frame, mipFrame, strip;
+    int layersPerSlice = getStackLodLayersPerSlice(drawLod);
+    int lastLayer = lodLayerCount(world->numLayers) - 1;
+    for (bucket = layer - maxBillboardSpan + 1; bucket <= layer; bucket++){
+        count = getStackBillboardBucket(billboards, bucket, &indices);
+        for (k = 0; k < count; k++){
+            billboard = billboards->billboards + indices[k];
+            getStackBillboardFrame(billboard, &frame);
+            mip = zoomLevel;
+            image = getStackBillboardMipFrame(billboard, &mip, &mipFrame);
+            
+            //rows counted up from the feet
+            lowRow = (layer * layersPerSlice) - billboard->layer;
+            highRow = (layer >= lastLayer) ? frame.h : lowRow + layersPerSlice;
+            lowRow = (lowRow < 0) ? 0 : lowRow;
+            highRow = (highRow > frame.h) ? frame.h : highRow;
+            //a mip's row goes with the layer its bottom full size row is in
+            lowRow = (lowRow + (1 << mip) - 1) >> mip;
+            highRow = (highRow + (1 << mip) - 1) >> mip;
+            if (lowRow >= highRow){
+                continue;
+            }
+            
+            strip.x = mipFrame.x;
+            strip.y = mipFrame.y + mipFrame.h - highRow;
+            strip.w = mipFrame.w;
+            strip.h = highRow - lowRow;
+            float x = billboard->_screenX - (mipFrame.w / 2);
+            float y = billboard->_depth - ((billboard->layer + (lowRow << mip)) * drawPitch()) - strip.h - lift;
+            if (software){
+                softwareDrawImageSrcRotate(image, &strip, x, y, 0, 0, 0);
+            } else {
+                drawImageSrcRotate(image, &strip, x, y, 0, 0, 0);
+            }
+        }
+    }
+}
+
+void drawSlice(const StackSlice *slice, float x, float y, float angle, int software){
+    //(x, y) is where the model's top left lands after rotating, and trimmed slices only draw the pieces that can be seen
+    int i;
+    float pieceX, pieceY;
+    int offsetX, offsetY;
+    
+    //zoomed out, the whole mip is drawn, it's small enough that trimming and baking wouldn't save much
+    if (zoomLevel > 0){
+        Image *mip = getStackSliceMip(slice, zoomLevel, &offsetX, &offsetY);
+        if (mip == NULL){
+            return;
+        }
+        x += (cullCos * offsetX) - (cullSin * offsetY);
+        y += (cullSin * offsetX) + (cullCos * offsetY);
+        if (software){
+            softwareDrawImagePreRotated(mip, NULL, x, y, angle);
+        } else {
+            drawImagePreRotated(mip, NULL, x, y, angle);
+        }
+        return;
+    }
+    
+    x += (cullCos * slice->offsetX) - (cullSin * slice->offsetY);
+    y += (cullSin * slice->offsetX) + (cullCos * slice->offsetY);
+    
+    //baked slices are copied unrotated, with their middle where the slice's middle lands
+    Image *baked = getBakedStackSlice(slice, angle);
+    if (baked != NULL){
+        float middleX = x + (cullCos * slice->image->width / 2) - (cullSin * slice->image->height / 2);
+        float middleY = y + (cullSin * slice->image->width / 2) + (cullCos * slice->image->height / 2);
+        if (software){
+            softwareDrawImagePreRotated(baked, NULL, roundf(middleX - (baked->width / 2.0f)), roundf(middleY - (baked->height / 2.0f)), 0);
+        } else {
+            drawImagePreRotated(baked, NULL, roundf(middleX - (baked->width / 2.0f)), roundf(middleY - (baked->height / 2.0f)), 0);
+        }
+        return;
+    }
+    
+    //the solid parts of the pieces, which only the hardware renderer's geometry can draw
+    if (slice->quads != NULL && !software){
+        drawImageQuadsPreRotated(slice->image, slice->quads, slice->numQuads, x, y, angle);
+        return;
+    }
+    
+    if (slice->pieces == NULL){
+        if (software){
+            softwareDrawImagePreRotated(slice->image, NULL, x, y, angle);
+        } else {
+            drawImagePreRotated(slice->image, NULL, x, y, angle);
+        }
+        return;
+    }
+    
+    for (i = 0; i < slice->numPieces; i++){
+        pieceX = x + (cullCos * slice->pieces[i].x) - (cullSin * slice->pieces[i].y);
+        pieceY = y + (cullSin * slice->pieces[i].x) + (cullCos * slice->pieces[i].y);
+        if (software){
+            softwareDrawImagePreRotated(slice->image, slice->pieces + i, pieceX, pieceY, angle);
+        } else {
+            drawImagePreRotated(slice->image, slice->pieces + i, pieceX, pieceY, angle);
+        }
+    }
+}
+
+float currentDrawRotation(){
+    //the rotation cache only has whole angle steps, so snap to those when it's on
+    if (rotationCache != NULL){
+        return rotationCacheAngleBucket(rotation) * STACK_ROTATION_CACHE_ANGLE_STEP;
+    }
+    return rotation;
+}
+
+void compareStackRenderers(){
+    /*
+     * Draw the buffer with SDL, read it back, draw it with the software renderer, and count the pixels that differ.
+     * Some difference is expected, since SDL's renderers don't all sample rotated textures in exactly the same way.
+     */
+    int width = bufferImage->width;
+    int height = bufferImage->height;
+    Uint32 *sdlPixels = malloc(sizeof(Uint32) * width * height);
+    
+    //the software renderer has no impostors, so leave them out of this one too
+    TextureCache *impostors = impostorCache;
+    impostorCache = NULL;
+    drawStackBuffer();
+    impostorCache = impostors;
+    SDL_SetRenderTarget(renderer, bufferImage->_texture);
+    if (SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_RGBA8888, sdlPixels, width * 4) != 0){
+        LOG_ERR("Could not read back the stack buffer to compare renderers: %s", SDL_GetError());
+        SDL_SetRenderTarget(renderer, NULL);
+        free(sdlPixels);
+        return;
+    }
+    SDL_SetRenderTarget(renderer, NULL);
+    
+    drawStackBufferSoftware();
+    SDL_Surface *softwarePixels = getSoftwareRenderSurface();
+    
+    int x, y, shift, difference;
+    int numDifferent = 0;
+    int largestDifference = 0;
+    Uint32 sdlPixel, softwarePixel;
+    for (y = 0; y < height; y++){
+        for (x = 0; x < width; x++){
+            sdlPixel = sdlPixels[(y * width) + x];
+            softwarePixel = ((Uint32 *)softwarePixels->pixels)[(y * (softwarePixels->pitch / 4)) + x];
+            
+            int pixelDifference = 0;
+            for (shift = 0; shift < 32; shift += 8){
+                difference = abs((int)((sdlPixel >> shift) & 0xFF) - (int)((softwarePixel >> shift) & 0xFF));
+                pixelDifference = (difference > pixelDifference) ? difference : pixelDifference;
+            }
+            
+            if (pixelDifference > rendererComparisonTolerance){
+                numDifferent++;
+            }
+            largestDifference = (pixelDifference > largestDifference) ? pixelDifference : largestDifference;
+        }
+    }
+    
+    LOG_INF("Renderer comparison (%s): %d of %d pixels differ by more than %d, largest channel difference %d",
+        getSoftwareRendererInstructionSet(), numDifferent, width * height, rendererComparisonTolerance, largestDifference
+    );
+    free(sdlPixels);
+}
+
+void drawObject(StackObject *obj){
     int i;
     int j;
-    for (i = 1; i < numLayers; i++){
-        //drawImageRotate(wallImage, obj->x, obj->y - i, rotation, center-obj->x, center-obj->y); //works w/o pitching
+    const StackSlice *slice;
+    float left, top;
+    for (i = 1; i < getStackModelLayerCount(obj->model); i++){
+        slice = getStackModelSliceForLayer(obj->model, i);
+        if (slice == NULL){
+            continue;
+        }
+        left = obj->x - obj->model->pivotX + slice->offsetX;
+        top = obj->y - obj->model->pivotY + slice->offsetY;
+        //drawImageRotate(slice->image, left, top - i, rotation, center-left, center-top); //works w/o pitching
         
         //adds extra copies of the image to hide the gaps, although my theory is that if rendering at a low resolution, the gaps won't be visibile anyway
         for (j = 0; j < pitch; j++){
-            drawImageRotate(wallImage, obj->x, obj->y - (i * pitch) - j, rotation, center-obj->x, center-obj->y);
+            drawImageRotate(slice->image, left, top - (i * pitch) - j, rotation, center-left, center-top);
+        }
+    }
+}
+
+
+
+/////////////////////////////////////////////////
+// Rotation cache
+/////////////////////////////////////////////////
+int angleBucket(float angle, float step){
+    int numBuckets = roundf(360 / step);
+    int bucket = (int)floorf(angle / step + 0.5f) % numBuckets;
+    return (bucket < 0) ? bucket + numBuckets : bucket;
+}
+
+int rotationCacheAngleBucket(float angle){
+    return angleBucket(angle, STACK_ROTATION_CACHE_ANGLE_STEP);
+}
+
+void prepareRotatedLayers(int angleBucket, float angle, int copies){
+    int i;
+    int j;
+    int v;
+    int key[TEXTURE_CACHE_KEY_LENGTH];
+    StackChunk *chunk;
+    Image **layerImages;
+    Image *rotated;
+    
+    numRotatedLayers = numVisibleChunks * world->numLayers;
+    if (numRotatedLayers > rotatedLayerCapacity){
+        rotatedLayerCapacity = numRotatedLayers;
+        rotatedLayers = realloc(rotatedLayers, sizeof(Image *) * rotatedLayerCapacity);
+        rotatedLayerIsOwned = realloc(rotatedLayerIsOwned, sizeof(int) * rotatedLayerCapacity);
+    }
+    
+    startTextureCacheFrame(rotationCache);
+    for (v = 0; v < numVisibleChunks; v++){
+        chunk = visibleChunks[v];
+        for (i = 0; i < world->numLayers; i++){
+            rotatedLayers[(v * world->numLayers) + i] = NULL;
+            rotatedLayerIsOwned[(v * world->numLayers) + i] = 0;
+        }
+        if (chunk->numStatic == 0){
+            continue;
+        }
+        
+        layerImages = getChunkLayerImages(world, chunk, drawLod, zoomLevel);
+        for (i = 0; i < lodLayerCount(chunk->numLayers); i++){
+            key[0] = chunk->index;
+            key[1] = chunk->version;
+            key[2] = drawLod;
+            key[3] = i;
+            key[4] = angleBucket;
+            key[5] = bufferScale;
+            key[6] = copies;
+            key[7] = zoomLevel;
+            key[8] = 0;
+            
+            rotated = findInTextureCache(rotationCache, key);
+            if (rotated == NULL){
+                /*
+                 * Big enough to hold the layer at any angle.  The layer is rotated about its own center, which sits
+                 * at the center of the new image, at the buffer's resolution so the result matches rotating in the buffer
+                 */
+                int width = layerImages[i]->width;
+                int height = layerImages[i]->height;
+                int size = ceilf(sqrtf(width*width + height*height)) + 2;
+                rotated = createEmptyImage(size * bufferScale, (size + copies - 1) * bufferScale);
+                SDL_SetRenderTarget(renderer, rotated->_texture);
+                setDrawScaling(bufferScale);
+                for (j = 0; j < copies; j++){
+                    drawImageRotate(layerImages[i], (size - width) / 2, (size - height) / 2 + (copies - 1 - j), angle, width / 2, height / 2);
+                }
+                
+                if (!addToTextureCache(rotationCache, key, rotated)){
+                    rotatedLayerIsOwned[(v * world->numLayers) + i] = 1;
+                }
+            }
+            rotatedLayers[(v * world->numLayers) + i] = rotated;
         }
     }
+    SDL_SetRenderTarget(renderer, NULL);
+    setDrawScaling(1);
+    
+    //report how the cache is doing every so often, so the budget can be sized for the scene
+    framesSinceCacheReport++;
+    if (framesSinceCacheReport >= framesPerCacheReport){
+        LOG_DEB("Rotation cache: %d hits, %d misses, %d evictions, %d entries using %d of %d KB",
+            rotationCache->hits, rotationCache->misses, rotationCache->evictions,
+            rotationCache->numEntries, rotationCache->bytesUsed / 1024, rotationCache->budgetBytes / 1024
+        );
+        resetTextureCacheCounters(rotationCache);
+        framesSinceCacheReport = 0;
+    }
+}
+
+void releaseRotatedLayers(){
+    if (rotationCache == NULL){
+        return;
+    }
+    
+    int i;
+    for (i = 0; i < numRotatedLayers; i++){
+        if (rotatedLayerIsOwned[i]){
+            free_Image(rotatedLayers[i]);
+        }
+        rotatedLayers[i] = NULL;
+        rotatedLayerIsOwned[i] = 0;
+    }
+    numRotatedLayers = 0;
+}
+
+void drawRotatedLayer(int visibleChunk, int layer, float x, float y, float angle, int centerX, int centerY){
+    /*
+     * Same arguments as drawImageRotate, for a layer of one of this frame's visible chunks.  Without the cache this
+     * is just drawImageRotate, with the cache we work out where the rotation would have put the center of the layer
+     * and blit the pre-rotated image there instead
+     */
+    Image *layerImage = visibleChunks[visibleChunk]->layerImages[drawLod][zoomLevel][layer];
+    if (rotationCache == NULL){
+        drawImageRotate(layerImage, x, y, angle, centerX, centerY);
+        return;
+    }
+    
+    Image *rotated = rotatedLayers[(visibleChunk * world->numLayers) + layer];
+    int size = rotated->width / bufferScale;
+    int extrusion = rotated->height / bufferScale - size; //copies baked in beyond the first
+    float pivotX = (int)x + centerX;
+    float pivotY = (int)y + centerY;
+    float relativeX = (layerImage->width / 2) - centerX;
+    float relativeY = (layerImage->height / 2) - centerY;
+    float radians = angle * (M_PI / 180.0);
+    float c = cosf(radians);
+    float s = sinf(radians);
+    
+    ImageRect dst;
+    dst.x = roundf(pivotX + (c * relativeX) - (s * relativeY) - ((size - layerImage->width) / 2 + layerImage->width / 2));
+    dst.y = roundf(pivotY + (s * relativeX) + (c * relativeY) - ((size - layerImage->height) / 2 + layerImage->height / 2)) - extrusion;
+    dst.w = size;
+    dst.h = size + extrusion;
+    drawImageSrcDst(rotated, NULL, &dst);
+}
+
+const TextureCache *getStackRotationCache(){
+    return rotationCache;
+}
+
+
+
+/////////////////////////////////////////////////
+// Impostors
+/////////////////////////////////////////////////
+void prepareImpostors(float angle, int copies){
+    int i, v, k, anchor;
+    int key[TEXTURE_CACHE_KEY_LENGTH];
+    const StackObject *obj;
+    Image *impostor;
+    
+    if (numTestedObjects > objectImpostorCapacity){
+        objectImpostorCapacity = numTestedObjects;
+        objectImpostors = realloc(objectImpostors, sizeof(Image *) * objectImpostorCapacity);
+        objectImpostorIsOwned = realloc(objectImpostorIsOwned, sizeof(int) * objectImpostorCapacity);
+        objectIsAlone = realloc(objectIsAlone, objectImpostorCapacity);
+    }
+    for (i = 0; i < numTestedObjects; i++){
+        objectImpostors[i] = NULL;
+        objectImpostorIsOwned[i] = 0;
+        objectIsAlone[i] = 0;
+    }
+    numImpostors = 0;
+    impostorsBuiltThisFrame = 0;
+    if (impostorCache == NULL){
+        return;
+    }
+    
+    startTextureCacheFrame(impostorCache);
+    findIsolatedObjects();
+    
+    //all of them are made at the view snapped to the steps, which might not quite be the one the rest is drawn at
+    int angleStep = angleBucket(angle, STACK_IMPOSTOR_ANGLE_STEP);
+    int pitchStep = (int)floorf(pitch / STACK_IMPOSTOR_PITCH_STEP + 0.5f);
+    for (v = 0; v < numVisibleChunks; v++){
+        for (k = 0; k < visibleChunks[v]->numObjects; k++){
+            anchor = visibleChunkFirstObject[v] + k;
+            if (!objectIsAlone[anchor]){
+                continue;
+            }
+            obj = visibleChunks[v]->objects + k;
+            
+            key[0] = impostorModelIndex(obj->model);
+            key[1] = obj->model->version;
+            key[2] = getStackObjectFrame(obj) % getStackModelFrameCount(obj->model);
+            key[3] = angleStep;
+            key[4] = pitchStep;
+            key[5] = drawLod;
+            key[6] = bufferScale;
+            key[7] = copies;
+            key[8] = zoomLevel;
+            
+            impostor = findInTextureCache(impostorCache, key);
+            if (impostor == NULL){
+                if (impostorsBuiltThisFrame >= STACK_IMPOSTOR_BUILDS_PER_FRAME){
+                    continue;
+                }
+                impostor = buildImpostor(obj, angleStep * STACK_IMPOSTOR_ANGLE_STEP, pitchStep * STACK_IMPOSTOR_PITCH_STEP, copies);
+                impostorsBuiltThisFrame++;
+                if (!addToTextureCache(impostorCache, key, impostor)){
+                    objectImpostorIsOwned[anchor] = 1;
+                }
+            }
+            objectImpostors[anchor] = impostor;
+            
+            //back to front by where the middle of the footprint lands, so far it's only a handful a frame
+            if (numImpostors >= impostorOrderCapacity){
+                impostorOrderCapacity = (impostorOrderCapacity == 0) ? 16 : impostorOrderCapacity * 2;
+                impostorAnchors = realloc(impostorAnchors, sizeof(int) * impostorOrderCapacity);
+                impostorObjects = realloc(impostorObjects, sizeof(StackObject *) * impostorOrderCapacity);
+            }
+            for (i = numImpostors; i > 0 && objectMiddleDepth(impostorObjects[i - 1], impostorAnchors[i - 1]) > objectMiddleDepth(obj, anchor); i--){
+                impostorAnchors[i] = impostorAnchors[i - 1];
+                impostorObjects[i] = impostorObjects[i - 1];
+            }
+            impostorAnchors[i] = anchor;
+            impostorObjects[i] = obj;
+            numImpostors++;
+        }
+    }
+    if (impostorsBuiltThisFrame > 0){
+        //building switched the culling angle and the render target
+        startCulling(angle, copies);
+        SDL_SetRenderTarget(renderer, NULL);
+        setDrawScaling(1);
+    }
+    
+    //report every so often how many objects get away with one draw, and what it costs to keep them
+    impostorsDrawn += numImpostors;
+    impostorsBuilt += impostorsBuiltThisFrame;
+    mostImpostorsBuilt = (impostorsBuiltThisFrame > mostImpostorsBuilt) ? impostorsBuiltThisFrame : mostImpostorsBuilt;
+    framesSinceImpostorReport++;
+    if (framesSinceImpostorReport >= framesPerCacheReport){
+        LOG_DEB("Impostors: %.1f of %.1f dynamic objects on their own a frame, %.1f drawn as impostors; %d hits, %d misses, %d built (at most %d in a frame), %d evictions, %d entries using %d of %d KB",
+            (double)impostorsIsolated / framesSinceImpostorReport, (double)impostorCandidates / framesSinceImpostorReport, (double)impostorsDrawn / framesSinceImpostorReport,
+            impostorCache->hits, impostorCache->misses, impostorsBuilt, mostImpostorsBuilt, impostorCache->evictions,
+            impostorCache->numEntries, impostorCache->bytesUsed / 1024, impostorCache->budgetBytes / 1024
+        );
+        resetTextureCacheCounters(impostorCache);
+        impostorCandidates = 0;
+        impostorsIsolated = 0;
+        impostorsDrawn = 0;
+        impostorsBuilt = 0;
+        mostImpostorsBuilt = 0;
+        framesSinceImpostorReport = 0;
+    }
+}
+
+void findIsolatedObjects(){
+    /*
+     * Marks the visible dynamic objects whose bounds share no cell of the grid with anything else's in
+     * objectIsAlone.  The cells are coarse, so things that only come close count as overlapping, which just means
+     * drawing them the usual way.
+     */
+    int v, k, i, anchor;
+    const StackObject *obj;
+    StackBillboard *billboard;
+    ImageRect frame;
+    float left, top, right, bottom;
+    
+    overlapCellsWide = (int)ceilf((visibleRight - visibleLeft) / overlapCellSize);
+    overlapCellsHigh = (int)ceilf((visibleBottom - visibleTop) / overlapCellSize);
+    overlapCellsWide = (overlapCellsWide < 1) ? 1 : overlapCellsWide;
+    overlapCellsHigh = (overlapCellsHigh < 1) ? 1 : overlapCellsHigh;
+    if (overlapCellsWide * overlapCellsHigh > overlapCellCapacity){
+        overlapCellCapacity = overlapCellsWide * overlapCellsHigh;
+        overlapCells = realloc(overlapCells, overlapCellCapacity);
+    }
+    for (i = 0; i < overlapCellsWide * overlapCellsHigh; i++){
+        overlapCells[i] = 0;
+    }
+    
+    //everything that's drawn, static or not
+    for (v = 0; v < numVisibleChunks; v++){
+        for (k = 0; k < visibleChunks[v]->numObjects; k++){
+            anchor = visibleChunkFirstObject[v] + k;
+            if (!objectIsVisible[anchor]){
+                continue;
+            }
+            objectBufferBounds(visibleChunks[v]->objects + k, anchor, &left, &top, &right, &bottom);
+            countOverlapCells(left, top, right, bottom);
+        }
+    }
+    for (i = 0; i < billboards->numBillboards; i++){
+        billboard = billboards->billboards + i;
+        if (billboard->_bucket < 0){
+            continue;
+        }
+        getStackBillboardFrame(billboard, &frame);
+        countOverlapCells(billboard->_screenX - (frame.w * zoom / 2) - 1, billboard->_depth - ((billboard->layer + frame.h) * drawPitch()) - cullCopies - 1,
+            billboard->_screenX + (frame.w * zoom / 2) + 1, billboard->_depth + 1
+        );
+    }
+    
+    for (v = 0; v < numVisibleChunks; v++){
+        for (k = 0; k < visibleChunks[v]->numObjects; k++){
+            anchor = visibleChunkFirstObject[v] + k;
+            obj = visibleChunks[v]->objects + k;
+            if (obj->isStatic || !objectIsVisible[anchor]){
+                continue;
+            }
+            impostorCandidates++;
+            objectBufferBounds(obj, anchor, &left, &top, &right, &bottom);
+            if (isAloneInOverlapCells(left, top, right, bottom)){
+                objectIsAlone[anchor] = 1;
+                impostorsIsolated++;
+            }
+        }
+    }
+}
+
+void objectBufferBounds(const StackObject *obj, int anchor, float *left, float *top, float *right, float *bottom){
+    //the box around an object's rotated footprint, stretched up to the top of its top layer's last copy, with a pixel of slack
+    float width = obj->model->width * zoom;
+    float height = obj->model->height * zoom;
+    float x = objectAnchors->rotatedX[anchor];
+    float y = objectAnchors->rotatedY[anchor];
+    float cornerX[4] = {0, cullCos * width, -cullSin * height, (cullCos * width) - (cullSin * height)};
+    float cornerY[4] = {0, cullSin * width, cullCos * height, (cullSin * width) + (cullCos * height)};
+    int i;
+    *left = x + cornerX[0];
+    *right = *left;
+    *top = y + cornerY[0];
+    *bottom = *top;
+    for (i = 1; i < 4; i++){
+        *left = (x + cornerX[i] < *left) ? x + cornerX[i] : *left;
+        *right = (x + cornerX[i] > *right) ? x + cornerX[i] : *right;
+        *top = (y + cornerY[i] < *top) ? y + cornerY[i] : *top;
+        *bottom = (y + cornerY[i] > *bottom) ? y + cornerY[i] : *bottom;
+    }
+    *top -= ((getStackModelLayerCount(obj->model) - 1) * drawPitch()) + cullCopies - 1;
+    *left -= 1;
+    *top -= 1;
+    *right += 1;
+    *bottom += 1;
+}
+
+int overlapCellRange(float left, float top, float right, float bottom, int *firstColumn, int *firstRow, int *lastColumn, int *lastRow){
+    //0 if the bounds miss the visible window, anything past its edges is left out
+    if (right < visibleLeft || left >= visibleRight || bottom < visibleTop || top >= visibleBottom){
+        return 0;
+    }
+    *firstColumn = (left < visibleLeft) ? 0 : (int)((left - visibleLeft) / overlapCellSize);
+    *firstRow = (top < visibleTop) ? 0 : (int)((top - visibleTop) / overlapCellSize);
+    *lastColumn = (int)((right - visibleLeft) / overlapCellSize);
+    *lastRow = (int)((bottom - visibleTop) / overlapCellSize);
+    *lastColumn = (*lastColumn >= overlapCellsWide) ? overlapCellsWide - 1 : *lastColumn;
+    *lastRow = (*lastRow >= overlapCellsHigh) ? overlapCellsHigh - 1 : *lastRow;
+    return 1;
+}
+
+void countOverlapCells(float left, float top, float right, float bottom){
+    int column, row, firstColumn, firstRow, lastColumn, lastRow;
+    Uint8 *cell;
+    if (!overlapCellRange(left, top, right, bottom, &firstColumn, &firstRow, &lastColumn, &lastRow)){
+        return;
+    }
+    for (row = firstRow; row <= lastRow; row++){
+        for (column = firstColumn; column <= lastColumn; column++){
+            cell = overlapCells + (row * overlapCellsWide) + column;
+            *cell = (*cell < 2) ? *cell + 1 : 2;
+        }
+    }
+}
+
+int isAloneInOverlapCells(float left, float top, float right, float bottom){
+    //every cell it touches is touched by it and nothing else
+    int column, row, firstColumn, firstRow, lastColumn, lastRow;
+    if (!overlapCellRange(left, top, right, bottom, &firstColumn, &firstRow, &lastColumn, &lastRow)){
+        return 0;
+    }
+    for (row = firstRow; row <= lastRow; row++){
+        for (column = firstColumn; column <= lastColumn; column++){
+            if (overlapCells[(row * overlapCellsWide) + column] > 1){
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+Image *buildImpostor(const StackObject *obj, float angle, float impostorPitch, int copies){
+    /*
+     * The object drawn the way drawStackBuffer would, on its own, at the buffer's resolution.  The middle of its
+     * footprint sits at the middle of a square big enough for any angle, with room above for the layers to rise into.
+     */
+    int i, j;
+    const StackSlice *slice;
+    int frame = getStackObjectFrame(obj);
+    float width = obj->model->width * zoom;
+    float height = obj->model->height * zoom;
+    float layerPitch = getStackLodLayersPerSlice(drawLod) * impostorPitch * zoom;
+    int numLayers = lodLayerCount(getStackModelLayerCount(obj->model));
+    int size = ceilf(sqrtf((width * width) + (height * height))) + 2;
+    int rise = ceilf(((numLayers - 1) * layerPitch) + copies - 1);
+    
+    Image *result = createEmptyImage(size * bufferScale, (size + rise) * bufferScale);
+    SDL_SetRenderTarget(renderer, result->_texture);
+    setDrawScaling(bufferScale);
+    
+    //drawSlice works from the culling angle
+    startCulling(angle, copies);
+    float x = (size / 2.0f) - (((cullCos * width) - (cullSin * height)) / 2);
+    float y = rise + (size / 2.0f) - (((cullSin * width) + (cullCos * height)) / 2);
+    startBatchingGeometry();
+    for (i = 0; i < numLayers; i++){
+        slice = getStackModelFrameSliceForLayer(obj->model, frame, drawLod, i);
+        if (slice == NULL){
+            continue;
+        }
+        for (j = 0; j < copies; j++){
+            drawSlice(slice, x, y - (i * layerPitch) - j, angle, 0);
+        }
+    }
+    stopBatchingGeometry();
+    
+    return result;
+}
+
+int impostorModelIndex(const StackModel *model){
+    int i;
+    for (i = 0; i < numImpostorModels; i++){
+        if (impostorModels[i] == model){
+            return i;
+        }
+    }
+    impostorModels = realloc(impostorModels, sizeof(StackModel *) * (numImpostorModels + 1));
+    impostorModels[numImpostorModels] = model;
+    numImpostorModels++;
+    return numImpostorModels - 1;
+}
+
+float objectMiddleDepth(const StackObject *obj, int anchor){
+    //how far down the buffer the middle of the footprint lands
+    return objectAnchors->rotatedY[anchor] + (((cullSin * obj->model->width) + (cullCos * obj->model->height)) * zoom / 2);
+}
+
+void drawImpostors(){
+    //each with the middle of its footprint where the object's lands, the same as where it was built
+    int i, size, rise;
+    float middleX, middleY;
+    const StackObject *obj;
+    Image *impostor;
+    ImageRect dst;
+    for (i = 0; i < numImpostors; i++){
+        obj = impostorObjects[i];
+        impostor = objectImpostors[impostorAnchors[i]];
+        middleX = objectAnchors->rotatedX[impostorAnchors[i]] + (((cullCos * obj->model->width) - (cullSin * obj->model->height)) * zoom / 2);
+        middleY = objectMiddleDepth(obj, impostorAnchors[i]);
+        size = impostor->width / bufferScale;
+        rise = (impostor->height / bufferScale) - size;
+        
+        dst.x = roundf(middleX - (size / 2.0f));
+        dst.y = roundf(middleY - (size / 2.0f) - rise);
+        dst.w = size;
+        dst.h = size + rise;
+        drawImageSrcDst(impostor, NULL, &dst);
+    }
+}
+
+void releaseImpostors(){
+    int i;
+    for (i = 0; i < numImpostors; i++){
+        if (objectImpostorIsOwned[impostorAnchors[i]]){
+            free_Image(objectImpostors[impostorAnchors[i]]);
+            objectImpostorIsOwned[impostorAnchors[i]] = 0;
+        }
+    }
+    numImpostors = 0;
+}
+
+const TextureCache *getStackImpostorCache(){
+    return impostorCache;
 }
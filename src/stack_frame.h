@@ -1,8 +1,15 @@
 #ifndef STACK_FRAME_H
 #define STACK_FRAME_H
 
+#include "texture_cache.h"
+
 void initStackFrame();
 void doStackFrame(int delta);
 void drawStackFrame(int excessTime);
 
+//NULL if the rotation cache is turned off in the configuration, otherwise its counters can be read for tuning
+const TextureCache *getStackRotationCache();
+//same for the impostor cache, for isolated dynamic objects drawn as one image each
+const TextureCache *getStackImpostorCache();
+
 #endif
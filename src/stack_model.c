@@ -0,0 +1,1163 @@
+#include "stack_model.h"
+#include "graphics.h"
+#include "logging.h"
+#include "omni_exit.h"
+#include "file_reader.h"
+#include "vox_loader.h"
+#include "configuration.h"
+#include "software_renderer.h"
+#include "constants.h"
+#include "../lib/cjson_wrapper.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static StackModel *loadModel(char *filename, int editable, int encodeSpans);
+static Image *mergeSlices(const StackModel *self, int frame, int firstLayer, int numLayers, int lod, int *offsetX, int *offsetY);
+static void compositeLayers(const StackModel *self, int frame, int firstLayer, int numLayers, int lod, Uint32 *pixels, int stride, int left, int top, const ImageRect *region);
+static int usesSlice(const StackModel *self, int frame, int firstLayer, int numLayers, int slice);
+static int refreshSliceTextures(StackSlice *slice, const ImageRect *rect);
+static int sameLayersAsLastFrame(const StackModel *self, int frame, int firstLayer, int numLayers);
+static void trimFrames(StackSlice *slices, int numSlices, int *layerSlices, int numLayers, int numFrames, float layerSpacing, int *pixelsBefore, int *pixelsAfter, int *numDropped);
+static void trimSlices(StackSlice *slices, int numSlices, int *layerSlices, int numLayers, float layerSpacing, int *pixelsBefore, int *pixelsAfter, int *numDropped);
+static int *countOpaque(const StackSlice *slice);
+static void findPieces(StackSlice *slice, const char *isVisible);
+static void freeSlice(StackSlice *slice);
+static void bakeSlice(StackSlice *slice, int numAngles);
+static float slicePixelsDrawn(const StackSlice *slice);
+static void encodeImage(Image *image, int *pixelBytes, int *spanBytes);
+static void drawBenchmarkStacks(const StackModel *model);
+static void finishBenchmarkFrame(Uint32 *pixels, int pitch, int width, int top, int bottom, void *data);
+static int bakedSliceBytes(const StackSlice *slice, int numAngles);
+static int buildSliceMips(StackSlice *slice);
+
+//when showing levels of detail, coarse slices are multiplied by these so it's obvious which level is drawn
+static const Uint8 lodTints[STACK_MODEL_LOD_LEVELS][3] = {
+    {255, 255, 255},
+    {255, 255, 96},
+    {255, 96, 96}
+};
+
+//a slice whose visible pixels won't go in this many rectangles is just drawn by its bounds instead
+static const int maxSlicePieces = 8;
+static const int maxSliceQuads = 32;
+static const float minMeshSaving = 0.125; //fraction of the pieces' pixels the quads have to save to be used
+static const int benchmarkFrames = 50;
+static const int benchmarkAngles = 16; //copies of the model drawn each frame, each turned a bit further
+
+//every model's baked rotations so far, against STACK_BAKED_ROTATION_BUDGET_KB
+static int bakedRotationBytes = 0;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackModel *init_StackModel(StackModel *self){
+    self->slices = NULL;
+    self->numSlices = 0;
+    self->layerSlices = NULL;
+    self->numLayers = 0;
+    self->numFrames = 1;
+    self->width = 0;
+    self->height = 0;
+    self->pivotX = 0;
+    self->pivotY = 0;
+    self->version = 0;
+    
+    int i;
+    for (i = 0; i < STACK_MODEL_LOD_LEVELS - 1; i++){
+        self->lods[i].slices = NULL;
+        self->lods[i].numSlices = 0;
+        self->lods[i].layerSlices = NULL;
+        self->lods[i].numLayers = 0;
+    }
+    
+    return self;
+}
+
+void free_StackModel(StackModel *self){
+    if (self == NULL){
+        LOG_WAR("Tried to free NULL StackModel");
+        return;
+    }
+    
+    //slices that were batched share their atlas's texture, which the atlas owner frees
+    int i, j;
+    for (i = 0; i < self->numSlices; i++){
+        freeSlice(self->slices + i);
+    }
+    for (i = 0; i < STACK_MODEL_LOD_LEVELS - 1; i++){
+        for (j = 0; j < self->lods[i].numSlices; j++){
+            freeSlice(self->lods[i].slices + j);
+        }
+        free(self->lods[i].slices);
+        free(self->lods[i].layerSlices);
+    }
+    free(self->slices);
+    self->slices = NULL;
+    self->numSlices = 0;
+    free(self->layerSlices);
+    self->layerSlices = NULL;
+    self->numLayers = 0;
+    
+    free(self);
+}
+
+void freeSlice(StackSlice *slice){
+    int i;
+    free_Image(slice->image);
+    free(slice->pieces);
+    free(slice->quads);
+    for (i = 0; i < slice->numBakedRotations; i++){
+        free_Image(slice->bakedRotations[i]);
+    }
+    free(slice->bakedRotations);
+    if (slice->mips != NULL){
+        for (i = 0; i < STACK_SLICE_MIP_LEVELS - 1; i++){
+            free_Image(slice->mips[i].image);
+        }
+        free(slice->mips);
+    }
+}
+
+
+/////////////////////////////////////////////////
+// Loading
+/////////////////////////////////////////////////
+StackModel *loadStackModel(char *filename){
+    return loadModel(filename, 0, STACK_ENCODE_BAKED_SPANS);
+}
+
+StackModel *loadEditableStackModel(char *filename){
+    return loadModel(filename, 1, 0);
+}
+
+StackModel *loadModel(char *filename, int editable, int encodeSpans){
+    size_t length = strlen(filename);
+    if (length >= 4 && strcmp(filename + length - 4, ".vox") == 0){
+        StackModel *voxModel = loadVoxStackModel(filename);
+        buildStackModelLods(voxModel);
+        if (!editable){
+            trimStackModelSlices(voxModel, filename);
+            meshStackModelSlices(voxModel, filename);
+        }
+        buildStackModelMips(voxModel, filename);
+        if (encodeSpans){
+            encodeStackModelSpans(voxModel, filename);
+        }
+        return voxModel;
+    }
+    
+    cJSON *root = NULL;
+    char *fileContents = NULL;
+    int errorCount = 0;
+    
+    fileContents = readFileToString(filename);
+    root = cJSON_Parse(fileContents);
+    if (!root){
+        LOG_ERR("%s: Error before: %s\n", filename, cJSON_GetErrorPtr());
+        displayErrorAndExit("Encountered a problem when reading datafile %s", filename);
+    }
+    
+    StackModel *result = init_StackModel(malloc(sizeof(StackModel)));
+    char *sheet = cjson_readString(root, "sheet", &errorCount);
+    int numSlices = cjson_readInt(root, "slices", &errorCount);
+    int horizontal = cjson_readBoolean(root, "horizontal", &errorCount);
+    result->pivotX = cjson_readFloat(root, "pivot x", &errorCount);
+    result->pivotY = cjson_readFloat(root, "pivot y", &errorCount);
+    int sliceSpacing = cjson_readInt(root, "slice spacing", &errorCount);
+    int numFrames = cjson_readInt(root, "frames", &errorCount);
+    int bakeRotations = cjson_readBoolean(root, "bake rotations", &errorCount);
+    
+    if (errorCount > 0 || numSlices <= 0 || sliceSpacing <= 0 || numFrames <= 0){
+        LOG_ERR("Encountered a problem reading stack model %s", filename);
+        displayErrorAndExit("Encountered a problem when reading datafile %s", filename);
+    }
+    
+    /*
+     * Sheet slices all cover the whole footprint, and each is repeated for sliceSpacing layers.  A slice that's the
+     * same as the last frame's comes back as the same image, and becomes the same slice.
+     */
+    Image **images = loadImageSlicesFromFileSharingRepeats(sheet, numSlices * numFrames, horizontal, numSlices);
+    int *sheetSlices = malloc(sizeof(int) * numSlices * numFrames); //[frame * numSlices + slice in the frame], which of the model's slices it is
+    result->slices = malloc(sizeof(StackSlice) * numSlices * numFrames);
+    result->numSlices = 0;
+    int i;
+    StackSlice *slice;
+    for (i = 0; i < numSlices * numFrames; i++){
+        if (i >= numSlices && images[i] == images[i - numSlices]){
+            sheetSlices[i] = sheetSlices[i - numSlices];
+            continue;
+        }
+        
+        slice = result->slices + result->numSlices;
+        slice->image = images[i];
+        slice->offsetX = 0;
+        slice->offsetY = 0;
+        slice->pieces = NULL;
+        slice->numPieces = 0;
+        slice->quads = NULL;
+        slice->numQuads = 0;
+        slice->bakedRotations = NULL;
+        slice->numBakedRotations = 0;
+        slice->mips = NULL;
+        sheetSlices[i] = result->numSlices;
+        result->numSlices++;
+    }
+    free(images);
+    result->width = result->slices[0].image->width;
+    result->height = result->slices[0].image->height;
+    
+    result->numLayers = numSlices * sliceSpacing;
+    result->numFrames = numFrames;
+    result->layerSlices = malloc(sizeof(int) * result->numLayers * numFrames);
+    for (i = 0; i < result->numLayers * numFrames; i++){
+        result->layerSlices[i] = sheetSlices[((i / result->numLayers) * numSlices) + ((i % result->numLayers) / sliceSpacing)];
+    }
+    free(sheetSlices);
+    
+    cJSON_Delete(root);
+    free(fileContents);
+    
+    //an edit can uncover anything, and would have to redo every baked angle
+    buildStackModelLods(result);
+    if (!editable){
+        trimStackModelSlices(result, filename);
+    }
+    if (bakeRotations && !editable){
+        bakeStackModelRotations(result, filename);
+    }
+    if (!editable){
+        meshStackModelSlices(result, filename);
+    }
+    buildStackModelMips(result, filename);
+    if (encodeSpans){
+        encodeStackModelSpans(result, filename);
+    }
+    
+    if (numFrames > 1){
+        LOG_INF("Loaded stack model %s, %d frames keeping %d of %d %dx%d slices", filename, numFrames, result->numSlices, numSlices * numFrames, result->width, result->height);
+    } else {
+        LOG_INF("Loaded stack model %s, %d %dx%d slices", filename, result->numSlices, result->width, result->height);
+    }
+    return result;
+}
+
+
+void buildStackModelLods(StackModel *self){
+    /*
+     * Each level merges runs of full detail layers, so the coarse slices don't pick up the last level's rounding.
+     * A run made of the same slices as last frame's merges into the same thing, so it's shared the same way.
+     */
+    int lod, layer, frame, index, offsetX, offsetY;
+    int layersPerSlice;
+    StackModelLod *level;
+    Image *merged;
+    for (lod = 1; lod < STACK_MODEL_LOD_LEVELS; lod++){
+        level = self->lods + (lod - 1);
+        layersPerSlice = getStackLodLayersPerSlice(lod);
+        level->numLayers = (self->numLayers + layersPerSlice - 1) / layersPerSlice;
+        level->layerSlices = malloc(sizeof(int) * level->numLayers * self->numFrames);
+        level->slices = malloc(sizeof(StackSlice) * level->numLayers * self->numFrames);
+        level->numSlices = 0;
+        
+        for (index = 0; index < level->numLayers * self->numFrames; index++){
+            frame = index / level->numLayers;
+            layer = index % level->numLayers;
+            if (frame > 0 && sameLayersAsLastFrame(self, frame, layer * layersPerSlice, layersPerSlice)){
+                level->layerSlices[index] = level->layerSlices[index - level->numLayers];
+                continue;
+            }
+            
+            merged = mergeSlices(self, frame, layer * layersPerSlice, layersPerSlice, lod, &offsetX, &offsetY);
+            if (merged == NULL){
+                level->layerSlices[index] = -1;
+                continue;
+            }
+            
+            level->slices[level->numSlices].image = merged;
+            level->slices[level->numSlices].offsetX = offsetX;
+            level->slices[level->numSlices].offsetY = offsetY;
+            level->slices[level->numSlices].pieces = NULL;
+            level->slices[level->numSlices].numPieces = 0;
+            level->slices[level->numSlices].quads = NULL;
+            level->slices[level->numSlices].numQuads = 0;
+            level->slices[level->numSlices].bakedRotations = NULL;
+            level->slices[level->numSlices].numBakedRotations = 0;
+            level->slices[level->numSlices].mips = NULL;
+            level->layerSlices[index] = level->numSlices;
+            level->numSlices++;
+        }
+    }
+}
+
+int sameLayersAsLastFrame(const StackModel *self, int frame, int firstLayer, int numLayers){
+    int layer;
+    for (layer = firstLayer; layer < firstLayer + numLayers && layer < self->numLayers; layer++){
+        if (self->layerSlices[(frame * self->numLayers) + layer] != self->layerSlices[((frame - 1) * self->numLayers) + layer]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+Image *mergeSlices(const StackModel *self, int frame, int firstLayer, int numLayers, int lod, int *offsetX, int *offsetY){
+    /*
+     * Composites the slices of these layers bottom to top, the way they'd be drawn over each other, into one image
+     * covering all of them.  Returns NULL if none of the layers have anything in them.
+     */
+    int i;
+    const StackSlice *slice;
+    int left = 0, top = 0, right = 0, bottom = 0;
+    int found = 0;
+    for (i = firstLayer; i < firstLayer + numLayers; i++){
+        slice = getStackModelFrameSliceForLayer(self, frame, 0, i);
+        if (slice == NULL){
+            continue;
+        }
+        if (!found || slice->offsetX < left){
+            left = slice->offsetX;
+        }
+        if (!found || slice->offsetY < top){
+            top = slice->offsetY;
+        }
+        if (!found || slice->offsetX + slice->image->width > right){
+            right = slice->offsetX + slice->image->width;
+        }
+        if (!found || slice->offsetY + slice->image->height > bottom){
+            bottom = slice->offsetY + slice->image->height;
+        }
+        found = 1;
+    }
+    if (!found){
+        return NULL;
+    }
+    
+    int width = right - left;
+    int height = bottom - top;
+    Uint32 *pixels = malloc(sizeof(Uint32) * width * height);
+    ImageRect all = {left, top, width, height};
+    compositeLayers(self, frame, firstLayer, numLayers, lod, pixels, width, left, top, &all);
+    
+    Image *result = createImageFromPixels(width, height, pixels);
+    free(pixels);
+    *offsetX = left;
+    *offsetY = top;
+    return result;
+}
+
+void compositeLayers(const StackModel *self, int frame, int firstLayer, int numLayers, int lod, Uint32 *pixels, int stride, int left, int top, const ImageRect *region){
+    /*
+     * The merging itself, redone over just the region (in model coordinates) when a slice is edited.  pixels covers
+     * the merged slice, with its top left at (left, top), and the region has to be inside it.
+     */
+    int i, x, y, fromX, toX, fromY, toY;
+    const StackSlice *slice;
+    for (y = region->y; y < region->y + region->h; y++){
+        for (x = region->x; x < region->x + region->w; x++){
+            pixels[((y - top) * stride) + (x - left)] = 0;
+        }
+    }
+    
+    Uint32 src, dst;
+    int srcA, dstA, outA, channel, shift;
+    Uint32 out;
+    for (i = firstLayer; i < firstLayer + numLayers; i++){
+        slice = getStackModelFrameSliceForLayer(self, frame, 0, i);
+        if (slice == NULL){
+            continue;
+        }
+        fromX = (region->x > slice->offsetX) ? region->x - slice->offsetX : 0;
+        fromY = (region->y > slice->offsetY) ? region->y - slice->offsetY : 0;
+        toX = region->x + region->w - slice->offsetX;
+        toY = region->y + region->h - slice->offsetY;
+        toX = (toX > slice->image->width) ? slice->image->width : toX;
+        toY = (toY > slice->image->height) ? slice->image->height : toY;
+        
+        //straight alpha "over", same as SDL_BLENDMODE_BLEND but keeping the result's alpha right for drawing later
+        SDL_Surface *surface = slice->image->_surface;
+        for (y = fromY; y < toY; y++){
+            for (x = fromX; x < toX; x++){
+                src = ((Uint32 *)((Uint8 *)surface->pixels + (y * surface->pitch)))[x];
+                srcA = src & 0xFF;
+                if (srcA == 0){
+                    continue;
+                }
+                
+                Uint32 *target = pixels + ((slice->offsetY - top + y) * stride) + (slice->offsetX - left + x);
+                dst = *target;
+                dstA = dst & 0xFF;
+                outA = srcA + (dstA * (255 - srcA) + 127) / 255;
+                out = outA;
+                for (shift = 8; shift < 32; shift += 8){
+                    channel = (((src >> shift) & 0xFF) * srcA * 255 + ((dst >> shift) & 0xFF) * dstA * (255 - srcA)) / (outA * 255);
+                    out |= (Uint32)channel << shift;
+                }
+                *target = out;
+            }
+        }
+    }
+    
+    if (DEBUG_SHOW_STACK_LOD){
+        Uint32 *pixel;
+        for (y = region->y; y < region->y + region->h; y++){
+            for (x = region->x; x < region->x + region->w; x++){
+                pixel = pixels + ((y - top) * stride) + (x - left);
+                *pixel = (((((*pixel) >> 24) & 0xFF) * lodTints[lod][0] / 255) << 24)
+                    | (((((*pixel) >> 16) & 0xFF) * lodTints[lod][1] / 255) << 16)
+                    | (((((*pixel) >> 8) & 0xFF) * lodTints[lod][2] / 255) << 8)
+                    | ((*pixel) & 0xFF);
+            }
+        }
+    }
+}
+
+void trimStackModelSlices(StackModel *self, const char *name){
+    if (!STACK_TRIM_HIDDEN_SLICES){
+        return;
+    }
+    
+    //the merged levels are only drawn while their layers are close together, so less of them can be uncovered
+    int lod, before, after, dropped;
+    for (lod = 0; lod < STACK_MODEL_LOD_LEVELS; lod++){
+        if (lod == 0){
+            trimFrames(self->slices, self->numSlices, self->layerSlices, self->numLayers, self->numFrames, STACK_MAX_LAYER_SPACING, &before, &after, &dropped);
+        } else {
+            trimFrames(self->lods[lod - 1].slices, self->lods[lod - 1].numSlices, self->lods[lod - 1].layerSlices, self->lods[lod - 1].numLayers,
+                self->numFrames, STACK_LOD_LAYER_SPACING, &before, &after, &dropped
+            );
+        }
+        LOG_INF("Trimmed %s level %d: %d of %d pixels per copy of the stack drawn (%.0f%% less fill), %d empty layers dropped",
+            name, lod, after, before, (before > 0) ? 100.0 * (before - after) / before : 0.0, dropped
+        );
+    }
+}
+
+void trimFrames(StackSlice *slices, int numSlices, int *layerSlices, int numLayers, int numFrames, float layerSpacing, int *pixelsBefore, int *pixelsAfter, int *numDropped){
+    /*
+     * Every frame's layers end to end, with an empty layer between frames so the top of one frame isn't taken to be
+     * covered by the bottom of the next.  A slice shared between frames has to be hidden in all of them to go.
+     */
+    if (numFrames == 1){
+        trimSlices(slices, numSlices, layerSlices, numLayers, layerSpacing, pixelsBefore, pixelsAfter, numDropped);
+        return;
+    }
+    
+    int frame, layer;
+    int *joined = malloc(sizeof(int) * (numLayers + 1) * numFrames);
+    for (frame = 0; frame < numFrames; frame++){
+        for (layer = 0; layer < numLayers; layer++){
+            joined[(frame * (numLayers + 1)) + layer] = layerSlices[(frame * numLayers) + layer];
+        }
+        joined[(frame * (numLayers + 1)) + numLayers] = -1;
+    }
+    trimSlices(slices, numSlices, joined, (numLayers + 1) * numFrames, layerSpacing, pixelsBefore, pixelsAfter, numDropped);
+    
+    //dropped slices come back as -1
+    for (frame = 0; frame < numFrames; frame++){
+        for (layer = 0; layer < numLayers; layer++){
+            layerSlices[(frame * numLayers) + layer] = joined[(frame * (numLayers + 1)) + layer];
+        }
+    }
+    free(joined);
+}
+
+void trimSlices(StackSlice *slices, int numSlices, int *layerSlices, int numLayers, float layerSpacing, int *pixelsBefore, int *pixelsAfter, int *numDropped){
+    /*
+     * A layer is drawn layerSpacing or less above the one below, in whatever direction the camera angle makes "up",
+     * so a pixel can only ever be seen if the layer above has a see-through pixel within that distance of it.  A
+     * pixel counts as hidden when the layer above is solid over the whole square that far around it, plus a pixel
+     * for rounding where draws land.  Only the layer directly above is checked, which misses pixels hidden by
+     * layers further up, but is always safe.  A slice used at several layers has to be hidden at all of them.
+     */
+    int i, layer, x, y, above;
+    int reach = ceilf(layerSpacing) + 1;
+    int side = (reach * 2) + 1;
+    char **isHidden = calloc(numSlices, sizeof(char *)); //[slice][pixel], NULL until used
+    int **opaqueCounts = calloc(numSlices, sizeof(int *)); //[slice], summed area tables of opaque pixels, NULL until needed
+    const StackSlice *slice, *cover;
+    int left, top, right, bottom, count, stride;
+    
+    *pixelsBefore = 0;
+    *pixelsAfter = 0;
+    *numDropped = 0;
+    for (layer = 0; layer < numLayers; layer++){
+        if (layerSlices[layer] < 0){
+            continue;
+        }
+        slice = slices + layerSlices[layer];
+        *pixelsBefore += slice->image->width * slice->image->height;
+        if (isHidden[layerSlices[layer]] == NULL){
+            isHidden[layerSlices[layer]] = malloc(slice->image->width * slice->image->height);
+            memset(isHidden[layerSlices[layer]], 1, slice->image->width * slice->image->height);
+        }
+        above = (layer + 1 < numLayers) ? layerSlices[layer + 1] : -1;
+        if (above < 0){
+            memset(isHidden[layerSlices[layer]], 0, slice->image->width * slice->image->height);
+            continue;
+        }
+        
+        cover = slices + above;
+        if (opaqueCounts[above] == NULL){
+            opaqueCounts[above] = countOpaque(cover);
+        }
+        stride = cover->image->width + 1;
+        for (y = 0; y < slice->image->height; y++){
+            for (x = 0; x < slice->image->width; x++){
+                //the square around the pixel, in the covering slice's pixels, which has to be inside it to be solid
+                left = slice->offsetX + x - reach - cover->offsetX;
+                top = slice->offsetY + y - reach - cover->offsetY;
+                right = left + side;
+                bottom = top + side;
+                if (left < 0 || top < 0 || right > cover->image->width || bottom > cover->image->height){
+                    isHidden[layerSlices[layer]][(y * slice->image->width) + x] = 0;
+                    continue;
+                }
+                count = opaqueCounts[above][(bottom * stride) + right] - opaqueCounts[above][(top * stride) + right]
+                    - opaqueCounts[above][(bottom * stride) + left] + opaqueCounts[above][(top * stride) + left];
+                if (count < side * side){
+                    isHidden[layerSlices[layer]][(y * slice->image->width) + x] = 0;
+                }
+            }
+        }
+    }
+    
+    //now what's left to see of each slice, which is nothing if it was see-through or covered
+    char *isVisible;
+    SDL_Surface *surface;
+    int anyVisible;
+    for (i = 0; i < numSlices; i++){
+        if (isHidden[i] == NULL){
+            continue;
+        }
+        
+        surface = slices[i].image->_surface;
+        isVisible = isHidden[i];
+        anyVisible = 0;
+        for (y = 0; y < surface->h; y++){
+            for (x = 0; x < surface->w; x++){
+                isVisible[(y * surface->w) + x] = !isVisible[(y * surface->w) + x] && (((Uint32 *)((Uint8 *)surface->pixels + (y * surface->pitch)))[x] & 0xFF) != 0;
+                anyVisible |= isVisible[(y * surface->w) + x];
+            }
+        }
+        
+        if (anyVisible){
+            findPieces(slices + i, isVisible);
+            continue;
+        }
+        for (layer = 0; layer < numLayers; layer++){
+            if (layerSlices[layer] == i){
+                layerSlices[layer] = -1;
+                (*numDropped)++;
+            }
+        }
+    }
+    
+    for (layer = 0; layer < numLayers; layer++){
+        if (layerSlices[layer] < 0){
+            continue;
+        }
+        slice = slices + layerSlices[layer];
+        if (slice->pieces == NULL){
+            *pixelsAfter += slice->image->width * slice->image->height;
+            continue;
+        }
+        for (i = 0; i < slice->numPieces; i++){
+            *pixelsAfter += slice->pieces[i].w * slice->pieces[i].h;
+        }
+    }
+    
+    for (i = 0; i < numSlices; i++){
+        free(isHidden[i]);
+        free(opaqueCounts[i]);
+    }
+    free(isHidden);
+    free(opaqueCounts);
+}
+
+int *countOpaque(const StackSlice *slice){
+    //summed area table, [(y * (width+1)) + x] is how many fully opaque pixels are above and left of (x, y)
+    SDL_Surface *surface = slice->image->_surface;
+    int stride = surface->w + 1;
+    int *result = calloc(stride * (surface->h + 1), sizeof(int));
+    int x, y, isOpaque;
+    for (y = 0; y < surface->h; y++){
+        for (x = 0; x < surface->w; x++){
+            isOpaque = (((Uint32 *)((Uint8 *)surface->pixels + (y * surface->pitch)))[x] & 0xFF) == 0xFF;
+            result[((y+1) * stride) + x + 1] = isOpaque + result[(y * stride) + x + 1] + result[((y+1) * stride) + x] - result[(y * stride) + x];
+        }
+    }
+    return result;
+}
+
+void findPieces(StackSlice *slice, const char *isVisible){
+    /*
+     * Runs of visible pixels in each row, and rows with exactly the same runs as the row above just make that row's
+     * rectangles taller.  A hollowed out crate slice comes out as the 4 sides of a ring.
+     */
+    int width = slice->image->width;
+    int height = slice->image->height;
+    int x, y, k, runStart, matches;
+    int numOpen = 0; //the last numOpen pieces are still growing
+    int numPieces = 0;
+    int capacity = 0;
+    ImageRect *pieces = NULL;
+    int left = width, top = height, right = 0, bottom = 0;
+    ImageRect *rowRuns = malloc(sizeof(ImageRect) * ((width / 2) + 1));
+    int numRowRuns;
+    for (y = 0; y < height; y++){
+        numRowRuns = 0;
+        for (x = 0; x < width; x++){
+            if (!isVisible[(y * width) + x]){
+                continue;
+            }
+            runStart = x;
+            while (x < width && isVisible[(y * width) + x]){
+                x++;
+            }
+            rowRuns[numRowRuns].x = runStart;
+            rowRuns[numRowRuns].y = y;
+            rowRuns[numRowRuns].w = x - runStart;
+            rowRuns[numRowRuns].h = 1;
+            numRowRuns++;
+            left = (runStart < left) ? runStart : left;
+            right = (x > right) ? x : right;
+            top = (y < top) ? y : top;
+            bottom = y + 1;
+        }
+        
+        matches = numRowRuns == numOpen && numOpen > 0;
+        for (k = 0; k < numOpen && matches; k++){
+            matches = pieces[numPieces - numOpen + k].x == rowRuns[k].x && pieces[numPieces - numOpen + k].w == rowRuns[k].w;
+        }
+        if (matches){
+            for (k = 0; k < numOpen; k++){
+                pieces[numPieces - numOpen + k].h++;
+            }
+            continue;
+        }
+        
+        if (numPieces + numRowRuns > capacity){
+            capacity = (numPieces + numRowRuns) * 2;
+            pieces = realloc(pieces, sizeof(ImageRect) * capacity);
+        }
+        for (k = 0; k < numRowRuns; k++){
+            pieces[numPieces] = rowRuns[k];
+            numPieces++;
+        }
+        numOpen = numRowRuns;
+    }
+    free(rowRuns);
+    
+    //too ragged to be worth it, so just the bounds
+    if (numPieces > maxSlicePieces){
+        numPieces = 1;
+        pieces[0].x = left;
+        pieces[0].y = top;
+        pieces[0].w = right - left;
+        pieces[0].h = bottom - top;
+    }
+    
+    //nothing to trim
+    if (numPieces == 1 && pieces[0].w == width && pieces[0].h == height){
+        free(pieces);
+        return;
+    }
+    slice->pieces = pieces;
+    slice->numPieces = numPieces;
+}
+
+void bakeStackModelRotations(StackModel *self, const char *name){
+    //only the slices some layer still draws, at every level, and all of them or none so the model looks the same throughout
+    int lod, i, layer, numSlices, numLayers, isDrawn, pass;
+    int *layerSlices;
+    StackSlice *slices;
+    int numAngles = STACK_BAKED_ROTATION_ANGLES;
+    if (numAngles <= 0){
+        return;
+    }
+    
+    //first add up the cost, then bake if it fits
+    int totalBytes = 0;
+    for (pass = 0; pass < 2; pass++){
+        for (lod = 0; lod < STACK_MODEL_LOD_LEVELS; lod++){
+            slices = (lod == 0) ? self->slices : self->lods[lod - 1].slices;
+            numSlices = (lod == 0) ? self->numSlices : self->lods[lod - 1].numSlices;
+            layerSlices = (lod == 0) ? self->layerSlices : self->lods[lod - 1].layerSlices;
+            numLayers = getStackModelLodLayerCount(self, lod) * self->numFrames;
+            for (i = 0; i < numSlices; i++){
+                isDrawn = 0;
+                for (layer = 0; layer < numLayers && !isDrawn; layer++){
+                    isDrawn = layerSlices[layer] == i;
+                }
+                if (!isDrawn){
+                    continue;
+                }
+                
+                if (pass == 0){
+                    totalBytes += bakedSliceBytes(slices + i, numAngles);
+                } else {
+                    bakeSlice(slices + i, numAngles);
+                }
+            }
+        }
+        
+        if (pass == 0 && bakedRotationBytes + totalBytes > STACK_BAKED_ROTATION_BUDGET_KB * 1024){
+            LOG_WAR("Not baking rotations for %s, it needs %d KB and only %d of %d KB are left, so it'll rotate as it draws",
+                name, totalBytes / 1024, (STACK_BAKED_ROTATION_BUDGET_KB * 1024 - bakedRotationBytes) / 1024, STACK_BAKED_ROTATION_BUDGET_KB
+            );
+            return;
+        }
+    }
+    
+    bakedRotationBytes += totalBytes;
+    LOG_INF("Baked %s at %d angles, %d KB (%d of %d KB used)", name, numAngles, totalBytes / 1024, bakedRotationBytes / 1024, STACK_BAKED_ROTATION_BUDGET_KB);
+}
+
+int bakedSliceBytes(const StackSlice *slice, int numAngles){
+    //square, big enough for the slice at any angle
+    int size = ceilf(sqrtf((slice->image->width * slice->image->width) + (slice->image->height * slice->image->height))) + 2;
+    return size * size * 4 * numAngles;
+}
+
+void bakeSlice(StackSlice *slice, int numAngles){
+    /*
+     * The same sampling as the software renderer: for each pixel center of the rotated image, rotate back into the
+     * slice and take the texel there.  The slice's middle lands on the rotated image's middle.
+     */
+    SDL_Surface *surface = slice->image->_surface;
+    int width = surface->w;
+    int height = surface->h;
+    int size = ceilf(sqrtf((width * width) + (height * height))) + 2;
+    Uint32 *pixels = malloc(sizeof(Uint32) * size * size);
+    int step, x, y, u, v;
+    double radians, c, s, relativeX, relativeY;
+    
+    slice->bakedRotations = malloc(sizeof(Image *) * numAngles);
+    slice->numBakedRotations = numAngles;
+    for (step = 0; step < numAngles; step++){
+        radians = step * (2 * M_PI / numAngles);
+        c = cos(radians);
+        s = sin(radians);
+        for (y = 0; y < size; y++){
+            for (x = 0; x < size; x++){
+                relativeX = x + 0.5 - (size / 2.0);
+                relativeY = y + 0.5 - (size / 2.0);
+                u = floor((c * relativeX) + (s * relativeY) + (width / 2.0));
+                v = floor(-(s * relativeX) + (c * relativeY) + (height / 2.0));
+                if (u < 0 || v < 0 || u >= width || v >= height){
+                    pixels[(y * size) + x] = 0;
+                    continue;
+                }
+                pixels[(y * size) + x] = ((Uint32 *)((Uint8 *)surface->pixels + (v * surface->pitch)))[u];
+            }
+        }
+        slice->bakedRotations[step] = createImageFromPixels(size, size, pixels);
+    }
+    free(pixels);
+}
+
+void meshStackModelSlices(StackModel *self, const char *name){
+    if (!STACK_MESH_SLICES){
+        return;
+    }
+    
+    //baked slices are drawn unrotated from their own images, so quads would never be used
+    int lod, i, numSlices;
+    StackSlice *slices, *slice;
+    float before, after;
+    int meshed = 0;
+    int total = 0;
+    for (lod = 0; lod < STACK_MODEL_LOD_LEVELS; lod++){
+        slices = (lod == 0) ? self->slices : self->lods[lod - 1].slices;
+        numSlices = (lod == 0) ? self->numSlices : self->lods[lod - 1].numSlices;
+        for (i = 0; i < numSlices; i++){
+            slice = slices + i;
+            if (slice->bakedRotations != NULL){
+                continue;
+            }
+            total++;
+            before = slicePixelsDrawn(slice);
+            slice->quads = traceImageQuads(slice->image, slice->pieces, slice->numPieces, maxSliceQuads, &slice->numQuads);
+            if (slice->quads != NULL && imageQuadsArea(slice->quads, slice->numQuads) > before * (1 - minMeshSaving)){
+                free(slice->quads);
+                slice->quads = NULL;
+                slice->numQuads = 0;
+            }
+            if (slice->quads != NULL){
+                meshed++;
+            }
+        }
+    }
+    
+    //what one copy of the stack rasterizes at full detail, frame 0 like the trimming
+    before = 0;
+    after = 0;
+    for (i = 0; i < self->numLayers; i++){
+        if (self->layerSlices[i] < 0){
+            continue;
+        }
+        slice = self->slices + self->layerSlices[i];
+        before += slicePixelsDrawn(slice);
+        after += (slice->quads != NULL) ? imageQuadsArea(slice->quads, slice->numQuads) : slicePixelsDrawn(slice);
+    }
+    LOG_INF("Meshed %d of %d slices of %s: %.0f of %.0f pixels per copy of the stack rasterized (%.0f%% less fill)",
+        meshed, total, name, after, before, (before > 0) ? 100.0 * (before - after) / before : 0.0
+    );
+}
+
+float slicePixelsDrawn(const StackSlice *slice){
+    //without quads
+    int i;
+    float pixels = 0;
+    if (slice->pieces == NULL){
+        return (float)slice->image->width * slice->image->height;
+    }
+    for (i = 0; i < slice->numPieces; i++){
+        pixels += (float)slice->pieces[i].w * slice->pieces[i].h;
+    }
+    return pixels;
+}
+
+void buildStackModelMips(StackModel *self, const char *name){
+    //every slice, drawn or not, since it's cheap and the layers that use them can change with the level of detail
+    int lod, i, numSlices;
+    StackSlice *slices;
+    int totalBytes = 0;
+    for (lod = 0; lod < STACK_MODEL_LOD_LEVELS; lod++){
+        slices = (lod == 0) ? self->slices : self->lods[lod - 1].slices;
+        numSlices = (lod == 0) ? self->numSlices : self->lods[lod - 1].numSlices;
+        for (i = 0; i < numSlices; i++){
+            totalBytes += buildSliceMips(slices + i);
+        }
+    }
+    
+    LOG_INF("Built %d mip levels for %s, %d KB", STACK_SLICE_MIP_LEVELS - 1, name, totalBytes / 1024);
+}
+
+void encodeStackModelSpans(StackModel *self, const char *name){
+    /*
+     * Only the baked rotations.  They're always drawn unrotated, where a row of the image is a row of the render
+     * and the spans are walked straight through, and they're mostly transparent corners.  Rotated, each row of the
+     * render crosses a new row of the image every pixel or so and has to find its place in that row's spans again,
+     * which is slower than sampling the surface, so the slices and mips keep their pixels as they are.
+     */
+    int lod, i, k;
+    StackSlice *slices;
+    int numSlices;
+    int pixelBytes = 0;
+    int spanBytes = 0;
+    for (lod = 0; lod < STACK_MODEL_LOD_LEVELS; lod++){
+        slices = (lod == 0) ? self->slices : self->lods[lod - 1].slices;
+        numSlices = (lod == 0) ? self->numSlices : self->lods[lod - 1].numSlices;
+        for (i = 0; i < numSlices; i++){
+            for (k = 0; k < slices[i].numBakedRotations; k++){
+                encodeImage(slices[i].bakedRotations[k], &pixelBytes, &spanBytes);
+            }
+        }
+    }
+    
+    if (pixelBytes > 0){
+        LOG_INF("Encoded %s's baked rotations as spans, %d KB of pixels down to %d KB", name, pixelBytes / 1024, spanBytes / 1024);
+    }
+}
+
+void encodeImage(Image *image, int *pixelBytes, int *spanBytes){
+    //the surface's pixels, leaving out SDL's bookkeeping
+    if (image->_surface == NULL){
+        return;
+    }
+    *pixelBytes += image->_surface->h * image->_surface->pitch;
+    encodeImageSpans(image, NULL, 0, 0);
+    *spanBytes += imageSpansBytes(image->_spans);
+}
+
+int buildSliceMips(StackSlice *slice){
+    /*
+     * Each level from the one before, so the blocks nest.  An odd offset gets a transparent column or row in front
+     * so the blocks stay lined up with the model's top left, then the offset halves exactly.  Returns the bytes used.
+     */
+    int level, padX, padY;
+    Image *source = slice->image;
+    int offsetX = slice->offsetX;
+    int offsetY = slice->offsetY;
+    int bytes = 0;
+    
+    slice->mips = malloc(sizeof(StackSliceMip) * (STACK_SLICE_MIP_LEVELS - 1));
+    for (level = 0; level < STACK_SLICE_MIP_LEVELS - 1; level++){
+        padX = offsetX & 1;
+        padY = offsetY & 1;
+        offsetX = (offsetX - padX) / 2;
+        offsetY = (offsetY - padY) / 2;
+        slice->mips[level].image = createHalfSizeImage(source, padX, padY);
+        slice->mips[level].offsetX = offsetX;
+        slice->mips[level].offsetY = offsetY;
+        source = slice->mips[level].image;
+        bytes += source->width * source->height * 4;
+    }
+    return bytes;
+}
+
+
+
+/////////////////////////////////////////////////
+// Editing
+/////////////////////////////////////////////////
+int refreshStackModelSlice(StackModel *self, int slice, const ImageRect *rect){
+    /*
+     * Only the rect is redone in everything made from the slice: its texture, its mips, and the coarser slices
+     * merged from it (and their textures and mips).  Returns how many pixels went up to textures.
+     */
+    int lod, index, frame, layer, layersPerSlice;
+    StackModelLod *level;
+    StackSlice *merged;
+    ImageRect local;
+    int uploaded = refreshSliceTextures(self->slices + slice, rect);
+    self->version++;
+    
+    //in model coordinates, which the merged slices always cover since they cover every slice merged into them
+    ImageRect region = {rect->x + self->slices[slice].offsetX, rect->y + self->slices[slice].offsetY, rect->w, rect->h};
+    for (lod = 1; lod < STACK_MODEL_LOD_LEVELS; lod++){
+        level = self->lods + (lod - 1);
+        layersPerSlice = getStackLodLayersPerSlice(lod);
+        for (index = 0; index < level->numLayers * self->numFrames; index++){
+            frame = index / level->numLayers;
+            layer = index % level->numLayers;
+            //merged slices shared with the last frame were already done
+            if (level->layerSlices[index] < 0 || (frame > 0 && level->layerSlices[index] == level->layerSlices[index - level->numLayers])){
+                continue;
+            }
+            if (!usesSlice(self, frame, layer * layersPerSlice, layersPerSlice, slice)){
+                continue;
+            }
+            
+            merged = level->slices + level->layerSlices[index];
+            SDL_Surface *surface = merged->image->_surface;
+            compositeLayers(self, frame, layer * layersPerSlice, layersPerSlice, lod, surface->pixels, surface->pitch / 4, merged->offsetX, merged->offsetY, &region);
+            local.x = region.x - merged->offsetX;
+            local.y = region.y - merged->offsetY;
+            local.w = region.w;
+            local.h = region.h;
+            uploaded += refreshSliceTextures(merged, &local);
+        }
+    }
+    return uploaded;
+}
+
+int usesSlice(const StackModel *self, int frame, int firstLayer, int numLayers, int slice){
+    int layer;
+    for (layer = firstLayer; layer < firstLayer + numLayers && layer < self->numLayers; layer++){
+        if (self->layerSlices[(frame * self->numLayers) + layer] == slice){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int refreshSliceTextures(StackSlice *slice, const ImageRect *rect){
+    //down the mip chain the same way buildSliceMips went, each level's changes from the one before
+    int level, padX, padY;
+    int offsetX = slice->offsetX;
+    int offsetY = slice->offsetY;
+    Image *source = slice->image;
+    ImageRect changed = *rect;
+    ImageRect halfChanged;
+    
+    updateImageTexture(slice->image, rect);
+    int uploaded = rect->w * rect->h;
+    if (slice->bakedRotations != NULL){
+        LOG_WAR("Edited a stack slice with baked rotations, they'll be out of date");
+    }
+    if (slice->mips == NULL){
+        return uploaded;
+    }
+    
+    for (level = 0; level < STACK_SLICE_MIP_LEVELS - 1 && changed.w > 0 && changed.h > 0; level++){
+        padX = offsetX & 1;
+        padY = offsetY & 1;
+        offsetX = (offsetX - padX) / 2;
+        offsetY = (offsetY - padY) / 2;
+        updateHalfSizeImage(slice->mips[level].image, source, padX, padY, &changed, &halfChanged);
+        uploaded += halfChanged.w * halfChanged.h;
+        changed = halfChanged;
+        source = slice->mips[level].image;
+    }
+    return uploaded;
+}
+
+
+/////////////////////////////////////////////////
+// Access
+/////////////////////////////////////////////////
+int getStackModelLayerCount(const StackModel *self){
+    return self->numLayers;
+}
+
+int getStackModelFrameCount(const StackModel *self){
+    return self->numFrames;
+}
+
+const StackSlice *getStackModelSliceForLayer(const StackModel *self, int layer){
+    return getStackModelFrameSliceForLayer(self, 0, 0, layer);
+}
+
+int getStackModelLodLayerCount(const StackModel *self, int lod){
+    if (lod <= 0){
+        return self->numLayers;
+    }
+    return self->lods[lod - 1].numLayers;
+}
+
+const StackSlice *getStackModelLodSliceForLayer(const StackModel *self, int lod, int layer){
+    return getStackModelFrameSliceForLayer(self, 0, lod, layer);
+}
+
+const StackSlice *getStackModelFrameSliceForLayer(const StackModel *self, int frame, int lod, int layer){
+    frame %= self->numFrames;
+    frame = (frame < 0) ? frame + self->numFrames : frame;
+    if (lod <= 0){
+        if (layer < 0 || layer >= self->numLayers || self->layerSlices[(frame * self->numLayers) + layer] < 0){
+            return NULL;
+        }
+        return self->slices + self->layerSlices[(frame * self->numLayers) + layer];
+    }
+    
+    const StackModelLod *level = self->lods + (lod - 1);
+    if (layer < 0 || layer >= level->numLayers || level->layerSlices[(frame * level->numLayers) + layer] < 0){
+        return NULL;
+    }
+    return level->slices + level->layerSlices[(frame * level->numLayers) + layer];
+}
+
+Image *getBakedStackSlice(const StackSlice *slice, float angle){
+    if (slice->bakedRotations == NULL){
+        return NULL;
+    }
+    
+    int step = (int)floorf((angle * slice->numBakedRotations / 360) + 0.5f) % slice->numBakedRotations;
+    step = (step < 0) ? step + slice->numBakedRotations : step;
+    return slice->bakedRotations[step];
+}
+
+Image *getStackSliceMip(const StackSlice *slice, int level, int *offsetX, int *offsetY){
+    if (level <= 0){
+        *offsetX = slice->offsetX;
+        *offsetY = slice->offsetY;
+        return slice->image;
+    }
+    if (level >= STACK_SLICE_MIP_LEVELS || slice->mips == NULL){
+        return NULL;
+    }
+    
+    *offsetX = slice->mips[level - 1].offsetX;
+    *offsetY = slice->mips[level - 1].offsetY;
+    return slice->mips[level - 1].image;
+}
+
+int getStackLodLayersPerSlice(int lod){
+    return 1 << lod;
+}
+
+int chooseStackModelLod(float layerSpacing){
+    //the coarsest level whose merged layers still land no further apart than the configured spacing
+    if (!STACK_USE_LOD){
+        return 0;
+    }
+    
+    int lod = 0;
+    while (lod + 1 < STACK_MODEL_LOD_LEVELS && getStackLodLayersPerSlice(lod + 1) * layerSpacing <= STACK_LOD_LAYER_SPACING){
+        lod++;
+    }
+    return lod;
+}
+
+
+/////////////////////////////////////////////////
+// Benchmark
+/////////////////////////////////////////////////
+void benchmarkStackModelSpans(char *filename){
+    /*
+     * Loads its own copy of the model, draws it a few times over with the software renderer from its baked
+     * rotations' pixels, then encodes it and draws the same again from the spans.  Only the rasterizing is timed,
+     * from when the draws are queued to when the bands are done.  The copy is freed straight after, so it doesn't
+     * count against the baking budget.
+     */
+    int ownRenderer = getSoftwareRenderSurface() == NULL;
+    if (ownRenderer){
+        initSoftwareRenderer(SCREEN_WIDTH, SCREEN_HEIGHT, STACK_SOFTWARE_RENDERER_THREADS);
+    }
+    int budgetUsed = bakedRotationBytes;
+    bakedRotationBytes = 0;
+    startBatchingLoadedImages();
+    StackModel *model = loadModel(filename, 0, 0);
+    ImageAtlas *atlas = stopBatchingLoadedImages();
+    bakedRotationBytes = budgetUsed;
+    
+    Uint64 ticks[2] = {0, 0};
+    Uint64 start;
+    int pass, frame, i;
+    int isBaked = 0;
+    for (i = 0; i < model->numSlices; i++){
+        isBaked |= model->slices[i].bakedRotations != NULL;
+    }
+    if (!isBaked){
+        LOG_WAR("Span benchmark needs %s to be baked, and it isn't", filename);
+    }
+    for (pass = 0; pass < 2 && isBaked; pass++){
+        if (pass == 1){
+            encodeStackModelSpans(model, filename);
+        }
+        for (frame = 0; frame < benchmarkFrames; frame++){
+            start = SDL_GetPerformanceCounter();
+            clearSoftwareRender(0, 0, 0, 0);
+            drawBenchmarkStacks(model);
+            runSoftwareRenderPass(&finishBenchmarkFrame, NULL);
+            ticks[pass] += SDL_GetPerformanceCounter() - start;
+        }
+    }
+    
+    if (ticks[1] > 0){
+        double milliseconds = 1000.0 / SDL_GetPerformanceFrequency() / benchmarkFrames;
+        LOG_INF("Span benchmark, %s drawn %d times on %s: %.2f ms a frame from pixels, %.2f ms from spans (%.1fx)",
+            filename, benchmarkAngles, getSoftwareRendererInstructionSet(), ticks[0] * milliseconds, ticks[1] * milliseconds, (double)ticks[0] / ticks[1]
+        );
+    }
+    
+    free_StackModel(model);
+    free_ImageAtlas(atlas);
+    if (ownRenderer){
+        termSoftwareRenderer();
+    }
+}
+
+void drawBenchmarkStacks(const StackModel *model){
+    //a row of copies across the render at full detail, each at its own angle, placing the baked slices like drawSlice
+    SDL_Surface *target = getSoftwareRenderSurface();
+    const StackSlice *slice;
+    Image *baked;
+    float angle, radians, c, s, x, y;
+    int copy, layer;
+    for (copy = 0; copy < benchmarkAngles; copy++){
+        angle = copy * (360.0f / benchmarkAngles);
+        radians = angle * (M_PI / 180.0);
+        c = cosf(radians);
+        s = sinf(radians);
+        for (layer = 0; layer < model->numLayers; layer++){
+            slice = getStackModelSliceForLayer(model, layer);
+            if (slice == NULL){
+                continue;
+            }
+            baked = getBakedStackSlice(slice, angle);
+            if (baked == NULL){
+                continue;
+            }
+            x = ((copy + 0.5f) * target->w / benchmarkAngles) + (c * (slice->offsetX + slice->image->width / 2.0f)) - (s * (slice->offsetY + slice->image->height / 2.0f));
+            y = (target->h * 0.75f) - layer + (s * (slice->offsetX + slice->image->width / 2.0f)) + (c * (slice->offsetY + slice->image->height / 2.0f));
+            softwareDrawImagePreRotated(baked, NULL, roundf(x - (baked->width / 2.0f)), roundf(y - (baked->height / 2.0f)), 0);
+        }
+    }
+}
+
+void finishBenchmarkFrame(Uint32 *pixels, int pitch, int width, int top, int bottom, void *data){
+    //nothing to add, running a pass just gets the queued draws rasterized without sending them to a texture
+}
@@ -0,0 +1,183 @@
+#ifndef STACK_MODEL_H
+#define STACK_MODEL_H
+
+#include "graphics.h"
+
+/*
+ * A sprite stack: a pile of horizontal slices drawn bottom to top, each one offset upward by a layer, so that
+ * together they look like a 3d object when rotated.
+ *
+ * Models are loaded from a small descriptor (JSON, like the other data files) that points at a slice sheet:
+ *   {
+ *       "sheet" : "gfx/crate_sheet.png",  the slices, equally sized, bottom slice first
+ *       "slices" : 10,
+ *       "horizontal" : false,              true if the slices go left to right instead of top to bottom
+ *       "pivot x" : 8,                     the point in a slice that sits at the model's position and is rotated
+ *       "pivot y" : 8,                     about, in pixels from the top left
+ *       "slice spacing" : 1,               layers per slice, so low detail models can use fewer slices
+ *       "frames" : 1,                      animation frames, the sheet has every slice of frame 0, then frame 1...
+ *       "bake rotations" : true            pre-rotate the slices when loading, see below
+ *   }
+ *
+ * Animated models (a fan spinning, a door opening) have a full set of layers per frame, and an object picks its
+ * frame the way drawAnimation picks a sprite's, from its Animation's sprite index.  Usually only a few slices
+ * change from one frame to the next, so a slice that's the same as the last frame's is kept once and both frames'
+ * layers point at it.  The levels of detail, trimming, baking and mips all work on the shared slices, so memory
+ * and atlas space grow with what changes rather than with frames x layers.
+ *
+ * Models can also be loaded straight from MagicaVoxel .vox files, see vox_loader.h.  Those slices are cropped to
+ * what's actually in them, so a slice carries its offset from the model's top left, and layers with nothing in
+ * them have no slice at all.
+ *
+ * Every model also gets coarser levels of detail when it's loaded, where each layer is a few of the full detail
+ * layers merged into one slice (2 at level 1, 4 at level 2).  Once the layers are packed closer together in the
+ * buffer than a pixel or so, drawing them all is mostly wasted, so chooseStackModelLod picks a level from how far
+ * apart layers land and the coarse slices are drawn instead, with the gaps filled as if the layers were thicker.
+ *
+ * Most of a solid model is never seen - the inside of a crate's lower layers is always under the layer above it,
+ * whatever the angle or pitch.  So once a model is loaded, each slice works out which of its pixels could ever
+ * show, from how far the layer above can slide over it (layers are at most STACK_MAX_LAYER_SPACING apart, or
+ * STACK_LOD_LAYER_SPACING at the coarser levels), and keeps a few rectangles of the image covering just those.
+ * Drawing only those pieces skips the hidden interior.  Slices with nothing left to show are dropped entirely.
+ *
+ * Rotating an image every draw is slow on some of SDL's renderers, much slower than a plain copy.  Models that ask
+ * for it have every slice baked at STACK_BAKED_ROTATION_ANGLES evenly spaced angles when they're loaded, each into
+ * its own image with the slice rotated about its middle, and those are drawn unrotated at the nearest angle
+ * instead.  Baking stops once STACK_BAKED_ROTATION_BUDGET_KB is used up, and later models rotate as they draw.
+ * Voxel models have no descriptor to ask with, so they always rotate as they draw.
+ *
+ * Zoomed out, a slice covers a fraction of the pixels it has, so drawing it at full size and letting it shrink
+ * wastes fill and shimmers as it moves.  Every slice gets a chain of mips when it's loaded, each box filtered down
+ * to half the last, and the stack frame draws the level that matches the zoom one to one.  A mip's offset is in
+ * its own pixels, with the blocks lined up on the model's top left rather than the slice's, so slices cropped to
+ * an odd offset still land where they should.
+ *
+ * Trimming leaves rectangles, and the round or diagonal edges of a slice still cover plenty of transparent pixels
+ * the renderer blends anyway.  So each slice that's drawn rotated also traces the solid pixels of its pieces into a
+ * few convex quads, a run of rows whose ends move the same amount each row becoming one trapezoid, and is drawn
+ * through those with SDL_RenderGeometry, sharing the batch the rotated quads already go in.  A slice keeps its
+ * quads only if they cover at least an eighth less than its pieces, and takes too many to be worth it otherwise.
+ *
+ * Models can be changed while the game runs, for props that get knocked apart, see stack_edit.h.  Those are loaded
+ * with loadEditableStackModel, which leaves out the trimming and baking, since an edit can uncover any pixel and
+ * would have to redo every baked angle.  After a full detail slice's pixels change, refreshStackModelSlice redoes
+ * only the changed rect of everything made from it.
+ *
+ * Every slice is its own Image, so load models between startBatchingLoadedImages and stopBatchingLoadedImages
+ * and they'll be packed into shared atlas pages, letting a whole scene of models draw from a texture or two.
+ * The slices keep their pixels so the software renderer can draw them too.  With STACK_ENCODE_BAKED_SPANS, the
+ * baked rotations keep theirs as runs of solid pixels a row at a time instead (see encodeImageSpans), which leaves
+ * out their transparent corners, and the software renderer draws them unrotated by jumping from one run to the
+ * next rather than sampling every texel.
+ */
+
+#define STACK_MODEL_LOD_LEVELS 3 //full detail, then 2 and 4 layers merged
+#define STACK_MAX_LAYER_SPACING 3 //model pixels, the furthest apart layers are ever drawn (the stack frame's largest pitch)
+#define STACK_SLICE_MIP_LEVELS 3 //full size, then a half and a quarter
+
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+typedef struct StackSliceMip{
+    Image *image;
+    //like the slice's, in pixels of this level
+    int offsetX;
+    int offsetY;
+} StackSliceMip;
+
+typedef struct StackSlice{
+    Image *image;
+    //where the image's top left sits relative to the model's top left
+    int offsetX;
+    int offsetY;
+    //the parts of the image that can ever be seen, NULL to draw all of it
+    ImageRect *pieces; //array
+    int numPieces;
+    //outlines of what's solid in the pieces, NULL to draw the pieces; only for the hardware renderer
+    ImageQuad *quads; //array
+    int numQuads;
+    //the slice rotated about its middle to each baked angle, clockwise from 0, NULL if the model isn't baked
+    Image **bakedRotations; //array [angle step]
+    int numBakedRotations;
+    StackSliceMip *mips; //array [level - 1], each half the size of the one before, NULL until buildStackModelMips
+} StackSlice;
+
+typedef struct StackModelLod{
+    StackSlice *slices; //array [slice], one per merged layer that has anything in it, shared between frames like StackModel's
+    int numSlices;
+    int *layerSlices; //array [frame * numLayers + merged layer], like StackModel's
+    int numLayers;
+} StackModelLod;
+
+typedef struct StackModel{
+    StackSlice *slices; //array [slice], bottom first, frame by frame, without the ones repeated from the frame before
+    int numSlices;
+    int *layerSlices; //array [frame * numLayers + layer], index of the slice drawn at each layer, -1 for nothing
+    int numLayers; //in each frame
+    int numFrames; //1 for a model that doesn't animate
+    //size of the model's footprint, which every slice fits inside
+    int width;
+    int height;
+    float pivotX;
+    float pivotY;
+    int version; //changes whenever the slices are edited, for anything made from them
+    StackModelLod lods[STACK_MODEL_LOD_LEVELS - 1]; //levels 1 and up, level 0 is the model itself
+} StackModel;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackModel *init_StackModel(StackModel *self);
+void free_StackModel(StackModel *self);
+
+
+/////////////////////////////////////////////////
+// Loading
+/////////////////////////////////////////////////
+StackModel *loadStackModel(char *filename); //a descriptor, or a .vox file; crashes the game if the file or sheet can't be read
+StackModel *loadEditableStackModel(char *filename); //the same, but never trimmed or baked
+void buildStackModelLods(StackModel *self); //loadStackModel does this, only needed for models put together by hand
+void trimStackModelSlices(StackModel *self, const char *name); //same, after building the levels of detail; name is for logging
+void bakeStackModelRotations(StackModel *self, const char *name); //only done when a model's descriptor asks for it
+void meshStackModelSlices(StackModel *self, const char *name); //after trimming, skipping baked slices
+void buildStackModelMips(StackModel *self, const char *name); //loadStackModel does this last, at every level of detail
+void encodeStackModelSpans(StackModel *self, const char *name); //then this, if STACK_ENCODE_BAKED_SPANS; frees the baked rotations' surfaces
+
+
+/////////////////////////////////////////////////
+// Editing
+/////////////////////////////////////////////////
+//after changing rect of a full detail slice's pixels, redoes that part of its texture, its mips, and the coarser
+//levels merged from it; returns the number of pixels sent to textures
+int refreshStackModelSlice(StackModel *self, int slice, const ImageRect *rect);
+
+
+/////////////////////////////////////////////////
+// Access
+/////////////////////////////////////////////////
+int getStackModelLayerCount(const StackModel *self);
+int getStackModelFrameCount(const StackModel *self);
+const StackSlice *getStackModelSliceForLayer(const StackModel *self, int layer); //NULL if the model has nothing at that layer, always frame 0
+//the same at a level of detail, where layer n covers full detail layers n * getStackLodLayersPerSlice(lod) onward
+int getStackModelLodLayerCount(const StackModel *self, int lod);
+const StackSlice *getStackModelLodSliceForLayer(const StackModel *self, int lod, int layer);
+//the same in a frame of the model's animation, frames past the last wrap around
+const StackSlice *getStackModelFrameSliceForLayer(const StackModel *self, int frame, int lod, int layer);
+int getStackLodLayersPerSlice(int lod);
+Image *getBakedStackSlice(const StackSlice *slice, float angle); //the baked rotation nearest the angle, NULL if not baked
+//level 0 is the slice itself, NULL if the level is past STACK_SLICE_MIP_LEVELS or the mips weren't built
+Image *getStackSliceMip(const StackSlice *slice, int level, int *offsetX, int *offsetY);
+//the level to draw at when layers are this many buffer pixels apart, always 0 if level of detail is turned off
+int chooseStackModelLod(float layerSpacing);
+
+
+/////////////////////////////////////////////////
+// Benchmark
+/////////////////////////////////////////////////
+//loads its own copy of the model and logs how long the software renderer takes to draw it from its baked rotations'
+//pixels and from their spans; starts the software renderer for itself if it isn't running
+void benchmarkStackModelSpans(char *filename);
+
+#endif
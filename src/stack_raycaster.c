@@ -0,0 +1,258 @@
+#include "stack_raycaster.h"
+#include "software_renderer.h"
+#include "logging.h"
+#include <math.h>
+#include <stdlib.h>
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+/*
+ * Each column's ray, worked out once a frame for every band to share.  A buffer pixel's position in the grid is
+ * its column's start plus its depth (buffer y relative to the pivot, plus however far up its layer was lifted)
+ * times the step.
+ */
+typedef struct RaycastFrame{
+    const StackVoxelGrid *grid;
+    const StackRaycastView *view;
+    float *columnX; //array [buffer x]
+    float *columnY; //array [buffer x]
+    float stepX;
+    float stepY;
+} RaycastFrame;
+
+
+/////////////////////////////////////////////////
+// statics
+/////////////////////////////////////////////////
+static void raycastBand(Uint32 *pixels, int pitch, int width, int top, int bottom, void *data);
+
+static RaycastFrame frame = {NULL, NULL, NULL, NULL, 0, 0};
+static int columnCapacity = 0;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackVoxelGrid *init_StackVoxelGrid(StackVoxelGrid *self, int left, int top, int width, int height, int numLayers){
+    self->left = left;
+    self->top = top;
+    self->width = width;
+    self->height = height;
+    self->numLayers = numLayers;
+    self->numFilled = 0;
+    self->voxels = calloc((size_t)width * height * numLayers, sizeof(Uint32));
+    self->heights = calloc((size_t)width * height, sizeof(Uint16));
+    
+    return self;
+}
+
+void free_StackVoxelGrid(StackVoxelGrid *self){
+    if (self == NULL){
+        LOG_WAR("Tried to free NULL StackVoxelGrid");
+        return;
+    }
+    
+    free(self->voxels);
+    free(self->heights);
+    
+    free(self);
+}
+
+
+/////////////////////////////////////////////////
+// Building
+/////////////////////////////////////////////////
+void addStackObjectVoxels(StackVoxelGrid *self, const StackObject *obj){
+    int layer, x, y, gridX, gridY, cell;
+    Uint32 pixel;
+    const StackSlice *slice;
+    SDL_Surface *surface;
+    //the stacks sample at pixel centers, so this is the whole pixel the model's top left lands nearest
+    int left = (int)floorf(obj->x - obj->model->pivotX + 0.5f) - self->left;
+    int top = (int)floorf(obj->y - obj->model->pivotY + 0.5f) - self->top;
+    
+    for (layer = 0; layer < getStackModelLayerCount(obj->model) && layer < self->numLayers; layer++){
+        slice = getStackModelSliceForLayer(obj->model, layer);
+        if (slice == NULL){
+            continue;
+        }
+        surface = slice->image->_surface;
+        if (surface == NULL){
+            LOG_WAR("Stack slice has no pixels to make voxels from");
+            continue;
+        }
+        
+        for (y = 0; y < surface->h; y++){
+            gridY = top + slice->offsetY + y;
+            if (gridY < 0 || gridY >= self->height){
+                continue;
+            }
+            for (x = 0; x < surface->w; x++){
+                gridX = left + slice->offsetX + x;
+                pixel = ((Uint32 *)((Uint8 *)surface->pixels + (y * surface->pitch)))[x];
+                if (gridX < 0 || gridX >= self->width || (pixel & 0xFF) == 0){
+                    continue;
+                }
+                
+                cell = (gridY * self->width) + gridX;
+                if (self->voxels[((size_t)layer * self->height * self->width) + cell] == 0){
+                    self->numFilled++;
+                }
+                //later objects win, like they would drawing
+                self->voxels[((size_t)layer * self->height * self->width) + cell] = pixel;
+                if (self->heights[cell] <= layer){
+                    self->heights[cell] = layer + 1;
+                }
+            }
+        }
+    }
+}
+
+StackVoxelGrid *buildStackVoxelGrid(StackWorld *world, int budgetKb){
+    int i, k;
+    int hasObjects = 0;
+    float minX = 0;
+    float minY = 0;
+    float maxX = 0;
+    float maxY = 0;
+    StackChunk *chunk;
+    
+    //the footprints of everything, which the chunks already keep
+    for (i = 0; i < world->chunksWide * world->chunksHigh; i++){
+        chunk = world->chunks + i;
+        if (chunk->numObjects == 0){
+            continue;
+        }
+        if (!hasObjects || chunk->minX < minX){
+            minX = chunk->minX;
+        }
+        if (!hasObjects || chunk->minY < minY){
+            minY = chunk->minY;
+        }
+        if (!hasObjects || chunk->maxX > maxX){
+            maxX = chunk->maxX;
+        }
+        if (!hasObjects || chunk->maxY > maxY){
+            maxY = chunk->maxY;
+        }
+        hasObjects = 1;
+    }
+    if (!hasObjects){
+        LOG_WAR("No objects to build a voxel grid from");
+        return NULL;
+    }
+    
+    //a pixel of room either side for the rounding in addStackObjectVoxels
+    int left = (int)floorf(minX) - 1;
+    int top = (int)floorf(minY) - 1;
+    int width = (int)ceilf(maxX) + 1 - left;
+    int height = (int)ceilf(maxY) + 1 - top;
+    double kb = ((double)width * height * ((world->numLayers * sizeof(Uint32)) + sizeof(Uint16))) / 1024;
+    if (kb > budgetKb){
+        LOG_WAR("A %dx%dx%d voxel grid needs %.0f kb, more than the %d kb allowed, so the world will be drawn as stacks", width, height, world->numLayers, kb, budgetKb);
+        return NULL;
+    }
+    
+    StackVoxelGrid *result = init_StackVoxelGrid(malloc(sizeof(StackVoxelGrid)), left, top, width, height, world->numLayers);
+    for (i = 0; i < world->chunksWide * world->chunksHigh; i++){
+        chunk = world->chunks + i;
+        for (k = 0; k < chunk->numObjects; k++){
+            addStackObjectVoxels(result, chunk->objects + k);
+        }
+    }
+    LOG_INF("Built a %dx%dx%d voxel grid, %.0f kb, %d voxels filled from %d objects", width, height, world->numLayers, kb, result->numFilled, world->numObjects);
+    
+    return result;
+}
+
+
+/////////////////////////////////////////////////
+// Drawing
+/////////////////////////////////////////////////
+void raycastStackVoxels(const StackVoxelGrid *self, const StackRaycastView *view){
+    SDL_Surface *target = getSoftwareRenderSurface();
+    int x;
+    
+    if (target->w > columnCapacity){
+        columnCapacity = target->w;
+        frame.columnX = realloc(frame.columnX, sizeof(float) * columnCapacity);
+        frame.columnY = realloc(frame.columnY, sizeof(float) * columnCapacity);
+    }
+    
+    /*
+     * Undoing the rotation the stacks are drawn with: a buffer position relative to the pivot, (dx, depth), came
+     * from the world position camera + (c*dx + s*depth, -s*dx + c*depth) / zoom.  dx is fixed for a column.
+     */
+    float radians = view->angle * (M_PI / 180.0);
+    float c = cosf(radians);
+    float s = sinf(radians);
+    float dx;
+    for (x = 0; x < target->w; x++){
+        dx = (((x + 0.5f) / view->scaling) - view->pivotX) / view->zoom;
+        frame.columnX[x] = view->cameraX + (c * dx) - self->left;
+        frame.columnY[x] = view->cameraY - (s * dx) - self->top;
+    }
+    frame.stepX = s / view->zoom;
+    frame.stepY = c / view->zoom;
+    frame.grid = self;
+    frame.view = view;
+    
+    runSoftwareRenderPass(&raycastBand, &frame);
+}
+
+void raycastBand(Uint32 *pixels, int pitch, int width, int top, int bottom, void *data){
+    const RaycastFrame *ray = data;
+    const StackVoxelGrid *grid = ray->grid;
+    const StackRaycastView *view = ray->view;
+    const int layerSize = grid->width * grid->height;
+    int x, y, layer, copy, cell;
+    float depth, baseDepth, gridX, gridY;
+    Uint32 color, voxel;
+    Uint32 *row;
+    
+    //each pixel of a row is a step along its own column's ray, so rows can be written in order
+    for (y = (top > view->firstRow) ? top : view->firstRow; y < bottom; y++){
+        row = pixels + (y * pitch);
+        baseDepth = ((y + 0.5f) / view->scaling) - view->pivotY;
+        for (x = 0; x < width; x++){
+            color = view->clearColor;
+            
+            //the highest layer wins, and within a layer the highest copy, same as the order the stacks draw in
+            for (layer = grid->numLayers - 1; layer >= 0; layer--){
+                for (copy = view->copies - 1; copy >= 0; copy--){
+                    depth = baseDepth + (layer * view->layerPitch) + copy;
+                    gridX = ray->columnX[x] + (depth * ray->stepX);
+                    gridY = ray->columnY[x] + (depth * ray->stepY);
+                    if (gridX < 0 || gridY < 0 || gridX >= grid->width || gridY >= grid->height){
+                        continue;
+                    }
+                    cell = ((int)gridY * grid->width) + (int)gridX;
+                    if (grid->heights[cell] <= layer){
+                        continue;
+                    }
+                    voxel = grid->voxels[(layer * layerSize) + cell];
+                    if (voxel & 0xFF){
+                        color = voxel;
+                        goto found;
+                    }
+                }
+            }
+            
+            //nothing standing here, so whatever floor is under it
+            if (view->floor != NULL){
+                gridX = ray->columnX[x] + (baseDepth * ray->stepX) + grid->left - view->floorX;
+                gridY = ray->columnY[x] + (baseDepth * ray->stepY) + grid->top - view->floorY;
+                if (gridX >= 0 && gridY >= 0 && gridX < view->floor->w && gridY < view->floor->h){
+                    voxel = ((Uint32 *)((Uint8 *)view->floor->pixels + ((int)gridY * view->floor->pitch)))[(int)gridX];
+                    if (voxel & 0xFF){
+                        color = voxel;
+                    }
+                }
+            }
+            
+            found:
+            row[x] = color;
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef STACK_RAYCASTER_H
+#define STACK_RAYCASTER_H
+
+#include "SDL2/SDL.h"
+#include "stack_world.h"
+
+/*
+ * Another way to fill the stack buffer, for scenes packed so densely that drawing every layer of every object
+ * costs more than working out every pixel.  The stacks cost objects x layers x pitch, this costs buffer pixels x
+ * layers, however many objects there are.
+ *
+ * Every object in the world is stamped into a voxel grid once, a full detail slice per layer.  Then each frame
+ * every column of the buffer casts a ray back into the world (the buffer's x after rotating is fixed down a
+ * column, only the depth changes), and each pixel steps down through the layers from the top, looking for the
+ * first one with a voxel where that layer lands on the pixel.  That's the same pixel the stacks would have ended
+ * up with, since a higher layer is always drawn over a lower one, and it includes the gap filling copies.
+ *
+ * Columns are worked out on the software renderer's threads, writing straight into its surface, so the software
+ * renderer has to be running.  The grid is dense, so it only suits worlds the size of a room or so; building one
+ * over budget gives up rather than use up the memory.  The grid doesn't change after it's built, and billboards
+ * aren't in it.
+ */
+
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+typedef struct StackVoxelGrid{
+    Uint32 *voxels; //array [(layer * height + y) * width + x], RGBA8888 like the slices, 0 for empty
+    Uint16 *heights; //array [y * width + x], one more than the highest layer with a voxel there, so 0 for none
+    //where the grid's top left sits, in world coordinates
+    int left;
+    int top;
+    int width;
+    int height;
+    int numLayers;
+    int numFilled;
+} StackVoxelGrid;
+
+//what the stack pass would have drawn with, for one frame
+typedef struct StackRaycastView{
+    //the world position that lands on the pivot, which everything rotates about
+    float cameraX;
+    float cameraY;
+    float pivotX; //buffer coordinates, before scaling
+    float pivotY;
+    float angle; //degrees clockwise, like drawImageRotate
+    float zoom; //buffer pixels per world pixel, before scaling
+    float layerPitch; //buffer pixels between one layer and the next
+    int copies; //rows each layer covers, to fill the gap up to the next
+    int scaling;
+    int firstRow; //rows above this are never shown, so aren't filled in
+    Uint32 clearColor; //RGBA8888
+    //the floor, under everything, NULL for none
+    SDL_Surface *floor;
+    float floorX; //its top left, in world coordinates
+    float floorY;
+} StackRaycastView;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackVoxelGrid *init_StackVoxelGrid(StackVoxelGrid *self, int left, int top, int width, int height, int numLayers);
+void free_StackVoxelGrid(StackVoxelGrid *self);
+
+
+/////////////////////////////////////////////////
+// Building
+/////////////////////////////////////////////////
+void addStackObjectVoxels(StackVoxelGrid *self, const StackObject *obj); //the model's slices need their pixels
+//a grid just big enough for every object in the world, NULL if it would need more than budgetKb
+StackVoxelGrid *buildStackVoxelGrid(StackWorld *world, int budgetKb);
+
+
+/////////////////////////////////////////////////
+// Drawing
+/////////////////////////////////////////////////
+//fills the software render, which has to be the stack buffer's size
+void raycastStackVoxels(const StackVoxelGrid *self, const StackRaycastView *view);
+
+#endif
@@ -0,0 +1,278 @@
+#include "stack_transform.h"
+#include "logging.h"
+#include "SDL2/SDL.h"
+#include <math.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define HAS_X86_INTRINSICS 1
+    #include <immintrin.h>
+#else
+    #define HAS_X86_INTRINSICS 0
+#endif
+
+static void pickRotateAnchors();
+static void rotateAnchorsScalar(const float *x, const float *y, int count, float c, float s, float pivotX, float pivotY, float *outX, float *outY);
+#if HAS_X86_INTRINSICS && defined(__SSE2__)
+static void rotateAnchorsSSE2(const float *x, const float *y, int count, float c, float s, float pivotX, float pivotY, float *outX, float *outY);
+#endif
+#if HAS_X86_INTRINSICS
+static void rotateAnchorsAVX2(const float *x, const float *y, int count, float c, float s, float pivotX, float pivotY, float *outX, float *outY);
+#endif
+static void rotateQuadPerCall(float *corners, float x, float y, float angle, int centerX, int centerY, int width, int height);
+
+static void (*rotateAnchors)(const float *x, const float *y, int count, float c, float s, float pivotX, float pivotY, float *outX, float *outY) = NULL;
+static const char *instructionSet = "scalar";
+
+static const int benchmarkRepeats = 200;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackAnchors *init_StackAnchors(StackAnchors *self){
+    self->x = NULL;
+    self->y = NULL;
+    self->rotatedX = NULL;
+    self->rotatedY = NULL;
+    self->count = 0;
+    self->capacity = 0;
+    
+    return self;
+}
+
+void free_StackAnchors(StackAnchors *self){
+    if (self == NULL){
+        LOG_WAR("Tried to free NULL StackAnchors");
+        return;
+    }
+    
+    free(self->x);
+    free(self->y);
+    free(self->rotatedX);
+    free(self->rotatedY);
+    
+    free(self);
+}
+
+
+/////////////////////////////////////////////////
+// Anchors
+/////////////////////////////////////////////////
+void clearStackAnchors(StackAnchors *self){
+    self->count = 0;
+}
+
+void reserveStackAnchors(StackAnchors *self, int count){
+    if (count <= self->capacity){
+        return;
+    }
+    
+    self->capacity = count;
+    self->x = realloc(self->x, sizeof(float) * self->capacity);
+    self->y = realloc(self->y, sizeof(float) * self->capacity);
+    self->rotatedX = realloc(self->rotatedX, sizeof(float) * self->capacity);
+    self->rotatedY = realloc(self->rotatedY, sizeof(float) * self->capacity);
+}
+
+int addStackAnchor(StackAnchors *self, float x, float y){
+    if (self->count >= self->capacity){
+        reserveStackAnchors(self, (self->capacity == 0) ? 256 : self->capacity * 2);
+    }
+    
+    self->x[self->count] = x;
+    self->y[self->count] = y;
+    self->count++;
+    return self->count - 1;
+}
+
+void rotateStackAnchors(StackAnchors *self, float angle, float pivotX, float pivotY){
+    if (rotateAnchors == NULL){
+        pickRotateAnchors();
+    }
+    
+    //the only trig for the whole lot
+    float radians = angle * (M_PI / 180.0);
+    rotateAnchors(self->x, self->y, self->count, cosf(radians), sinf(radians), pivotX, pivotY, self->rotatedX, self->rotatedY);
+}
+
+const char *getStackTransformInstructionSet(){
+    if (rotateAnchors == NULL){
+        pickRotateAnchors();
+    }
+    return instructionSet;
+}
+
+void pickRotateAnchors(){
+    //the widest the CPU can run, like the software renderer
+    rotateAnchors = &rotateAnchorsScalar;
+    instructionSet = "scalar";
+    #if HAS_X86_INTRINSICS && defined(__SSE2__)
+    if (SDL_HasSSE2()){
+        rotateAnchors = &rotateAnchorsSSE2;
+        instructionSet = "SSE2";
+    }
+    #endif
+    #if HAS_X86_INTRINSICS
+    if (SDL_HasAVX2()){
+        rotateAnchors = &rotateAnchorsAVX2;
+        instructionSet = "AVX2";
+    }
+    #endif
+}
+
+void rotateAnchorsScalar(const float *x, const float *y, int count, float c, float s, float pivotX, float pivotY, float *outX, float *outY){
+    int i;
+    float relativeX, relativeY;
+    for (i = 0; i < count; i++){
+        relativeX = x[i] - pivotX;
+        relativeY = y[i] - pivotY;
+        outX[i] = pivotX + (c * relativeX) - (s * relativeY);
+        outY[i] = pivotY + (s * relativeX) + (c * relativeY);
+    }
+}
+
+#if HAS_X86_INTRINSICS && defined(__SSE2__)
+void rotateAnchorsSSE2(const float *x, const float *y, int count, float c, float s, float pivotX, float pivotY, float *outX, float *outY){
+    __m128 cosines = _mm_set1_ps(c);
+    __m128 sines = _mm_set1_ps(s);
+    __m128 pivotXs = _mm_set1_ps(pivotX);
+    __m128 pivotYs = _mm_set1_ps(pivotY);
+    __m128 relativeX, relativeY;
+    int i;
+    for (i = 0; i + 4 <= count; i += 4){
+        relativeX = _mm_sub_ps(_mm_loadu_ps(x + i), pivotXs);
+        relativeY = _mm_sub_ps(_mm_loadu_ps(y + i), pivotYs);
+        _mm_storeu_ps(outX + i, _mm_add_ps(pivotXs, _mm_sub_ps(_mm_mul_ps(cosines, relativeX), _mm_mul_ps(sines, relativeY))));
+        _mm_storeu_ps(outY + i, _mm_add_ps(pivotYs, _mm_add_ps(_mm_mul_ps(sines, relativeX), _mm_mul_ps(cosines, relativeY))));
+    }
+    
+    //whatever doesn't fill a whole register
+    rotateAnchorsScalar(x + i, y + i, count - i, c, s, pivotX, pivotY, outX + i, outY + i);
+}
+#endif
+
+#if HAS_X86_INTRINSICS
+__attribute__((target("avx2")))
+void rotateAnchorsAVX2(const float *x, const float *y, int count, float c, float s, float pivotX, float pivotY, float *outX, float *outY){
+    __m256 cosines = _mm256_set1_ps(c);
+    __m256 sines = _mm256_set1_ps(s);
+    __m256 pivotXs = _mm256_set1_ps(pivotX);
+    __m256 pivotYs = _mm256_set1_ps(pivotY);
+    __m256 relativeX, relativeY;
+    int i;
+    for (i = 0; i + 8 <= count; i += 8){
+        relativeX = _mm256_sub_ps(_mm256_loadu_ps(x + i), pivotXs);
+        relativeY = _mm256_sub_ps(_mm256_loadu_ps(y + i), pivotYs);
+        _mm256_storeu_ps(outX + i, _mm256_add_ps(pivotXs, _mm256_sub_ps(_mm256_mul_ps(cosines, relativeX), _mm256_mul_ps(sines, relativeY))));
+        _mm256_storeu_ps(outY + i, _mm256_add_ps(pivotYs, _mm256_add_ps(_mm256_mul_ps(sines, relativeX), _mm256_mul_ps(cosines, relativeY))));
+    }
+    
+    rotateAnchorsScalar(x + i, y + i, count - i, c, s, pivotX, pivotY, outX + i, outY + i);
+}
+#endif
+
+
+/////////////////////////////////////////////////
+// Benchmark
+/////////////////////////////////////////////////
+void benchmarkStackTransforms(int numObjects){
+    /*
+     * The corners of one 16x16 quad per object, the way each draw used to work them out (trig and all, from an
+     * angle and a pivot) against rotating all the anchors at once and adding the rotated size on.  The sum of the
+     * corners is logged too, so the work can't be optimized away and the two can be seen to agree.
+     */
+    const int size = 16;
+    const float pivot = 88;
+    int i, repeat;
+    float *corners = malloc(sizeof(float) * 8 * numObjects);
+    StackAnchors *anchors = init_StackAnchors(malloc(sizeof(StackAnchors)));
+    for (i = 0; i < numObjects; i++){
+        addStackAnchor(anchors, (i % 100) * size, (i / 100) * size);
+    }
+    
+    Uint64 perCallTicks = 0;
+    Uint64 bulkTicks = 0;
+    Uint64 scalarTicks = 0;
+    Uint64 start;
+    double perCallSum = 0;
+    double bulkSum = 0;
+    float angle, radians, c, s;
+    float *rx, *ry;
+    for (repeat = 0; repeat < benchmarkRepeats; repeat++){
+        angle = repeat * 1.7f;
+        
+        start = SDL_GetPerformanceCounter();
+        for (i = 0; i < numObjects; i++){
+            rotateQuadPerCall(corners + (i * 8), anchors->x[i], anchors->y[i], angle, pivot - anchors->x[i], pivot - anchors->y[i], size, size);
+        }
+        perCallTicks += SDL_GetPerformanceCounter() - start;
+        perCallSum += corners[0] + corners[(numObjects - 1) * 8 + 5];
+        
+        start = SDL_GetPerformanceCounter();
+        rotateStackAnchors(anchors, angle, pivot, pivot);
+        radians = angle * (M_PI / 180.0);
+        c = cosf(radians);
+        s = sinf(radians);
+        rx = anchors->rotatedX;
+        ry = anchors->rotatedY;
+        for (i = 0; i < numObjects; i++){
+            corners[i*8 + 0] = rx[i];
+            corners[i*8 + 1] = ry[i];
+            corners[i*8 + 2] = rx[i] + (c * size);
+            corners[i*8 + 3] = ry[i] + (s * size);
+            corners[i*8 + 4] = rx[i] + (c * size) - (s * size);
+            corners[i*8 + 5] = ry[i] + (s * size) + (c * size);
+            corners[i*8 + 6] = rx[i] - (s * size);
+            corners[i*8 + 7] = ry[i] + (c * size);
+        }
+        bulkTicks += SDL_GetPerformanceCounter() - start;
+        bulkSum += corners[0] + corners[(numObjects - 1) * 8 + 5];
+        
+        //just the anchors, without the SIMD
+        start = SDL_GetPerformanceCounter();
+        rotateAnchorsScalar(anchors->x, anchors->y, anchors->count, c, s, pivot, pivot, anchors->rotatedX, anchors->rotatedY);
+        scalarTicks += SDL_GetPerformanceCounter() - start;
+    }
+    Uint64 anchorTicks = SDL_GetPerformanceCounter();
+    for (repeat = 0; repeat < benchmarkRepeats; repeat++){
+        rotateStackAnchors(anchors, repeat * 1.7f, pivot, pivot);
+    }
+    anchorTicks = SDL_GetPerformanceCounter() - anchorTicks;
+    
+    double microseconds = 1000000.0 / SDL_GetPerformanceFrequency() / benchmarkRepeats;
+    LOG_INF("Transform benchmark, %d objects: per draw rotation %.1f us, bulk %s rotation %.1f us (%.1fx), corner sums %.1f and %.1f",
+        numObjects, perCallTicks * microseconds, getStackTransformInstructionSet(), bulkTicks * microseconds,
+        (bulkTicks > 0) ? (double)perCallTicks / bulkTicks : 0.0, perCallSum, bulkSum
+    );
+    LOG_INF("Transform benchmark, %d objects: anchors alone %.1f us scalar, %.1f us %s",
+        numObjects, scalarTicks * microseconds, anchorTicks * microseconds, getStackTransformInstructionSet()
+    );
+    
+    free_StackAnchors(anchors);
+    free(corners);
+}
+
+__attribute__((noinline))
+void rotateQuadPerCall(float *corners, float x, float y, float angle, int centerX, int centerY, int width, int height){
+    //what a rotated draw has to do on its own, as in SDL_RenderCopyEx, kept out of line like a real draw call
+    int destX = x;
+    int destY = y;
+    float radians = angle * (M_PI / 180.0);
+    float c = cosf(radians);
+    float s = sinf(radians);
+    float pivotX = destX + centerX;
+    float pivotY = destY + centerY;
+    float left = -centerX;
+    float right = width - centerX;
+    float top = -centerY;
+    float bottom = height - centerY;
+    corners[0] = pivotX + (c * left) - (s * top);
+    corners[1] = pivotY + (s * left) + (c * top);
+    corners[2] = pivotX + (c * right) - (s * top);
+    corners[3] = pivotY + (s * right) + (c * top);
+    corners[4] = pivotX + (c * right) - (s * bottom);
+    corners[5] = pivotY + (s * right) + (c * bottom);
+    corners[6] = pivotX + (c * left) - (s * bottom);
+    corners[7] = pivotY + (s * left) + (c * bottom);
+}
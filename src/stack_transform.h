@@ -0,0 +1,54 @@
+#ifndef STACK_TRANSFORM_H
+#define STACK_TRANSFORM_H
+
+/*
+ * Rotating a lot of positions by the same angle at once.  Every object in the stack pass rotates about the same
+ * pivot by the same angle, so rather than handing each draw an angle and a pivot and having the trig and the
+ * rotation redone for every layer of every copy, the positions go in here once a frame and come out rotated.
+ *
+ * Positions are kept as separate x and y arrays so the rotation can be done 4 or 8 at a time with SSE2 or AVX2,
+ * whichever the CPU has.  The rotated top left corners can then be drawn with drawImagePreRotated or
+ * softwareDrawImagePreRotated, which only need to add on the rotated image size.
+ */
+
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+typedef struct StackAnchors{
+    //positions before rotating
+    float *x; //array
+    float *y; //array
+    //the same positions after rotateStackAnchors
+    float *rotatedX; //array
+    float *rotatedY; //array
+    int count;
+    int capacity;
+} StackAnchors;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackAnchors *init_StackAnchors(StackAnchors *self);
+void free_StackAnchors(StackAnchors *self);
+
+
+/////////////////////////////////////////////////
+// Anchors
+/////////////////////////////////////////////////
+void clearStackAnchors(StackAnchors *self);
+int addStackAnchor(StackAnchors *self, float x, float y); //returns its index
+void reserveStackAnchors(StackAnchors *self, int count); //so count anchors can be added without growing
+//rotates every anchor clockwise (y points down) about the pivot, same as drawImageRotate, into rotatedX and rotatedY
+void rotateStackAnchors(StackAnchors *self, float angle, float pivotX, float pivotY);
+const char *getStackTransformInstructionSet();
+
+
+/////////////////////////////////////////////////
+// Benchmark
+/////////////////////////////////////////////////
+//logs how long the scalar per draw rotation takes against rotating anchors in bulk, for this many objects
+void benchmarkStackTransforms(int numObjects);
+
+#endif
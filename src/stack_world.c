@@ -0,0 +1,314 @@
+#include "stack_world.h"
+#include "stack_model.h"
+#include "graphics.h"
+#include "logging.h"
+#include "omni_exit.h"
+#include <math.h>
+#include <stdlib.h>
+
+static void buildChunkLayers(StackWorld *self, StackChunk *chunk, int lod, int mip);
+static void freeChunkLayers(StackWorld *self, StackChunk *chunk);
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackWorld *init_StackWorld(StackWorld *self, int tilesWide, int tilesHigh, int tileSize){
+    self->chunksWide = (tilesWide + STACK_CHUNK_TILES - 1) / STACK_CHUNK_TILES;
+    self->chunksHigh = (tilesHigh + STACK_CHUNK_TILES - 1) / STACK_CHUNK_TILES;
+    self->chunksWide = (self->chunksWide > 0) ? self->chunksWide : 1;
+    self->chunksHigh = (self->chunksHigh > 0) ? self->chunksHigh : 1;
+    self->tileSize = tileSize;
+    self->chunkSize = STACK_CHUNK_TILES * tileSize;
+    self->numObjects = 0;
+    self->numLayers = 0;
+    self->largestFootprint = 0;
+    
+    self->chunks = malloc(sizeof(StackChunk) * self->chunksWide * self->chunksHigh);
+    int i, lod, mip;
+    for (i = 0; i < self->chunksWide * self->chunksHigh; i++){
+        self->chunks[i].index = i;
+        self->chunks[i].objects = NULL;
+        self->chunks[i].numObjects = 0;
+        self->chunks[i].objectCapacity = 0;
+        self->chunks[i].numStatic = 0;
+        self->chunks[i].numLayers = 0;
+        self->chunks[i].minX = 0;
+        self->chunks[i].minY = 0;
+        self->chunks[i].maxX = 0;
+        self->chunks[i].maxY = 0;
+        for (lod = 0; lod < STACK_MODEL_LOD_LEVELS; lod++){
+            for (mip = 0; mip < STACK_SLICE_MIP_LEVELS; mip++){
+                self->chunks[i].layerImages[lod][mip] = NULL;
+                self->chunks[i].numLayerImages[lod][mip] = 0;
+            }
+        }
+        self->chunks[i].layerOriginX = 0;
+        self->chunks[i].layerOriginY = 0;
+        self->chunks[i].version = 0;
+        self->chunks[i].lastUsedFrame = 0;
+    }
+    
+    self->chunksInRect = NULL;
+    self->chunksInRectCapacity = 0;
+    self->builtChunks = NULL;
+    self->numBuiltChunks = 0;
+    self->builtChunksCapacity = 0;
+    self->frame = 0;
+    
+    return self;
+}
+
+void free_StackWorld(StackWorld *self){
+    if (self == NULL){
+        LOG_WAR("Tried to free NULL StackWorld");
+        return;
+    }
+    
+    //the objects only point at their models, whoever loaded the models frees them
+    int i;
+    for (i = 0; i < self->chunksWide * self->chunksHigh; i++){
+        freeChunkLayers(self, self->chunks + i);
+        free(self->chunks[i].objects);
+    }
+    free(self->chunks);
+    free(self->chunksInRect);
+    free(self->builtChunks);
+    
+    free(self);
+}
+
+
+/////////////////////////////////////////////////
+// Objects
+/////////////////////////////////////////////////
+StackObject *addStackObject(StackWorld *self, float x, float y, StackModel *model, int isStatic){
+    int chunkX = floorf(x / self->chunkSize);
+    int chunkY = floorf(y / self->chunkSize);
+    if (chunkX < 0 || chunkY < 0 || chunkX >= self->chunksWide || chunkY >= self->chunksHigh){
+        LOG_WAR("Tried to add an object at (%f, %f), off the world", x, y);
+        return NULL;
+    }
+    
+    StackChunk *chunk = self->chunks + (chunkY * self->chunksWide) + chunkX;
+    if (chunk->numObjects >= chunk->objectCapacity){
+        chunk->objectCapacity = (chunk->objectCapacity == 0) ? 16 : chunk->objectCapacity * 2;
+        chunk->objects = realloc(chunk->objects, sizeof(StackObject) * chunk->objectCapacity);
+    }
+    StackObject *result = chunk->objects + chunk->numObjects;
+    result->x = x;
+    result->y = y;
+    result->model = model;
+    result->isStatic = isStatic;
+    result->animation = NULL;
+    
+    //grow the chunk's bounds to fit
+    float left = x - model->pivotX;
+    float top = y - model->pivotY;
+    if (chunk->numObjects == 0 || left < chunk->minX){
+        chunk->minX = left;
+    }
+    if (chunk->numObjects == 0 || top < chunk->minY){
+        chunk->minY = top;
+    }
+    if (chunk->numObjects == 0 || left + model->width > chunk->maxX){
+        chunk->maxX = left + model->width;
+    }
+    if (chunk->numObjects == 0 || top + model->height > chunk->maxY){
+        chunk->maxY = top + model->height;
+    }
+    chunk->numObjects++;
+    
+    if (getStackModelLayerCount(model) > chunk->numLayers){
+        chunk->numLayers = getStackModelLayerCount(model);
+    }
+    if (getStackModelLayerCount(model) > self->numLayers){
+        self->numLayers = getStackModelLayerCount(model);
+    }
+    if (model->width > self->largestFootprint){
+        self->largestFootprint = model->width;
+    }
+    if (model->height > self->largestFootprint){
+        self->largestFootprint = model->height;
+    }
+    self->numObjects++;
+    
+    //the layer cache is out of date now
+    if (isStatic){
+        chunk->numStatic++;
+        freeChunkLayers(self, chunk);
+        chunk->version++;
+    }
+    
+    return result;
+}
+
+int getStackObjectFrame(const StackObject *self){
+    if (self->animation == NULL || self->isStatic){
+        return 0;
+    }
+    return self->animation->spriteIndices[self->animation->currLoop][self->animation->currFrame];
+}
+
+
+/////////////////////////////////////////////////
+// Queries
+/////////////////////////////////////////////////
+int findChunksInRect(StackWorld *self, float left, float top, float right, float bottom, StackChunk ***result){
+    //objects can reach out of their chunk by a footprint, so look that much further
+    int firstX = floorf((left - self->largestFootprint) / self->chunkSize);
+    int firstY = floorf((top - self->largestFootprint) / self->chunkSize);
+    int lastX = floorf((right + self->largestFootprint) / self->chunkSize);
+    int lastY = floorf((bottom + self->largestFootprint) / self->chunkSize);
+    firstX = (firstX < 0) ? 0 : firstX;
+    firstY = (firstY < 0) ? 0 : firstY;
+    lastX = (lastX >= self->chunksWide) ? self->chunksWide - 1 : lastX;
+    lastY = (lastY >= self->chunksHigh) ? self->chunksHigh - 1 : lastY;
+    
+    int numFound = 0;
+    int x, y;
+    StackChunk *chunk;
+    for (y = firstY; y <= lastY; y++){
+        for (x = firstX; x <= lastX; x++){
+            chunk = self->chunks + (y * self->chunksWide) + x;
+            if (chunk->numObjects == 0 || chunk->maxX < left || chunk->minX > right || chunk->maxY < top || chunk->minY > bottom){
+                continue;
+            }
+            
+            if (numFound >= self->chunksInRectCapacity){
+                self->chunksInRectCapacity = (self->chunksInRectCapacity == 0) ? 16 : self->chunksInRectCapacity * 2;
+                self->chunksInRect = realloc(self->chunksInRect, sizeof(StackChunk *) * self->chunksInRectCapacity);
+            }
+            self->chunksInRect[numFound] = chunk;
+            numFound++;
+        }
+    }
+    
+    *result = self->chunksInRect;
+    return numFound;
+}
+
+Image **getChunkLayerImages(StackWorld *self, StackChunk *chunk, int lod, int mip){
+    if (chunk->layerImages[lod][mip] == NULL){
+        buildChunkLayers(self, chunk, lod, mip);
+    }
+    
+    chunk->lastUsedFrame = self->frame;
+    return chunk->layerImages[lod][mip];
+}
+
+void buildChunkLayers(StackWorld *self, StackChunk *chunk, int lod, int mip){
+    /*
+     * Every static object in a layer composited into one unrotated image.  Since the whole world rotates about
+     * the same point, rotating the composite is the same as rotating each object in it.  At a mip level the
+     * objects are placed at that scale from the origin, and drawn with their slices' mips.
+     */
+    int i;
+    int k;
+    int offsetX, offsetY;
+    ImageRect dst;
+    const StackObject *obj;
+    const StackSlice *slice;
+    Image *image;
+    float scale = 1.0f / (1 << mip);
+    int hadLayers = 0;
+    for (i = 0; i < STACK_MODEL_LOD_LEVELS * STACK_SLICE_MIP_LEVELS; i++){
+        hadLayers |= chunk->layerImages[i / STACK_SLICE_MIP_LEVELS][i % STACK_SLICE_MIP_LEVELS] != NULL;
+    }
+    
+    //the bounds are of every object, static or not, which is close enough and saves another pass
+    chunk->layerOriginX = floorf(chunk->minX);
+    chunk->layerOriginY = floorf(chunk->minY);
+    int width = ceilf((chunk->maxX - chunk->layerOriginX) * scale);
+    int height = ceilf((chunk->maxY - chunk->layerOriginY) * scale);
+    width = (width > 0) ? width : 1;
+    height = (height > 0) ? height : 1;
+    
+    int layersPerSlice = getStackLodLayersPerSlice(lod);
+    chunk->numLayerImages[lod][mip] = (chunk->numLayers + layersPerSlice - 1) / layersPerSlice;
+    chunk->layerImages[lod][mip] = malloc(sizeof(Image *) * chunk->numLayerImages[lod][mip]);
+    for (i = 0; i < chunk->numLayerImages[lod][mip]; i++){
+        chunk->layerImages[lod][mip][i] = createEmptyImage(width, height);
+        
+        for (k = 0; k < chunk->numObjects; k++){
+            obj = chunk->objects + k;
+            slice = getStackModelLodSliceForLayer(obj->model, lod, i);
+            if (!obj->isStatic || slice == NULL){
+                continue;
+            }
+            image = getStackSliceMip(slice, mip, &offsetX, &offsetY);
+            if (image == NULL){
+                continue;
+            }
+            
+            dst.x = ((obj->x - obj->model->pivotX - chunk->layerOriginX) * scale) + offsetX;
+            dst.y = ((obj->y - obj->model->pivotY - chunk->layerOriginY) * scale) + offsetY;
+            dst.w = image->width;
+            dst.h = image->height;
+            drawImageToImage(image, chunk->layerImages[lod][mip][i], NULL, &dst);
+        }
+    }
+    
+    LOG_DEB("Built level %d mip %d layer cache for chunk %d, %d %dx%d layers", lod, mip, chunk->index, chunk->numLayerImages[lod][mip], width, height);
+    
+    //remember it so it can be freed when it's no longer near the camera, unless another level already did
+    if (hadLayers){
+        return;
+    }
+    if (self->numBuiltChunks >= self->builtChunksCapacity){
+        self->builtChunksCapacity = (self->builtChunksCapacity == 0) ? 16 : self->builtChunksCapacity * 2;
+        self->builtChunks = realloc(self->builtChunks, sizeof(StackChunk *) * self->builtChunksCapacity);
+    }
+    self->builtChunks[self->numBuiltChunks] = chunk;
+    self->numBuiltChunks++;
+}
+
+void freeChunkLayers(StackWorld *self, StackChunk *chunk){
+    int i, lod, mip;
+    int hadLayers = 0;
+    for (lod = 0; lod < STACK_MODEL_LOD_LEVELS; lod++){
+        for (mip = 0; mip < STACK_SLICE_MIP_LEVELS; mip++){
+            if (chunk->layerImages[lod][mip] == NULL){
+                continue;
+            }
+            
+            for (i = 0; i < chunk->numLayerImages[lod][mip]; i++){
+                free_Image(chunk->layerImages[lod][mip][i]);
+            }
+            free(chunk->layerImages[lod][mip]);
+            chunk->layerImages[lod][mip] = NULL;
+            chunk->numLayerImages[lod][mip] = 0;
+            hadLayers = 1;
+        }
+    }
+    if (!hadLayers){
+        return;
+    }
+    
+    //order doesn't matter, so fill the hole with the last one
+    for (i = 0; i < self->numBuiltChunks; i++){
+        if (self->builtChunks[i] == chunk){
+            self->numBuiltChunks--;
+            self->builtChunks[i] = self->builtChunks[self->numBuiltChunks];
+            break;
+        }
+    }
+}
+
+
+/////////////////////////////////////////////////
+// Frames
+/////////////////////////////////////////////////
+void startStackWorldFrame(StackWorld *self){
+    self->frame++;
+}
+
+void freeUnusedChunkLayers(StackWorld *self, int framesUnused){
+    //backwards, since freeing moves the last chunk into the freed chunk's place
+    int i;
+    for (i = self->numBuiltChunks - 1; i >= 0; i--){
+        if (self->frame - self->builtChunks[i]->lastUsedFrame > (unsigned)framesUnused){
+            freeChunkLayers(self, self->builtChunks[i]);
+        }
+    }
+}
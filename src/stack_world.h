@@ -0,0 +1,109 @@
+#ifndef STACK_WORLD_H
+#define STACK_WORLD_H
+
+#include "graphics.h"
+#include "stack_model.h"
+
+/*
+ * Everything placed in the stack scene, split into a grid of square chunks so that drawing only has to look at the
+ * chunks near the camera, however big the world gets.
+ *
+ * An object belongs to the chunk its pivot is in.  Models can hang over the edge of their chunk, so each chunk
+ * keeps the bounds of its objects' footprints, and rect queries look one footprint further out to catch them.
+ *
+ * Each chunk also keeps its own layer cache: every static object in the chunk composited into one image per layer,
+ * so a layer of a chunk is one draw.  There's one per level of detail and mip level, made from the models' slices
+ * (or their mips) at that level, with the objects placed at that mip's scale.
+ * These are only built when something asks for them, and chunks that haven't been asked for a while can have
+ * theirs freed, so only the chunks around the camera use texture memory.
+ */
+
+#define STACK_CHUNK_TILES 16
+
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+typedef struct StackObject{
+    //where the model's pivot sits in the world
+    float x;
+    float y;
+    StackModel *model;
+    //static objects never move, so they get baked into the layer cache instead of being drawn one at a time
+    int isStatic;
+    //picks the frame of an animated model like drawAnimation picks a sprite's, NULL for frame 0; static objects always show frame 0
+    Animation *animation;
+} StackObject;
+
+typedef struct StackChunk{
+    int index; //position in the world's chunk array, never changes
+    StackObject *objects; //array
+    int numObjects;
+    int objectCapacity;
+    int numStatic;
+    int numLayers; //the tallest model in the chunk
+    //bounds of every object's footprint, only meaningful when there are objects
+    float minX;
+    float minY;
+    float maxX;
+    float maxY;
+    
+    //the layer cache for each level of detail and mip level, NULL until getChunkLayerImages builds it
+    Image **layerImages[STACK_MODEL_LOD_LEVELS][STACK_SLICE_MIP_LEVELS]; //array [layer at that level]
+    int numLayerImages[STACK_MODEL_LOD_LEVELS][STACK_SLICE_MIP_LEVELS];
+    float layerOriginX; //where the top left of every layer image sits, in world coordinates, whatever the mip
+    float layerOriginY;
+    int version; //changes whenever the static objects change, for anything made from the layer images
+    unsigned lastUsedFrame;
+} StackChunk;
+
+typedef struct StackWorld{
+    StackChunk *chunks; //array [chunk y * chunksWide + chunk x]
+    int chunksWide;
+    int chunksHigh;
+    int tileSize;
+    float chunkSize; //in world pixels
+    int numObjects;
+    int numLayers; //the tallest model in the world
+    int largestFootprint; //widest or tallest model, so how far an object can reach out of its chunk
+    
+    StackChunk **chunksInRect; //array, reused for the results of findChunksInRect
+    int chunksInRectCapacity;
+    StackChunk **builtChunks; //array, every chunk with a layer cache, so freeing old ones doesn't mean visiting every chunk
+    int numBuiltChunks;
+    int builtChunksCapacity;
+    unsigned frame;
+} StackWorld;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+StackWorld *init_StackWorld(StackWorld *self, int tilesWide, int tilesHigh, int tileSize);
+void free_StackWorld(StackWorld *self);
+
+
+/////////////////////////////////////////////////
+// Objects
+/////////////////////////////////////////////////
+//returns NULL if the position is off the world, otherwise the object, which is valid until the next add to its chunk
+StackObject *addStackObject(StackWorld *self, float x, float y, StackModel *model, int isStatic);
+int getStackObjectFrame(const StackObject *self); //the frame of its model to draw right now
+
+
+/////////////////////////////////////////////////
+// Queries
+/////////////////////////////////////////////////
+//every non-empty chunk that might have a footprint overlapping the rect, in world coordinates; result is reused between calls
+int findChunksInRect(StackWorld *self, float left, float top, float right, float bottom, StackChunk ***result);
+//builds the chunk's layer cache at that level of detail and mip if needed, has to be called while rendering to the screen, not an image
+Image **getChunkLayerImages(StackWorld *self, StackChunk *chunk, int lod, int mip);
+
+
+/////////////////////////////////////////////////
+// Frames
+/////////////////////////////////////////////////
+void startStackWorldFrame(StackWorld *self);
+void freeUnusedChunkLayers(StackWorld *self, int framesUnused); //frees the layer caches of chunks not used in this many frames
+
+#endif
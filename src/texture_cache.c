@@ -0,0 +1,142 @@
+#include "texture_cache.h"
+#include "graphics.h"
+#include "logging.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int keysMatch(const int *a, const int *b);
+static void evictEntry(TextureCache *self, int index);
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+TextureCache *init_TextureCache(TextureCache *self, int budgetBytes){
+    self->entries = NULL;
+    self->numEntries = 0;
+    self->entryCapacity = 0;
+    self->budgetBytes = budgetBytes;
+    self->bytesUsed = 0;
+    self->useCounter = 0;
+    self->frameStart = 1;
+    self->hits = 0;
+    self->misses = 0;
+    self->evictions = 0;
+    
+    return self;
+}
+
+void free_TextureCache(TextureCache *self){
+    if (self == NULL){
+        LOG_WAR("Tried to free NULL TextureCache");
+        return;
+    }
+    
+    clearTextureCache(self);
+    free(self->entries);
+    self->entries = NULL;
+    self->entryCapacity = 0;
+    
+    free(self);
+}
+
+
+/////////////////////////////////////////////////
+// Access
+/////////////////////////////////////////////////
+Image *findInTextureCache(TextureCache *self, const int *key){
+    /*
+     * Linear search - the budget keeps the number of entries in the tens or hundreds, and
+     * comparing a few ints is nothing next to drawing
+     */
+    int i;
+    for (i = 0; i < self->numEntries; i++){
+        if (keysMatch(self->entries[i].key, key)){
+            self->useCounter++;
+            self->entries[i].lastUsed = self->useCounter;
+            self->hits++;
+            return self->entries[i].image;
+        }
+    }
+    
+    self->misses++;
+    return NULL;
+}
+
+int addToTextureCache(TextureCache *self, const int *key, Image *image){
+    int bytes = image->width * image->height * 4; //textures are created RGBA8888
+    if (bytes > self->budgetBytes){
+        return 0;
+    }
+    
+    //evict until there's room, but never anything in use this frame
+    int i, leastRecent;
+    while (self->bytesUsed + bytes > self->budgetBytes){
+        leastRecent = -1;
+        for (i = 0; i < self->numEntries; i++){
+            if (self->entries[i].lastUsed >= self->frameStart){
+                continue;
+            }
+            if (leastRecent < 0 || self->entries[i].lastUsed < self->entries[leastRecent].lastUsed){
+                leastRecent = i;
+            }
+        }
+        
+        if (leastRecent < 0){
+            return 0;
+        }
+        evictEntry(self, leastRecent);
+        self->evictions++;
+    }
+    
+    if (self->numEntries >= self->entryCapacity){
+        self->entryCapacity = (self->entryCapacity == 0) ? 16 : self->entryCapacity * 2;
+        self->entries = realloc(self->entries, sizeof(TextureCacheEntry) * self->entryCapacity);
+    }
+    
+    TextureCacheEntry *entry = self->entries + self->numEntries;
+    memcpy(entry->key, key, sizeof(int) * TEXTURE_CACHE_KEY_LENGTH);
+    entry->image = image;
+    entry->bytes = bytes;
+    self->useCounter++;
+    entry->lastUsed = self->useCounter;
+    
+    self->numEntries++;
+    self->bytesUsed += bytes;
+    return 1;
+}
+
+void startTextureCacheFrame(TextureCache *self){
+    self->frameStart = self->useCounter + 1;
+}
+
+void clearTextureCache(TextureCache *self){
+    while (self->numEntries > 0){
+        evictEntry(self, self->numEntries - 1);
+    }
+}
+
+void resetTextureCacheCounters(TextureCache *self){
+    self->hits = 0;
+    self->misses = 0;
+    self->evictions = 0;
+}
+
+int keysMatch(const int *a, const int *b){
+    int i;
+    for (i = 0; i < TEXTURE_CACHE_KEY_LENGTH; i++){
+        if (a[i] != b[i]){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void evictEntry(TextureCache *self, int index){
+    free_Image(self->entries[index].image);
+    self->bytesUsed -= self->entries[index].bytes;
+    
+    //order doesn't matter, so fill the hole with the last entry
+    self->numEntries--;
+    self->entries[index] = self->entries[self->numEntries];
+}
@@ -0,0 +1,69 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "graphics.h"
+
+/*
+ * A least-recently-used cache of rendered images, for things that are expensive to draw but get drawn the same way
+ * over and over (like a layer rotated to the same angle every frame).  Images are looked up by a small key of ints
+ * whose meaning is up to whoever owns the cache.
+ *
+ * The cache has a budget in bytes of texture memory.  Adding an image evicts the least recently used images until
+ * the new one fits.  The cache owns every image added to it and frees them on eviction.
+ *
+ * Call startTextureCacheFrame once per frame before looking anything up.  Images found or added since then are
+ * never evicted, so pointers handed out during a frame stay valid until the next call.
+ *
+ * Hits, misses and evictions are counted so the budget can be tuned per scene.
+ */
+
+#define TEXTURE_CACHE_KEY_LENGTH 9
+
+
+/////////////////////////////////////////////////
+// Structs
+/////////////////////////////////////////////////
+typedef struct TextureCacheEntry{
+    int key[TEXTURE_CACHE_KEY_LENGTH];
+    Image *image;
+    int bytes;
+    //value of the cache's use counter when this was last looked up, smallest is least recently used
+    unsigned lastUsed;
+} TextureCacheEntry;
+
+typedef struct TextureCache{
+    TextureCacheEntry *entries; //array
+    int numEntries;
+    int entryCapacity;
+    int budgetBytes;
+    int bytesUsed;
+    unsigned useCounter;
+    //entries used at or after this count were used this frame and can't be evicted
+    unsigned frameStart;
+    
+    //counters since creation or the last resetTextureCacheCounters
+    int hits;
+    int misses;
+    int evictions;
+} TextureCache;
+
+
+/////////////////////////////////////////////////
+// Init/Free
+/////////////////////////////////////////////////
+TextureCache *init_TextureCache(TextureCache *self, int budgetBytes);
+void free_TextureCache(TextureCache *self);
+
+
+/////////////////////////////////////////////////
+// Access
+/////////////////////////////////////////////////
+//returns NULL on a miss; key must be TEXTURE_CACHE_KEY_LENGTH long, unused values should be 0
+Image *findInTextureCache(TextureCache *self, const int *key);
+//returns 1 if the cache took ownership of the image, or 0 if it can't fit without evicting something used this frame, and the caller still owns it
+int addToTextureCache(TextureCache *self, const int *key, Image *image);
+void startTextureCacheFrame(TextureCache *self);
+void clearTextureCache(TextureCache *self);
+void resetTextureCacheCounters(TextureCache *self);
+
+#endif
@@ -0,0 +1,446 @@
+#include "vox_loader.h"
+#include "stack_model.h"
+#include "graphics.h"
+#include "file_reader.h"
+#include "logging.h"
+#include "omni_exit.h"
+#include "SDL2/SDL.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned char *compileVox(char *filename, long long sourceTime, long long sourceSize, unsigned long *length);
+static StackModel *modelFromCache(const unsigned char *cache, unsigned long length, char *filename);
+static int cacheMatchesSource(const unsigned char *cache, unsigned long length, long long sourceTime, long long sourceSize);
+static void fillDefaultPalette(Uint32 *palette);
+static Uint32 readUint32(const unsigned char *bytes);
+static void writeUint32(unsigned char *bytes, Uint32 value);
+static int countSliceDifferences(const StackModel *a, const StackModel *b);
+
+/*
+ * Cache layout, every value a little endian 32 bit int:
+ *   magic, version, source modified time (low, high), source size (low, high),
+ *   width, height, number of layers, number of slices,
+ *   then for each slice: layer, offset x, offset y, width, height, and width*height RGBA8888 pixels
+ */
+static const Uint32 cacheMagic = 0x434B5453; //"STKC"
+static const Uint32 cacheVersion = 1;
+static const int cacheHeaderValues = 10;
+static const int cacheSliceValues = 5;
+static int lastLoadConverted = 0; //whether the last loadVoxStackModel had to convert the .vox, for checkVoxStackModelCache
+
+
+/////////////////////////////////////////////////
+// Loading
+/////////////////////////////////////////////////
+StackModel *loadVoxStackModel(char *filename){
+    long long sourceTime, sourceSize;
+    if (!getFileStats(filename, &sourceTime, &sourceSize)){
+        LOG_ERR("Unable to find voxel model %s", filename);
+        displayErrorAndExit("Problem reading data file");
+    }
+    
+    char cacheName[FILENAME_BUFFER_SIZE];
+    snprintf(cacheName, FILENAME_BUFFER_SIZE, "%s.cache", filename);
+    
+    //use the cache if it was built from this exact file
+    unsigned long length = 0;
+    unsigned char *cache = NULL;
+    if (fileExists(cacheName)){
+        cache = readBinaryFileToCharStar(cacheName, &length);
+        if (!cacheMatchesSource(cache, length, sourceTime, sourceSize)){
+            LOG_INF("Voxel cache %s is out of date, rebuilding", cacheName);
+            free(cache);
+            cache = NULL;
+        }
+    }
+    
+    lastLoadConverted = (cache == NULL);
+    if (cache == NULL){
+        cache = compileVox(filename, sourceTime, sourceSize, &length);
+        if (!writeBinaryFile(cacheName, cache, length)){
+            LOG_WAR("Couldn't write voxel cache %s, %s will be converted again next time", cacheName, filename);
+        }
+    }
+    
+    StackModel *result = modelFromCache(cache, length, filename);
+    free(cache);
+    return result;
+}
+
+unsigned char *compileVox(char *filename, long long sourceTime, long long sourceSize, unsigned long *length){
+    /*
+     * .vox is chunks of (id, content bytes, children bytes, content, children), with everything inside MAIN's
+     * children.  We only need SIZE and XYZI for the first model and RGBA for the palette, anything else is skipped.
+     * See https://github.com/ephtracy/voxel-model/blob/master/MagicaVoxel-file-format-vox.txt
+     */
+    unsigned long fileLength;
+    unsigned char *file = readBinaryFileToCharStar(filename, &fileLength);
+    if (fileLength < 20 || memcmp(file, "VOX ", 4) != 0 || memcmp(file + 8, "MAIN", 4) != 0){
+        LOG_ERR("%s is not a MagicaVoxel file", filename);
+        displayErrorAndExit("Problem reading data file");
+    }
+    
+    const unsigned char *sizeChunk = NULL;
+    const unsigned char *voxelChunk = NULL;
+    const unsigned char *paletteChunk = NULL;
+    int numModels = 0;
+    unsigned long position = 20 + readUint32(file + 12); //past MAIN's header and content, to its children
+    unsigned long chunkLength;
+    while (position + 12 <= fileLength){
+        chunkLength = readUint32(file + position + 4);
+        if (position + 12 + chunkLength > fileLength){
+            LOG_ERR("%s has a chunk running past the end of the file", filename);
+            displayErrorAndExit("Problem reading data file");
+        }
+        
+        if (memcmp(file + position, "SIZE", 4) == 0 && chunkLength >= 12){
+            numModels++;
+            sizeChunk = (sizeChunk == NULL) ? file + position + 12 : sizeChunk;
+        } else if (memcmp(file + position, "XYZI", 4) == 0 && chunkLength >= 4){
+            voxelChunk = (voxelChunk == NULL) ? file + position + 12 : voxelChunk;
+            if (readUint32(voxelChunk) > (chunkLength - 4) / 4){
+                LOG_ERR("%s has more voxels than fit in its XYZI chunk", filename);
+                displayErrorAndExit("Problem reading data file");
+            }
+        } else if (memcmp(file + position, "RGBA", 4) == 0 && chunkLength >= 256 * 4){
+            paletteChunk = file + position + 12;
+        }
+        
+        position += 12 + chunkLength + readUint32(file + position + 8);
+    }
+    if (sizeChunk == NULL || voxelChunk == NULL){
+        LOG_ERR("%s has no voxel model in it", filename);
+        displayErrorAndExit("Problem reading data file");
+    }
+    if (numModels > 1){
+        LOG_WAR("%s has %d models, only the first is used", filename, numModels);
+    }
+    
+    //palette index 0 is empty, voxel colors are 1 to 255
+    Uint32 palette[256];
+    int i;
+    if (paletteChunk != NULL){
+        palette[0] = 0;
+        for (i = 1; i < 256; i++){
+            const unsigned char *rgba = paletteChunk + ((i - 1) * 4);
+            palette[i] = ((Uint32)rgba[0] << 24) | ((Uint32)rgba[1] << 16) | ((Uint32)rgba[2] << 8) | rgba[3];
+        }
+    } else {
+        fillDefaultPalette(palette);
+    }
+    
+    //fill the grid, 0 is empty since nothing in the palette is fully transparent black
+    int sizeX = readUint32(sizeChunk);
+    int sizeY = readUint32(sizeChunk + 4);
+    int sizeZ = readUint32(sizeChunk + 8);
+    if (sizeX <= 0 || sizeY <= 0 || sizeZ <= 0 || sizeX > 256 || sizeY > 256 || sizeZ > 256){
+        LOG_ERR("%s has a model of size %dx%dx%d", filename, sizeX, sizeY, sizeZ);
+        displayErrorAndExit("Problem reading data file");
+    }
+    Uint32 *grid = calloc(sizeX * sizeY * sizeZ, sizeof(Uint32)); //[z][image y][x]
+    int numVoxels = readUint32(voxelChunk);
+    const unsigned char *voxel;
+    for (i = 0; i < numVoxels; i++){
+        voxel = voxelChunk + 4 + (i * 4);
+        if (voxel[0] >= sizeX || voxel[1] >= sizeY || voxel[2] >= sizeZ){
+            continue;
+        }
+        //+y is away from the viewer in MagicaVoxel, which is up the image
+        grid[(voxel[2] * sizeY * sizeX) + ((sizeY - 1 - voxel[1]) * sizeX) + voxel[0]] = palette[voxel[3]];
+    }
+    free(file);
+    
+    //crop every layer to what's in it
+    int *left = malloc(sizeof(int) * sizeZ);
+    int *top = malloc(sizeof(int) * sizeZ);
+    int *right = malloc(sizeof(int) * sizeZ);
+    int *bottom = malloc(sizeof(int) * sizeZ);
+    int x, y, z;
+    int lowestLayer = -1;
+    int highestLayer = -1;
+    int numSlices = 0;
+    unsigned long pixelCount = 0;
+    for (z = 0; z < sizeZ; z++){
+        left[z] = sizeX;
+        top[z] = sizeY;
+        right[z] = 0;
+        bottom[z] = 0;
+        for (y = 0; y < sizeY; y++){
+            for (x = 0; x < sizeX; x++){
+                if (grid[(z * sizeY * sizeX) + (y * sizeX) + x] == 0){
+                    continue;
+                }
+                left[z] = (x < left[z]) ? x : left[z];
+                top[z] = (y < top[z]) ? y : top[z];
+                right[z] = (x + 1 > right[z]) ? x + 1 : right[z];
+                bottom[z] = (y + 1 > bottom[z]) ? y + 1 : bottom[z];
+            }
+        }
+        
+        if (left[z] < right[z]){
+            lowestLayer = (lowestLayer < 0) ? z : lowestLayer;
+            highestLayer = z;
+            numSlices++;
+            pixelCount += (right[z] - left[z]) * (bottom[z] - top[z]);
+        }
+    }
+    if (numSlices == 0){
+        LOG_ERR("%s has no voxels in it", filename);
+        displayErrorAndExit("Problem reading data file");
+    }
+    
+    //and write it all out in the cache layout
+    *length = 4 * (cacheHeaderValues + (cacheSliceValues * numSlices) + pixelCount);
+    unsigned char *result = malloc(*length);
+    unsigned char *out = result;
+    writeUint32(out, cacheMagic);
+    writeUint32(out + 4, cacheVersion);
+    writeUint32(out + 8, (Uint32)sourceTime);
+    writeUint32(out + 12, (Uint32)(sourceTime >> 32));
+    writeUint32(out + 16, (Uint32)sourceSize);
+    writeUint32(out + 20, (Uint32)(sourceSize >> 32));
+    writeUint32(out + 24, sizeX);
+    writeUint32(out + 28, sizeY);
+    writeUint32(out + 32, highestLayer - lowestLayer + 1);
+    writeUint32(out + 36, numSlices);
+    out += 4 * cacheHeaderValues;
+    for (z = lowestLayer; z <= highestLayer; z++){
+        if (left[z] >= right[z]){
+            continue;
+        }
+        
+        writeUint32(out, z - lowestLayer);
+        writeUint32(out + 4, left[z]);
+        writeUint32(out + 8, top[z]);
+        writeUint32(out + 12, right[z] - left[z]);
+        writeUint32(out + 16, bottom[z] - top[z]);
+        out += 4 * cacheSliceValues;
+        for (y = top[z]; y < bottom[z]; y++){
+            for (x = left[z]; x < right[z]; x++){
+                writeUint32(out, grid[(z * sizeY * sizeX) + (y * sizeX) + x]);
+                out += 4;
+            }
+        }
+    }
+    
+    free(grid);
+    free(left);
+    free(top);
+    free(right);
+    free(bottom);
+    
+    LOG_INF("Converted %s, %dx%dx%d with %d non-empty layers", filename, sizeX, sizeY, sizeZ, numSlices);
+    return result;
+}
+
+StackModel *modelFromCache(const unsigned char *cache, unsigned long length, char *filename){
+    StackModel *result = init_StackModel(malloc(sizeof(StackModel)));
+    result->width = readUint32(cache + 24);
+    result->height = readUint32(cache + 28);
+    result->numLayers = readUint32(cache + 32);
+    result->numSlices = readUint32(cache + 36);
+    result->pivotX = result->width / 2.0f;
+    result->pivotY = result->height / 2.0f;
+    if (result->width <= 0 || result->height <= 0 || result->numLayers <= 0 || result->width > 256 || result->height > 256 || result->numLayers > 256
+        || result->numSlices <= 0 || result->numSlices > result->numLayers){
+        LOG_ERR("Voxel cache for %s has a bad header, delete %s.cache and try again", filename, filename);
+        displayErrorAndExit("Problem reading data file");
+    }
+    
+    result->slices = malloc(sizeof(StackSlice) * result->numSlices);
+    result->layerSlices = malloc(sizeof(int) * result->numLayers);
+    int i;
+    for (i = 0; i < result->numLayers; i++){
+        result->layerSlices[i] = -1;
+    }
+    
+    //the pixels are copied into each image, so a scratch row buffer does for converting byte order
+    const unsigned char *in = cache + (4 * cacheHeaderValues);
+    const unsigned char *end = cache + length;
+    Uint32 *pixels = NULL;
+    int pixelCapacity = 0;
+    int layer, offsetX, offsetY, width, height, p;
+    for (i = 0; i < result->numSlices; i++){
+        if (in + (4 * cacheSliceValues) > end){
+            break;
+        }
+        layer = readUint32(in);
+        offsetX = readUint32(in + 4);
+        offsetY = readUint32(in + 8);
+        width = readUint32(in + 12);
+        height = readUint32(in + 16);
+        if (layer < 0 || layer >= result->numLayers || width <= 0 || height <= 0 || width > result->width || height > result->height
+            || offsetX < 0 || offsetY < 0 || offsetX > result->width - width || offsetY > result->height - height
+            || in + (4 * (cacheSliceValues + (width * height))) > end){
+            break;
+        }
+        
+        result->layerSlices[layer] = i;
+        result->slices[i].offsetX = offsetX;
+        result->slices[i].offsetY = offsetY;
+        result->slices[i].pieces = NULL;
+        result->slices[i].numPieces = 0;
+        result->slices[i].quads = NULL;
+        result->slices[i].numQuads = 0;
+        result->slices[i].bakedRotations = NULL;
+        result->slices[i].numBakedRotations = 0;
+        result->slices[i].mips = NULL;
+        in += 4 * cacheSliceValues;
+        
+        if (width * height > pixelCapacity){
+            pixelCapacity = width * height;
+            pixels = realloc(pixels, sizeof(Uint32) * pixelCapacity);
+        }
+        for (p = 0; p < width * height; p++){
+            pixels[p] = readUint32(in + (p * 4));
+        }
+        in += 4 * width * height;
+        result->slices[i].image = createImageFromPixels(width, height, pixels);
+    }
+    free(pixels);
+    
+    if (i < result->numSlices){
+        LOG_ERR("Voxel cache for %s is corrupt at slice %d, delete %s.cache and try again", filename, i, filename);
+        displayErrorAndExit("Problem reading data file");
+    }
+    
+    LOG_INF("Loaded voxel model %s, %d slices over %d layers", filename, result->numSlices, result->numLayers);
+    return result;
+}
+
+int cacheMatchesSource(const unsigned char *cache, unsigned long length, long long sourceTime, long long sourceSize){
+    if (length < 4 * (unsigned long)cacheHeaderValues){
+        return 0;
+    }
+    
+    return readUint32(cache) == cacheMagic
+        && readUint32(cache + 4) == cacheVersion
+        && readUint32(cache + 8) == (Uint32)sourceTime
+        && readUint32(cache + 12) == (Uint32)(sourceTime >> 32)
+        && readUint32(cache + 16) == (Uint32)sourceSize
+        && readUint32(cache + 20) == (Uint32)(sourceSize >> 32);
+}
+
+void fillDefaultPalette(Uint32 *palette){
+    /*
+     * MagicaVoxel's palette when a file doesn't have one: a 6x6x6 color cube from white down (blue changing
+     * fastest) leaving out black, then 10 step ramps of red, green, blue and gray from 0xEE down to 0x11
+     */
+    static const Uint8 cubeSteps[6] = { 0xFF, 0xCC, 0x99, 0x66, 0x33, 0x00 };
+    static const Uint8 rampSteps[10] = { 0xEE, 0xDD, 0xBB, 0xAA, 0x88, 0x77, 0x55, 0x44, 0x22, 0x11 };
+    int index = 0;
+    int r, g, b, i;
+    
+    palette[index++] = 0;
+    for (r = 0; r < 6; r++){
+        for (g = 0; g < 6; g++){
+            for (b = 0; b < 6; b++){
+                if (r == 5 && g == 5 && b == 5){
+                    continue;
+                }
+                palette[index++] = ((Uint32)cubeSteps[r] << 24) | ((Uint32)cubeSteps[g] << 16) | ((Uint32)cubeSteps[b] << 8) | 0xFF;
+            }
+        }
+    }
+    for (i = 0; i < 10; i++){
+        palette[index++] = ((Uint32)rampSteps[i] << 24) | 0xFF;
+    }
+    for (i = 0; i < 10; i++){
+        palette[index++] = ((Uint32)rampSteps[i] << 16) | 0xFF;
+    }
+    for (i = 0; i < 10; i++){
+        palette[index++] = ((Uint32)rampSteps[i] << 8) | 0xFF;
+    }
+    for (i = 0; i < 10; i++){
+        palette[index++] = ((Uint32)rampSteps[i] << 24) | ((Uint32)rampSteps[i] << 16) | ((Uint32)rampSteps[i] << 8) | 0xFF;
+    }
+}
+
+Uint32 readUint32(const unsigned char *bytes){
+    return (Uint32)bytes[0] | ((Uint32)bytes[1] << 8) | ((Uint32)bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+}
+
+void writeUint32(unsigned char *bytes, Uint32 value){
+    bytes[0] = value & 0xFF;
+    bytes[1] = (value >> 8) & 0xFF;
+    bytes[2] = (value >> 16) & 0xFF;
+    bytes[3] = (value >> 24) & 0xFF;
+}
+
+
+/////////////////////////////////////////////////
+// Checks
+/////////////////////////////////////////////////
+void checkVoxStackModelCache(char *filename){
+    /*
+     * Loads the model with no cache, so it gets converted and the cache written, then again so it comes from the
+     * cache, and checks the two came out the same slice for slice.  Worth running after touching the converter or
+     * the cache layout.
+     */
+    char cacheName[FILENAME_BUFFER_SIZE];
+    snprintf(cacheName, FILENAME_BUFFER_SIZE, "%s.cache", filename);
+    if (fileExists(cacheName) && remove(cacheName) != 0){
+        LOG_WAR("Couldn't delete %s to check loading %s without it", cacheName, filename);
+        return;
+    }
+    
+    Uint64 start = SDL_GetPerformanceCounter();
+    StackModel *cold = loadVoxStackModel(filename);
+    Uint64 coldTicks = SDL_GetPerformanceCounter() - start;
+    int coldConverted = lastLoadConverted;
+    
+    start = SDL_GetPerformanceCounter();
+    StackModel *warm = loadVoxStackModel(filename);
+    Uint64 warmTicks = SDL_GetPerformanceCounter() - start;
+    int warmConverted = lastLoadConverted;
+    
+    int differences = countSliceDifferences(cold, warm);
+    double milliseconds = 1000.0 / SDL_GetPerformanceFrequency();
+    if (!coldConverted || warmConverted || differences > 0){
+        LOG_WAR("Voxel cache check for %s failed: cold load %s, warm load %s, %d slices differ",
+            filename, coldConverted ? "converted" : "didn't convert", warmConverted ? "converted again" : "used the cache", differences
+        );
+    } else {
+        LOG_INF("Voxel cache check for %s passed: %d slices the same, cold load %.2f ms, warm load %.2f ms",
+            filename, cold->numSlices, coldTicks * milliseconds, warmTicks * milliseconds
+        );
+    }
+    
+    free_StackModel(cold);
+    free_StackModel(warm);
+}
+
+int countSliceDifferences(const StackModel *a, const StackModel *b){
+    //slices that aren't the same size, place and pixels, or every slice if the models aren't even laid out the same
+    if (a->width != b->width || a->height != b->height || a->numLayers != b->numLayers || a->numSlices != b->numSlices){
+        return (a->numSlices > b->numSlices) ? a->numSlices : b->numSlices;
+    }
+    
+    int i, y;
+    int differences = 0;
+    const StackSlice *sliceA, *sliceB;
+    SDL_Surface *surfaceA, *surfaceB;
+    for (i = 0; i < a->numLayers; i++){
+        if (a->layerSlices[i] != b->layerSlices[i]){
+            differences++;
+        }
+    }
+    for (i = 0; i < a->numSlices; i++){
+        sliceA = a->slices + i;
+        sliceB = b->slices + i;
+        surfaceA = sliceA->image->_surface;
+        surfaceB = sliceB->image->_surface;
+        if (sliceA->offsetX != sliceB->offsetX || sliceA->offsetY != sliceB->offsetY || surfaceA->w != surfaceB->w || surfaceA->h != surfaceB->h){
+            differences++;
+            continue;
+        }
+        for (y = 0; y < surfaceA->h; y++){
+            if (memcmp((Uint8 *)surfaceA->pixels + (y * surfaceA->pitch), (Uint8 *)surfaceB->pixels + (y * surfaceB->pitch), surfaceA->w * 4) != 0){
+                differences++;
+                break;
+            }
+        }
+    }
+    return differences;
+}
@@ -0,0 +1,32 @@
+#ifndef VOX_LOADER_H
+#define VOX_LOADER_H
+
+#include "stack_model.h"
+
+/*
+ * Turns MagicaVoxel .vox files into stack models, so artists don't have to export every Z slice by hand.
+ *
+ * Each Z layer of the voxel grid becomes a slice, looking straight down with +y up the image like MagicaVoxel's
+ * top view.  Empty layers below and above the model are dropped (so it always sits on layer 0), empty layers in
+ * between get no slice, and every slice is cropped to its voxels with the offset kept in the StackSlice.  The
+ * pivot is the middle of the grid.  Only the first model in a file is used.
+ *
+ * Converting means walking the whole grid, so the slices are written to a cache beside the .vox (filename.cache)
+ * and read straight from there while the .vox's size and modified time still match what the cache was built from.
+ * Failing to write the cache only costs load time, so it's a warning rather than an error.
+ */
+
+
+/////////////////////////////////////////////////
+// Loading
+/////////////////////////////////////////////////
+StackModel *loadVoxStackModel(char *filename); //crashes the game if the file can't be read or isn't a .vox
+
+
+/////////////////////////////////////////////////
+// Checks
+/////////////////////////////////////////////////
+//deletes filename's cache, loads it cold (converting) and warm (from the new cache), and logs whether they match
+void checkVoxStackModelCache(char *filename);
+
+#endif